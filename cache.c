@@ -0,0 +1,289 @@
+/* See LICENSE file for license and copyright information */
+
+#include <stdlib.h>
+#include <string.h>
+#include <girara/session.h>
+#include <girara/settings.h>
+#include <girara/utils.h>
+
+#include "cache.h"
+
+typedef struct jumanji_cache_type_s
+{
+  const char* name; /**> Name of the type */
+  WebKitWebsiteDataTypes types; /**> Webkit data types */
+} jumanji_cache_type_t;
+
+static const jumanji_cache_type_t cache_types[] = {
+  { "disk",          WEBKIT_WEBSITE_DATA_DISK_CACHE },
+  { "memory",        WEBKIT_WEBSITE_DATA_MEMORY_CACHE },
+  { "offline",       WEBKIT_WEBSITE_DATA_OFFLINE_APPLICATION_CACHE },
+  { "local-storage", WEBKIT_WEBSITE_DATA_LOCAL_STORAGE },
+  { "indexeddb",     WEBKIT_WEBSITE_DATA_INDEXEDDB_DATABASES },
+  { "cookies",       WEBKIT_WEBSITE_DATA_COOKIES },
+  { "all",           WEBKIT_WEBSITE_DATA_ALL }
+};
+
+static bool jumanji_cache_parse_age(const char* age, GTimeSpan* timespan);
+static void cb_jumanji_cache_limit(GObject* source, GAsyncResult* result, gpointer data);
+static void cb_jumanji_cache_report(GObject* source, GAsyncResult* result, gpointer data);
+static void cb_jumanji_cache_cleared(GObject* source, GAsyncResult* result, gpointer data);
+
+bool
+jumanji_cache_init(jumanji_t* jumanji)
+{
+  if (jumanji == NULL || jumanji->ui.session == NULL) {
+    return false;
+  }
+
+  /* get cache dir */
+  char* cache_dir     = NULL;
+  char* cache_dir_tmp = NULL;
+  girara_setting_get(jumanji->ui.session, "cache-dir", &cache_dir_tmp);
+  if (cache_dir_tmp != NULL && cache_dir_tmp[0] != '\0') {
+    cache_dir = girara_fix_path(cache_dir_tmp);
+  } else {
+    cache_dir = g_build_filename(g_get_user_cache_dir(), JUMANJI_CACHE_DIR, NULL);
+  }
+  g_free(cache_dir_tmp);
+
+  if (cache_dir == NULL) {
+    return false;
+  }
+
+  /* only the caches are moved, the other website data stays where webkit
+   * keeps it by default */
+  jumanji->global.website_data = webkit_website_data_manager_new(
+      "base-cache-directory", cache_dir, NULL);
+  g_free(cache_dir);
+
+  if (jumanji->global.website_data == NULL) {
+    return false;
+  }
+
+  jumanji->global.web_context = webkit_web_context_new_with_website_data_manager(
+      jumanji->global.website_data);
+  if (jumanji->global.web_context == NULL) {
+    return false;
+  }
+
+  char* model = NULL;
+  girara_setting_get(jumanji->ui.session, "cache-model", &model);
+  if (jumanji_cache_set_model(jumanji, model) == false) {
+    girara_warning("Unknown cache model '%s'", model);
+  }
+  g_free(model);
+
+  /* webkit does not limit the size of the disk cache, so it is cleared when
+   * it has grown too large */
+  int cache_size = 0;
+  girara_setting_get(jumanji->ui.session, "cache-size", &cache_size);
+  if (cache_size > 0) {
+    webkit_website_data_manager_fetch(jumanji->global.website_data,
+        WEBKIT_WEBSITE_DATA_DISK_CACHE, NULL, cb_jumanji_cache_limit, jumanji);
+  }
+
+  return true;
+}
+
+bool
+jumanji_cache_set_model(jumanji_t* jumanji, const char* model)
+{
+  if (jumanji == NULL || jumanji->global.web_context == NULL) {
+    return false;
+  }
+
+  WebKitCacheModel cache_model;
+  if (model == NULL || g_strcmp0(model, "web-browser") == 0) {
+    cache_model = WEBKIT_CACHE_MODEL_WEB_BROWSER;
+  } else if (g_strcmp0(model, "document-browser") == 0) {
+    cache_model = WEBKIT_CACHE_MODEL_DOCUMENT_BROWSER;
+  } else if (g_strcmp0(model, "document-viewer") == 0) {
+    cache_model = WEBKIT_CACHE_MODEL_DOCUMENT_VIEWER;
+  } else {
+    return false;
+  }
+
+  webkit_web_context_set_cache_model(jumanji->global.web_context, cache_model);
+
+  return true;
+}
+
+void
+jumanji_cache_report(jumanji_t* jumanji)
+{
+  if (jumanji == NULL || jumanji->global.website_data == NULL) {
+    return;
+  }
+
+  webkit_website_data_manager_fetch(jumanji->global.website_data,
+      WEBKIT_WEBSITE_DATA_ALL, NULL, cb_jumanji_cache_report, jumanji);
+}
+
+bool
+jumanji_cache_clear(jumanji_t* jumanji, const char* type, const char* age)
+{
+  if (jumanji == NULL || jumanji->global.website_data == NULL) {
+    return false;
+  }
+
+  WebKitWebsiteDataTypes types = WEBKIT_WEBSITE_DATA_DISK_CACHE | WEBKIT_WEBSITE_DATA_MEMORY_CACHE;
+  if (type != NULL) {
+    types = 0;
+    for (unsigned int i = 0; i < G_N_ELEMENTS(cache_types); i++) {
+      if (g_strcmp0(cache_types[i].name, type) == 0) {
+        types = cache_types[i].types;
+        break;
+      }
+    }
+
+    if (types == 0) {
+      girara_notify(jumanji->ui.session, GIRARA_ERROR, "Unknown cache type: %s", type);
+      return false;
+    }
+  }
+
+  GTimeSpan timespan = 0;
+  if (age != NULL && jumanji_cache_parse_age(age, &timespan) == false) {
+    girara_notify(jumanji->ui.session, GIRARA_ERROR, "Invalid age: %s", age);
+    return false;
+  }
+
+  webkit_website_data_manager_clear(jumanji->global.website_data, types,
+      timespan, NULL, cb_jumanji_cache_cleared, jumanji);
+
+  return true;
+}
+
+void
+cb_settings_cache_model(girara_session_t* session, const char* name,
+    girara_setting_type_t type, void* value, void* data)
+{
+  g_return_if_fail(session != NULL);
+  g_return_if_fail(value != NULL);
+  g_return_if_fail(session->global.data != NULL);
+  jumanji_t* jumanji = (jumanji_t*) session->global.data;
+
+  /* the configuration is loaded before the web context exists */
+  if (jumanji->global.web_context == NULL) {
+    return;
+  }
+
+  if (jumanji_cache_set_model(jumanji, (const char*) value) == false) {
+    girara_notify(session, GIRARA_ERROR, "Unknown cache model: %s", (const char*) value);
+  }
+}
+
+static bool
+jumanji_cache_parse_age(const char* age, GTimeSpan* timespan)
+{
+  char* unit          = NULL;
+  guint64 value       = g_ascii_strtoull(age, &unit, 10);
+  GTimeSpan unit_size = G_TIME_SPAN_SECOND;
+
+  if (unit == age) {
+    return false;
+  }
+
+  if (g_strcmp0(unit, "m") == 0) {
+    unit_size = G_TIME_SPAN_MINUTE;
+  } else if (g_strcmp0(unit, "h") == 0) {
+    unit_size = G_TIME_SPAN_HOUR;
+  } else if (g_strcmp0(unit, "d") == 0) {
+    unit_size = G_TIME_SPAN_DAY;
+  } else if (unit[0] != '\0' && g_strcmp0(unit, "s") != 0) {
+    return false;
+  }
+
+  if (value == 0 || value > (guint64) (G_MAXINT64 / unit_size)) {
+    return false;
+  }
+
+  *timespan = (GTimeSpan) value * unit_size;
+
+  return true;
+}
+
+static void
+cb_jumanji_cache_limit(GObject* source, GAsyncResult* result, gpointer data)
+{
+  jumanji_t* jumanji = (jumanji_t*) data;
+
+  GList* list = webkit_website_data_manager_fetch_finish(WEBKIT_WEBSITE_DATA_MANAGER(source), result, NULL);
+
+  guint64 size = 0;
+  for (GList* entry = list; entry != NULL; entry = g_list_next(entry)) {
+    size += webkit_website_data_get_size((WebKitWebsiteData*) entry->data,
+        WEBKIT_WEBSITE_DATA_DISK_CACHE);
+  }
+  g_list_free_full(list, (GDestroyNotify) webkit_website_data_unref);
+
+  int cache_size = 0;
+  girara_setting_get(jumanji->ui.session, "cache-size", &cache_size);
+  if (cache_size <= 0 || size <= (guint64) cache_size * 1024 * 1024) {
+    return;
+  }
+
+  char* size_text = g_format_size(size);
+  girara_info("Clearing the disk cache (%s)", size_text);
+  g_free(size_text);
+
+  webkit_website_data_manager_clear(WEBKIT_WEBSITE_DATA_MANAGER(source),
+      WEBKIT_WEBSITE_DATA_DISK_CACHE, 0, NULL, NULL, NULL);
+}
+
+static void
+cb_jumanji_cache_report(GObject* source, GAsyncResult* result, gpointer data)
+{
+  jumanji_t* jumanji = (jumanji_t*) data;
+  GError* error      = NULL;
+
+  GList* list = webkit_website_data_manager_fetch_finish(WEBKIT_WEBSITE_DATA_MANAGER(source), result, &error);
+  if (error != NULL) {
+    girara_notify(jumanji->ui.session, GIRARA_ERROR, "Could not fetch the website data: %s", error->message);
+    g_error_free(error);
+    return;
+  }
+
+  guint64 size        = 0;
+  unsigned int cached = 0;
+  for (GList* entry = list; entry != NULL; entry = g_list_next(entry)) {
+    WebKitWebsiteData* website_data = (WebKitWebsiteData*) entry->data;
+    if ((webkit_website_data_get_types(website_data) & WEBKIT_WEBSITE_DATA_DISK_CACHE) != 0) {
+      size += webkit_website_data_get_size(website_data, WEBKIT_WEBSITE_DATA_DISK_CACHE);
+      cached++;
+    }
+  }
+
+  char* size_text = g_format_size(size);
+  int cache_size  = 0;
+  girara_setting_get(jumanji->ui.session, "cache-size", &cache_size);
+
+  if (cache_size > 0) {
+    girara_notify(jumanji->ui.session, GIRARA_INFO,
+        "Disk cache: %s of %d MiB from %u sites, website data of %u sites",
+        size_text, cache_size, cached, g_list_length(list));
+  } else {
+    girara_notify(jumanji->ui.session, GIRARA_INFO,
+        "Disk cache: %s from %u sites, website data of %u sites",
+        size_text, cached, g_list_length(list));
+  }
+
+  g_free(size_text);
+  g_list_free_full(list, (GDestroyNotify) webkit_website_data_unref);
+}
+
+static void
+cb_jumanji_cache_cleared(GObject* source, GAsyncResult* result, gpointer data)
+{
+  jumanji_t* jumanji = (jumanji_t*) data;
+  GError* error      = NULL;
+
+  if (webkit_website_data_manager_clear_finish(WEBKIT_WEBSITE_DATA_MANAGER(source), result, &error) == FALSE) {
+    girara_notify(jumanji->ui.session, GIRARA_ERROR, "Could not clear the website data: %s", error->message);
+    g_error_free(error);
+    return;
+  }
+
+  girara_notify(jumanji->ui.session, GIRARA_INFO, "Cleared the website data");
+}
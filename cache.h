@@ -0,0 +1,63 @@
+/* See LICENSE file for license and copyright information */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <girara/types.h>
+
+#include "jumanji.h"
+
+#define JUMANJI_CACHE_DIR "jumanji"
+
+/**
+ * Creates the website data manager and the web context of the tabs. The
+ * disk cache is stored in cache-dir and cleared on startup if it is larger
+ * than cache-size.
+ *
+ * @param jumanji The jumanji session
+ * @return true if no error occured
+ */
+bool jumanji_cache_init(jumanji_t* jumanji);
+
+/**
+ * Sets the memory cache model of the web context
+ *
+ * @param jumanji The jumanji session
+ * @param model One of web-browser, document-browser and document-viewer
+ * @return false if the model is unknown
+ */
+bool jumanji_cache_set_model(jumanji_t* jumanji, const char* model);
+
+/**
+ * Reports the size of the disk cache and the number of sites that store
+ * website data
+ *
+ * @param jumanji The jumanji session
+ */
+void jumanji_cache_report(jumanji_t* jumanji);
+
+/**
+ * Clears website data
+ *
+ * @param jumanji The jumanji session
+ * @param type The type of the data (disk, memory, offline, local-storage,
+ *   indexeddb, cookies or all) or NULL for the disk and memory caches
+ * @param age Only clear data that was modified within this time, e.g. 30m,
+ *   12h or 7d, or NULL to clear everything
+ * @return false if the type or the age is invalid
+ */
+bool jumanji_cache_clear(jumanji_t* jumanji, const char* type, const char* age);
+
+/**
+ * Called when the cache-model setting has been changed
+ *
+ * @param session The girara session
+ * @param name The name of the setting
+ * @param type The type of the setting
+ * @param value The new value
+ * @param data Custom data
+ */
+void cb_settings_cache_model(girara_session_t* session, const char* name,
+    girara_setting_type_t type, void* value, void* data);
+
+#endif // CACHE_H
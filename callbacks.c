@@ -14,6 +14,8 @@
 #include "download.h"
 #include "shortcuts.h"
 #include "soup.h"
+#include "websettings.h"
+#include "sites.h"
 #include "jumanji.h"
 
 gboolean
@@ -73,6 +75,14 @@ cb_jumanji_tab_load_changed(WebKitWebView* web_view, WebKitLoadEvent load_event,
   const gchar* url   = webkit_web_view_get_uri(WEBKIT_WEB_VIEW(tab->web_view));
   const gchar* title = webkit_web_view_get_title(WEBKIT_WEB_VIEW(tab->web_view));
 
+  /* the uri is the provisional one until the load is committed, so the
+   * content rules of the site apply to the new page; once it is committed
+   * they are applied again in case the page ended up elsewhere */
+  if (load_event == WEBKIT_LOAD_STARTED || load_event == WEBKIT_LOAD_REDIRECTED ||
+      load_event == WEBKIT_LOAD_COMMITTED) {
+    jumanji_tab_sites_apply(tab, url);
+  }
+
   if (load_event == WEBKIT_LOAD_FINISHED) {
     bool enable_private_browsing = true;
     girara_setting_get(tab->jumanji->ui.session, "enable-private-browsing", &enable_private_browsing);
@@ -81,19 +91,28 @@ cb_jumanji_tab_load_changed(WebKitWebView* web_view, WebKitLoadEvent load_event,
     }
   }
 
-  unsigned int position = girara_tab_position_get(tab->jumanji->ui.session, tab->girara_tab) + 1;
-  title = title ? title : "Loading...";
-
-  char* text = g_strdup_printf("%d | %s", position, title);
-  girara_tab_title_set(tab->girara_tab, text);
-  g_free(text);
+  jumanji_tab_update_title(tab);
 
   if (tab == jumanji_tab_get_current(tab->jumanji)) {
-    const gchar* url = webkit_web_view_get_uri(WEBKIT_WEB_VIEW(tab->web_view));
-    girara_statusbar_item_set_text(tab->jumanji->ui.session, tab->jumanji->ui.statusbar.url, url ? (char*) url : "Loading...");
+    jumanji_statusbar_set_url(tab->jumanji, url);
   }
 }
 
+gboolean
+cb_jumanji_tab_load_failed(WebKitWebView* web_view, WebKitLoadEvent load_event,
+    gchar* failing_uri, GError* error, jumanji_tab_t* tab)
+{
+  if (web_view == NULL || tab == NULL) {
+    return FALSE;
+  }
+
+  /* a failed load leaves the tab with the page it showed before, so the
+   * rules of that page apply again */
+  jumanji_tab_sites_apply(tab, webkit_web_view_get_uri(web_view));
+
+  return FALSE;
+}
+
 void
 cb_jumanji_tab_changed(GtkNotebook* tabs, GtkWidget* page, guint page_num, jumanji_t* jumanji)
 {
@@ -108,8 +127,7 @@ cb_jumanji_tab_changed(GtkNotebook* tabs, GtkWidget* page, guint page_num, juman
   }
 
   if (jumanji->ui.statusbar.url != NULL) {
-    const gchar* url = webkit_web_view_get_uri(WEBKIT_WEB_VIEW(tab->web_view));
-    girara_statusbar_item_set_text(jumanji->ui.session, jumanji->ui.statusbar.url, url ? (char*) url : "Loading...");
+    jumanji_statusbar_set_url(jumanji, webkit_web_view_get_uri(WEBKIT_WEB_VIEW(tab->web_view)));
   }
 
   if (jumanji->ui.statusbar.tabs != NULL) {
@@ -161,10 +179,14 @@ cb_jumanji_tab_mouse_target_changed(WebKitWebView* web_view,
 
   const gchar* link = webkit_hit_test_result_get_link_uri(hit_test_result);
   if (link != NULL) {
-    girara_statusbar_item_set_text(tab->jumanji->ui.session, tab->jumanji->ui.statusbar.url, link);
+    jumanji_statusbar_set_url(tab->jumanji, link);
+
+    /* tabs with a proxy of their own do not resolve hosts themselves */
+    if (tab->proxy == NULL) {
+      jumanji_prefetch_dns(tab->jumanji, link);
+    }
   } else {
-    const gchar* url = webkit_web_view_get_uri(WEBKIT_WEB_VIEW(tab->web_view));
-    girara_statusbar_item_set_text(tab->jumanji->ui.session, tab->jumanji->ui.statusbar.url, url ? (char*) url : "Loading...");
+    jumanji_statusbar_set_url(tab->jumanji, webkit_web_view_get_uri(WEBKIT_WEB_VIEW(tab->web_view)));
   }
 }
 
@@ -194,16 +216,6 @@ cb_jumanji_tab_web_inspector(WebKitWebInspector* inspector, WebKitWebView* web_v
   return WEBKIT_WEB_VIEW(new_web_view);
 }
 
-//bool
-//cb_jumanji_tab_download_requested(WebKitWebView* web_view, WebKitDownload* download, jumanji_tab_t* tab)
-//{
-//  if (tab == NULL || tab->jumanji == NULL || download == NULL) {
-//    return false;
-//  }
-//
-//  return jumanji_download_file(tab->jumanji, download);
-//}
-
 static bool
 jumanji_tab_mime_policy(WebKitWebView* web_view,
     WebKitResponsePolicyDecision* decision,
@@ -290,44 +302,92 @@ cb_settings_webkit(girara_session_t* session, const char* name, girara_setting_t
   g_return_if_fail(session->global.data != NULL);
   jumanji_t* jumanji = (jumanji_t*) session->global.data;
 
-  WebKitSettings* browser_settings = NULL;
-  jumanji_tab_t* tab                  = jumanji_tab_get_current(jumanji);
-
-  /* get settings */
-  if (girara_get_number_of_tabs(session) == 0) {
-    browser_settings = jumanji->global.browser_settings;
-  } else if (tab != NULL) {
-    browser_settings = webkit_web_view_get_settings(WEBKIT_WEB_VIEW(tab->web_view));
-  } else {
-    return;
-  }
+  jumanji_tab_t* tab = jumanji_tab_get_current(jumanji);
 
   /* special case: set value in webkitview */
   if (g_strcmp0(name, "full-content-zoom") == 0) {
     if (tab && tab->web_view) {
       g_object_set(G_OBJECT(tab->web_view), name, *(bool*)value, NULL);
     }
-  } else if (browser_settings != NULL) {
-    switch (type) {
-      case STRING:
-        g_object_set(G_OBJECT(browser_settings), name, (const char*) value, NULL);
-        break;
-      case INT:
-        g_object_set(G_OBJECT(browser_settings), name, *(int*) value, NULL);
-        break;
-      case FLOAT:
-        g_object_set(G_OBJECT(browser_settings), name, *(float*) value, NULL);
-        break;
-      case BOOLEAN:
-        g_object_set(G_OBJECT(browser_settings), name, *(bool*) value, NULL);
-        break;
-      default:
-        return;
+    return;
+  }
+
+  GValue gvalue = G_VALUE_INIT;
+  switch (type) {
+    case STRING:
+      g_value_init(&gvalue, G_TYPE_STRING);
+      g_value_set_string(&gvalue, (const char*) value);
+      break;
+    case INT:
+      g_value_init(&gvalue, G_TYPE_INT);
+      g_value_set_int(&gvalue, *(int*) value);
+      break;
+    case FLOAT:
+      g_value_init(&gvalue, G_TYPE_FLOAT);
+      g_value_set_float(&gvalue, *(float*) value);
+      break;
+    case BOOLEAN:
+      g_value_init(&gvalue, G_TYPE_BOOLEAN);
+      g_value_set_boolean(&gvalue, *(bool*) value);
+      break;
+    default:
+      return;
+  }
+
+  /* all tabs share the settings, so the value is set once */
+  bool applied = jumanji_settings_set(jumanji, name, &gvalue);
+  g_value_unset(&gvalue);
+
+  if (applied == false) {
+    if (jumanji->config.loading == false) {
+      girara_notify(session, GIRARA_WARNING, "Setting is not supported by webkit: %s", name);
+    }
+    return;
+  }
+
+  /* webkit applies most settings to the shown page, only those that
+   * change how a page is loaded require a reload */
+  if (jumanji_settings_need_reload(name) == false) {
+    return;
+  }
+
+  /* a configuration file reloads every affected tab at most once after it
+   * has been parsed, otherwise only the current page is reloaded */
+  if (jumanji->config.loading == true) {
+    int number_of_tabs = girara_get_number_of_tabs(session);
+    for (int i = 0; i < number_of_tabs; i++) {
+      jumanji_tab_t* other = jumanji_tab_get_nth(jumanji, i);
+      if (other != NULL && jumanji_tab_settings_overridden(other, name) == false) {
+        other->reload = true;
+      }
     }
+  } else if (tab != NULL && jumanji_tab_settings_overridden(tab, name) == false) {
+    webkit_web_view_reload(WEBKIT_WEB_VIEW(tab->web_view));
+  }
+}
+
+void
+cb_settings_spell_checking(girara_session_t* session, const char* name,
+    girara_setting_type_t type, void* value, void* data)
+{
+  g_return_if_fail(session != NULL);
+  g_return_if_fail(session->global.data != NULL);
+  jumanji_t* jumanji = (jumanji_t*) session->global.data;
+
+  /* the configuration is loaded before the web context exists */
+  jumanji_settings_spell_checking_apply(jumanji, jumanji->global.web_context);
+}
+
+void
+cb_settings_user_stylesheet(girara_session_t* session, const char* name,
+    girara_setting_type_t type, void* value, void* data)
+{
+  g_return_if_fail(session != NULL);
+  g_return_if_fail(session->global.data != NULL);
+  jumanji_t* jumanji = (jumanji_t*) session->global.data;
 
-    /* reload website */
-    girara_argument_t argument = { 0, NULL };
-    sc_reload(session, &argument, NULL, 0);
+  if (jumanji_settings_user_stylesheet_apply(jumanji, (const char*) value) == false) {
+    girara_notify(session, GIRARA_ERROR, "Could not load stylesheet: %s", (const char*) value);
   }
 }
 
@@ -41,6 +41,19 @@ void cb_jumanji_tab_destroy(GObject* object, jumanji_tab_t* tab);
  */
 void cb_jumanji_tab_load_changed(WebKitWebView* web_view, WebKitLoadEvent load_event, jumanji_tab_t* tab);
 
+/**
+ * Applies the content rules of the shown page again after a load failed
+ *
+ * @param web_view Webkit web view
+ * @param load_event The load event in which the load failed
+ * @param failing_uri The uri that failed to load
+ * @param error The error
+ * @param tab The tab
+ * @return FALSE to let webkit show its error page
+ */
+gboolean cb_jumanji_tab_load_failed(WebKitWebView* web_view, WebKitLoadEvent load_event,
+    gchar* failing_uri, GError* error, jumanji_tab_t* tab);
+
 /**
  * Updates the statusbar entry
  *
@@ -106,6 +119,31 @@ bool cb_jumanji_tab_decide_policy(WebKitWebView* web_view,
  */
 void cb_settings_webkit(girara_session_t* session, const char* name, girara_setting_type_t type, void* value, void* data);
 
+/**
+ * Called when enable-spell-checking or spell-checking-languages has been
+ * changed
+ *
+ * @param session The girara session
+ * @param name Name of the setting
+ * @param type Type of the setting
+ * @param value The new value
+ * @param data Custom data
+ */
+void cb_settings_spell_checking(girara_session_t* session, const char* name,
+    girara_setting_type_t type, void* value, void* data);
+
+/**
+ * Called when user-stylesheet-uri has been changed
+ *
+ * @param session The girara session
+ * @param name Name of the setting
+ * @param type Type of the setting
+ * @param value The new value
+ * @param data Custom data
+ */
+void cb_settings_user_stylesheet(girara_session_t* session, const char* name,
+    girara_setting_type_t type, void* value, void* data);
+
 /**
  * Executed when someone clicks the statusbar entry
  *
@@ -7,9 +7,14 @@
 #include <girara/shortcuts.h>
 #include <girara/settings.h>
 
+#include "cache.h"
 #include "commands.h"
 #include "database.h"
+#include "download.h"
 #include "jumanji.h"
+#include "prerender.h"
+#include "websettings.h"
+#include "sites.h"
 
 bool
 cmd_bookmark_add(girara_session_t* session, girara_list_t* argument_list)
@@ -91,6 +96,31 @@ cmd_buffer_delete(girara_session_t* session, girara_list_t* argument_list)
   return true;
 }
 
+bool
+cmd_cache(girara_session_t* session, girara_list_t* argument_list)
+{
+  g_return_val_if_fail(session != NULL, false);
+  g_return_val_if_fail(session->global.data != NULL, false);
+  jumanji_t* jumanji = (jumanji_t*) session->global.data;
+
+  unsigned int number_of_arguments = girara_list_size(argument_list);
+  if (number_of_arguments == 0) {
+    jumanji_cache_report(jumanji);
+    return true;
+  }
+
+  char* action = (char*) girara_list_nth(argument_list, 0);
+  if (g_strcmp0(action, "clear") != 0 || number_of_arguments > 3) {
+    girara_notify(session, GIRARA_ERROR, "Usage: cache [clear [type] [age]]");
+    return false;
+  }
+
+  char* type = (number_of_arguments > 1) ? (char*) girara_list_nth(argument_list, 1) : NULL;
+  char* age  = (number_of_arguments > 2) ? (char*) girara_list_nth(argument_list, 2) : NULL;
+
+  return jumanji_cache_clear(jumanji, type, age);
+}
+
 bool
 cmd_downloads(girara_session_t* session, girara_list_t* argument_list)
 {
@@ -98,6 +128,30 @@ cmd_downloads(girara_session_t* session, girara_list_t* argument_list)
   g_return_val_if_fail(session->global.data != NULL, false);
   jumanji_t* jumanji = (jumanji_t*) session->global.data;
 
+  /* cancel the download with the given number */
+  unsigned int number_of_arguments = girara_list_size(argument_list);
+  if (number_of_arguments > 0) {
+    char* action = (char*) girara_list_nth(argument_list, 0);
+    char* number = (number_of_arguments > 1) ? (char*) girara_list_nth(argument_list, 1) : NULL;
+    char* end    = NULL;
+    guint64 n    = (number != NULL) ? g_ascii_strtoull(number, &end, 10) : 0;
+
+    if (g_strcmp0(action, "cancel") != 0 || number_of_arguments != 2 || end == number ||
+        *end != '\0' || n == 0 || n > girara_list_size(jumanji->downloads.list)) {
+      girara_notify(session, GIRARA_ERROR, "Usage: downloads [cancel <number>]");
+      return false;
+    }
+
+    jumanji_download_t* download = (jumanji_download_t*)
+      girara_list_nth(jumanji->downloads.list, (unsigned int) n - 1);
+    if (jumanji_download_cancel(download) == false) {
+      girara_notify(session, GIRARA_ERROR, "Download %u is not running", (unsigned int) n);
+      return false;
+    }
+
+    return true;
+  }
+
   if (gtk_widget_get_visible(GTK_WIDGET(session->gtk.tabs)) == TRUE) {
     gtk_widget_hide(GTK_WIDGET(session->gtk.tabbar));
     gtk_widget_hide(GTK_WIDGET(session->gtk.tabs));
@@ -117,8 +171,13 @@ cmd_open(girara_session_t* session, girara_list_t* argument_list)
   g_return_val_if_fail(session->global.data != NULL, false);
   jumanji_t* jumanji = (jumanji_t*) session->global.data;
 
-  char* url = jumanji_build_url(jumanji, argument_list);
-  jumanji_tab_load_url(jumanji_tab_get_current(jumanji), url);
+  char* url          = jumanji_build_url(jumanji, argument_list);
+  jumanji_tab_t* tab = jumanji_tab_get_current(jumanji);
+
+  /* the page may already have been loaded while the command was typed */
+  if (prerender_take(jumanji, tab, url) == false) {
+    jumanji_tab_load_url(tab, url);
+  }
   free(url);
 
   return true;
@@ -205,6 +264,7 @@ cmd_proxy(girara_session_t* session, girara_list_t* argument_list)
 
   proxy->url         = url;
   proxy->description = g_strdup(description);
+  proxy->context     = NULL;
 
   girara_list_append(jumanji->global.proxies, proxy);
 
@@ -320,6 +380,177 @@ cmd_tabopen(girara_session_t* session, girara_list_t* argument_list)
   return true;
 }
 
+bool
+cmd_siterule(girara_session_t* session, girara_list_t* argument_list)
+{
+  g_return_val_if_fail(session != NULL, false);
+  g_return_val_if_fail(session->global.data != NULL, false);
+  jumanji_t* jumanji = (jumanji_t*) session->global.data;
+
+  unsigned int number_of_arguments = girara_list_size(argument_list);
+  if (number_of_arguments < 1) {
+    girara_notify(session, GIRARA_ERROR, "Usage: siterule <host> [images] [scripts] [autoplay] [media]");
+    return false;
+  }
+
+  /* rules are looked up by host, so an uri is reduced to its host */
+  const char* argument = (const char*) girara_list_nth(argument_list, 0);
+  char* uri            = (strstr(argument, "://") != NULL) ? g_strdup(argument)
+    : g_strconcat("http://", argument, NULL);
+  SoupURI* soup_uri    = soup_uri_new(uri);
+  g_free(uri);
+
+  if (soup_uri == NULL || soup_uri->host == NULL || soup_uri->host[0] == '\0') {
+    girara_notify(session, GIRARA_ERROR, "Invalid host: %s", argument);
+    if (soup_uri != NULL) {
+      soup_uri_free(soup_uri);
+    }
+    return false;
+  }
+
+  char* host = g_strdup(soup_uri->host);
+  soup_uri_free(soup_uri);
+
+  /* without rules the host is removed */
+  unsigned int rules = 0;
+  for (unsigned int i = 1; i < number_of_arguments; i++) {
+    const char* name  = (const char*) girara_list_nth(argument_list, i);
+    unsigned int rule = 0;
+    if (jumanji_sites_parse_rule(name, &rule) == false) {
+      girara_notify(session, GIRARA_ERROR, "Unknown rule: %s (images, scripts, autoplay or media)", name);
+      g_free(host);
+      return false;
+    }
+
+    rules |= rule;
+  }
+
+  bool set = jumanji_sites_set(jumanji, host, rules);
+  g_free(host);
+
+  if (set == false) {
+    return false;
+  }
+
+  /* the current page is shown with the new rules */
+  jumanji_tab_t* tab = jumanji_tab_get_current(jumanji);
+  if (tab != NULL && tab->web_view != NULL) {
+    const char* uri = webkit_web_view_get_uri(WEBKIT_WEB_VIEW(tab->web_view));
+    unsigned int site_rules = tab->site_rules;
+    jumanji_tab_sites_apply(tab, uri);
+    if (site_rules != tab->site_rules) {
+      webkit_web_view_reload(WEBKIT_WEB_VIEW(tab->web_view));
+    }
+  }
+
+  return true;
+}
+
+bool
+cmd_tabset(girara_session_t* session, girara_list_t* argument_list)
+{
+  g_return_val_if_fail(session != NULL, false);
+  g_return_val_if_fail(session->global.data != NULL, false);
+  jumanji_t* jumanji = (jumanji_t*) session->global.data;
+
+  unsigned int number_of_arguments = girara_list_size(argument_list);
+  jumanji_tab_t* tab               = jumanji_tab_get_current(jumanji);
+  if (number_of_arguments < 1 || tab == NULL) {
+    return false;
+  }
+
+  const char* name = (const char*) girara_list_nth(argument_list, 0);
+
+  /* without a value the tab follows the shared setting again */
+  if (number_of_arguments == 1) {
+    if (jumanji_tab_settings_reset(tab, name) == false) {
+      girara_notify(session, GIRARA_ERROR, "Setting is not overridden: %s", name);
+      return false;
+    }
+  } else {
+    const char* value = (const char*) girara_list_nth(argument_list, 1);
+    if (jumanji_tab_settings_override(tab, name, value) == false) {
+      girara_notify(session, GIRARA_ERROR, "Invalid setting: %s %s", name, value);
+      return false;
+    }
+  }
+
+  if (jumanji_settings_need_reload(name) == true) {
+    webkit_web_view_reload(WEBKIT_WEB_VIEW(tab->web_view));
+  }
+
+  return true;
+}
+
+bool
+cmd_tabproxy(girara_session_t* session, girara_list_t* argument_list)
+{
+  g_return_val_if_fail(session != NULL, false);
+  g_return_val_if_fail(session->global.data != NULL, false);
+  jumanji_t* jumanji = (jumanji_t*) session->global.data;
+
+  unsigned int number_of_arguments = girara_list_size(argument_list);
+  if (number_of_arguments < 1 || girara_list_size(jumanji->global.proxies) == 0) {
+    return false;
+  }
+
+  /* the proxy is given by its url or its description */
+  char* identifier       = (char*) girara_list_nth(argument_list, 0);
+  jumanji_proxy_t* proxy = NULL;
+
+  girara_list_iterator_t* iter = girara_list_iterator(jumanji->global.proxies);
+  do {
+    jumanji_proxy_t* candidate = (jumanji_proxy_t*) girara_list_iterator_data(iter);
+    if (candidate == NULL) {
+      continue;
+    }
+
+    if (g_strcmp0(candidate->url, identifier) == 0 ||
+        g_strcmp0(candidate->description, identifier) == 0) {
+      proxy = candidate;
+      break;
+    }
+  } while (girara_list_iterator_next(iter));
+  girara_list_iterator_free(iter);
+
+  if (proxy == NULL) {
+    girara_notify(session, GIRARA_ERROR, "Unknown proxy: %s", identifier);
+    return false;
+  }
+
+  /* open the remaining arguments or the current page */
+  char* url = NULL;
+  if (number_of_arguments > 1) {
+    girara_list_t* url_arguments = girara_list_new();
+    if (url_arguments == NULL) {
+      return false;
+    }
+
+    for (unsigned int i = 1; i < number_of_arguments; i++) {
+      girara_list_append(url_arguments, girara_list_nth(argument_list, i));
+    }
+
+    url = jumanji_build_url(jumanji, url_arguments);
+    girara_list_free(url_arguments);
+  } else {
+    jumanji_tab_t* tab = jumanji_tab_get_current(jumanji);
+    const char* uri    = (tab != NULL) ?
+      webkit_web_view_get_uri(WEBKIT_WEB_VIEW(tab->web_view)) : NULL;
+    url = (uri != NULL) ? g_strdup(uri) : jumanji_build_url_from_string(jumanji, "");
+  }
+
+  if (url == NULL) {
+    return false;
+  }
+
+  bool focus_new_tabs;
+  girara_setting_get(jumanji->ui.session, "focus-new-tabs", &focus_new_tabs);
+  jumanji_tab_new_with_proxy(jumanji, url, focus_new_tabs, proxy);
+  free(url);
+
+  return true;
+}
+
 bool
 cmd_winopen(girara_session_t* session, girara_list_t* argument_list)
 {
@@ -34,7 +34,17 @@ bool cmd_bookmark_delete(girara_session_t* session, girara_list_t* argument_list
 bool cmd_buffer_delete(girara_session_t* session, girara_list_t* argument_list);
 
 /**
- * Show the download widget
+ * Report the size of the cache or clear it (:cache clear [type] [age])
+ *
+ * @param session The used girara session
+ * @param argument_list List of passed arguments
+ * @return true if no error occured
+ */
+bool cmd_cache(girara_session_t* session, girara_list_t* argument_list);
+
+/**
+ * Show the download widget or cancel a download, counted from the top of
+ * the widget
  *
  * @param session The used girara session
  * @param argument_list List of passed arguments
@@ -107,6 +117,37 @@ bool cmd_stop(girara_session_t* session, girara_list_t* argument_list);
  */
 bool cmd_tabopen(girara_session_t* session, girara_list_t* argument_list);
 
+/**
+ * Set the content rules (images, scripts, autoplay, media) that are blocked
+ * on a host and its subdomains or, without rules, remove the host. An uri
+ * is reduced to its host.
+ *
+ * @param session The used girara session
+ * @param argument_list List of passed arguments
+ * @return true if no error occured
+ */
+bool cmd_siterule(girara_session_t* session, girara_list_t* argument_list);
+
+/**
+ * Override a webkit setting for the current tab or, without a value, use
+ * the shared setting again
+ *
+ * @param session The used girara session
+ * @param argument_list List of passed arguments
+ * @return true if no error occured
+ */
+bool cmd_tabset(girara_session_t* session, girara_list_t* argument_list);
+
+/**
+ * Open URL in a new tab that only uses the given proxy. Without an URL the
+ * current page is opened.
+ *
+ * @param session The used girara session
+ * @param argument_list List of passed arguments
+ * @return true if no error occured
+ */
+bool cmd_tabproxy(girara_session_t* session, girara_list_t* argument_list);
+
 /**
  * Open URL in a new window
  *
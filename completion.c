@@ -3,6 +3,7 @@
 #include <girara/completion.h>
 #include <girara/datastructures.h>
 #include <girara/session.h>
+#include <girara/settings.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -10,8 +11,44 @@
 
 #include "completion.h"
 #include "database.h"
+#include "prerender.h"
+#include "soup.h"
 #include "utils.h"
 
+#define COMPLETION_THREADS 2
+
+struct jumanji_completion_query_s
+{
+  char* input; /**> Input the results match */
+  jumanji_db_results_t* bookmarks; /**> Matching bookmarks */
+  jumanji_db_results_t* history; /**> Matching history entries */
+  jumanji_completion_query_t* base; /**> Query whose results are refined or NULL */
+  jumanji_database_t* database; /**> The database */
+  bool fuzzy; /**> true if the input is matched fuzzily */
+  GCancellable* cancellable; /**> Cancelled once the query is stale */
+  bool done; /**> true if the query has finished */
+  GMutex lock; /**> Protects the results and the done flag */
+  GCond cond; /**> Signaled once the query has finished */
+  gint ref_count; /**> Reference count */
+};
+
+/* commands that use cc_open */
+static const char* completion_open_commands[] = {
+  "open", "o", "tabopen", "t", "winopen", "w"
+};
+
+/* forward declarations */
+static jumanji_completion_query_t* completion_query_new(jumanji_t* jumanji,
+    const char* input, bool fuzzy, jumanji_completion_query_t* base);
+static jumanji_completion_query_t* completion_query_ref(jumanji_completion_query_t* query);
+static void completion_query_unref(jumanji_completion_query_t* query);
+static void completion_query_run(gpointer data, gpointer user_data);
+static void completion_query_wait(jumanji_completion_query_t* query);
+static jumanji_db_results_t* completion_filter_links(jumanji_db_results_t*
+    links, const char* input, bool fuzzy);
+static void completion_add_links(girara_session_t* session, girara_completion_t*
+    completion, const char* name, jumanji_db_results_t* links);
+
 girara_completion_t*
 cc_open(girara_session_t* session, const char* input)
 {
@@ -44,7 +81,6 @@ cc_open(girara_session_t* session, const char* input)
       if (strncmp(input, search_engine->identifier, strlen(input)) == 0) {
         number_of_matching++;
         girara_completion_group_add_element(group, search_engine->identifier, search_engine->url);
-        break;
       }
     } while (girara_list_iterator_next(iter));
     girara_list_iterator_free(iter);
@@ -58,59 +94,32 @@ cc_open(girara_session_t* session, const char* input)
 
   group = NULL;
 
-  /* search history */
-  girara_list_t* bookmark_list = jumanji_db_bookmark_find(jumanji->database, input);
-
-  if (bookmark_list != NULL) {
-    int bookmark_length = girara_list_size(bookmark_list);
-
-    /* add group entry */
-    if (bookmark_length > 0) {
-      group = girara_completion_group_create(session, "Bookmarks");
-      if (group == NULL) {
-        goto error_free;
-      } else {
-        for (int i = 0; i < bookmark_length; i++) {
-          jumanji_db_result_link_t* link = (jumanji_db_result_link_t*) girara_list_nth(bookmark_list, i);
-          if (link != NULL) {
-            girara_completion_group_add_element(group, link->url, link->title);
-          }
-        }
-
-        girara_completion_add_group(completion, group);
-      }
-    }
+  /* the query has usually been started while the input was typed; if not, it
+   * is started now */
+  completion_query_start(jumanji, input);
 
-    girara_list_free(bookmark_list);
+  jumanji_completion_query_t* query = completion_query_ref(jumanji->completion.query);
+  if (query == NULL) {
+    return completion;
   }
 
+  completion_query_wait(query);
+
   /* search bookmarks */
-  group                       = NULL;
-  girara_list_t* history_list = jumanji_db_history_find(jumanji->database, input);
-
-  if (history_list != NULL) {
-    int history_length = girara_list_size(history_list);
-
-    /* add group entry */
-    if (history_length > 0) {
-      group = girara_completion_group_create(session, "History");
-      if (group == NULL) {
-        goto error_free;
-      } else {
-        for (int i = 0; i < history_length; i++) {
-          jumanji_db_result_link_t* link = (jumanji_db_result_link_t*) girara_list_nth(history_list, i);
-          if (link != NULL) {
-            girara_completion_group_add_element(group, link->url, link->title);
-          }
-        }
-
-        girara_completion_add_group(completion, group);
-      }
-    }
+  completion_add_links(session, completion, "Bookmarks", query->bookmarks);
+
+  /* search history */
+  completion_add_links(session, completion, "History", query->history);
 
-    girara_list_free(history_list);
+  /* the top candidate is the most likely next navigation */
+  jumanji_db_results_t* top = (jumanji_db_results_size(query->bookmarks) > 0) ?
+    query->bookmarks : query->history;
+  if (jumanji_db_results_size(top) > 0) {
+    jumanji_prefetch_dns(jumanji, jumanji_db_results_get(top, 0)->url);
   }
 
+  completion_query_unref(query);
+
   return completion;
 
 error_free:
@@ -125,3 +134,332 @@ error_free:
 
   return NULL;
 }
+
+bool
+completion_init(jumanji_t* jumanji)
+{
+  if (jumanji == NULL) {
+    return false;
+  }
+
+  jumanji->completion.pool = g_thread_pool_new(completion_query_run, NULL,
+      COMPLETION_THREADS, FALSE, NULL);
+
+  return (jumanji->completion.pool != NULL);
+}
+
+void
+completion_free(jumanji_t* jumanji)
+{
+  if (jumanji == NULL) {
+    return;
+  }
+
+  if (jumanji->completion.query != NULL) {
+    g_cancellable_cancel(jumanji->completion.query->cancellable);
+    completion_query_unref(jumanji->completion.query);
+    jumanji->completion.query = NULL;
+  }
+
+  /* every queued query has been cancelled, so this does not take long */
+  if (jumanji->completion.pool != NULL) {
+    g_thread_pool_free(jumanji->completion.pool, FALSE, TRUE);
+    jumanji->completion.pool = NULL;
+  }
+}
+
+void
+completion_query_start(jumanji_t* jumanji, const char* input)
+{
+  if (jumanji == NULL || input == NULL) {
+    return;
+  }
+
+  jumanji_completion_query_t* current = jumanji->completion.query;
+
+  bool fuzzy = true;
+  girara_setting_get(jumanji->ui.session, "fuzzy-completion", &fuzzy);
+
+  /* the query is already running */
+  if (current != NULL && current->fuzzy == fuzzy &&
+      g_strcmp0(current->input, input) == 0) {
+    return;
+  }
+
+  /* refine the last results if the input has only been extended, otherwise
+   * the last query is stale */
+  jumanji_completion_query_t* base = NULL;
+  if (current != NULL) {
+    g_mutex_lock(&(current->lock));
+    if (current->done == true && current->fuzzy == fuzzy &&
+        current->bookmarks != NULL && current->history != NULL &&
+        strncmp(input, current->input, strlen(current->input)) == 0) {
+      base = current;
+    }
+    g_mutex_unlock(&(current->lock));
+
+    if (base == NULL) {
+      g_cancellable_cancel(current->cancellable);
+    }
+  }
+
+  jumanji_completion_query_t* query = completion_query_new(jumanji, input,
+      fuzzy, base);
+  if (query == NULL) {
+    return;
+  }
+
+  jumanji->completion.query = query;
+  completion_query_unref(current);
+
+  /* the worker holds its own reference */
+  completion_query_ref(query);
+  if (jumanji->completion.pool == NULL ||
+      g_thread_pool_push(jumanji->completion.pool, query, NULL) == FALSE) {
+    completion_query_run(query, NULL);
+  }
+}
+
+bool
+completion_query_candidate(jumanji_t* jumanji, char** uri)
+{
+  *uri = NULL;
+
+  jumanji_completion_query_t* query = jumanji->completion.query;
+  if (query == NULL) {
+    return true;
+  }
+
+  g_mutex_lock(&(query->lock));
+  bool done = query->done;
+  if (done == true) {
+    size_t number_of_bookmarks = jumanji_db_results_size(query->bookmarks);
+    size_t number_of_history   = jumanji_db_results_size(query->history);
+
+    const jumanji_db_result_link_t* bookmark = (number_of_bookmarks == 1) ?
+      jumanji_db_results_get(query->bookmarks, 0) : NULL;
+    const jumanji_db_result_link_t* history  = (number_of_history == 1) ?
+      jumanji_db_results_get(query->history, 0) : NULL;
+
+    if (number_of_bookmarks + number_of_history == 1) {
+      *uri = g_strdup((bookmark != NULL) ? bookmark->url : history->url);
+    } else if (bookmark != NULL && history != NULL &&
+        g_strcmp0(bookmark->url, history->url) == 0) {
+      *uri = g_strdup(bookmark->url);
+    }
+  }
+  g_mutex_unlock(&(query->lock));
+
+  return done;
+}
+
+void
+cb_completion_inputbar_changed(GtkEditable* editable, jumanji_t* jumanji)
+{
+  if (editable == NULL || jumanji == NULL) {
+    return;
+  }
+
+  gchar* text = gtk_editable_get_chars(editable, 0, -1);
+  if (text == NULL || text[0] != ':') {
+    g_free(text);
+    return;
+  }
+
+  /* split the input the same way girara does before it calls the completion
+   * function */
+  gchar** argv = NULL;
+  gint    argc = 0;
+
+  if (g_shell_parse_argv(text + 1, &argc, &argv, NULL) == FALSE) {
+    g_free(text);
+    return;
+  }
+
+  for (unsigned int i = 0; i < G_N_ELEMENTS(completion_open_commands); i++) {
+    if (g_strcmp0(argv[0], completion_open_commands[i]) == 0) {
+      completion_query_start(jumanji, (argc > 1) ? argv[1] : "");
+      prerender_schedule(jumanji);
+      break;
+    }
+  }
+
+  g_strfreev(argv);
+  g_free(text);
+}
+
+static jumanji_completion_query_t*
+completion_query_new(jumanji_t* jumanji, const char* input, bool fuzzy,
+    jumanji_completion_query_t* base)
+{
+  jumanji_completion_query_t* query = g_malloc0(sizeof(jumanji_completion_query_t));
+  if (query == NULL) {
+    return NULL;
+  }
+
+  query->input       = g_strdup(input);
+  query->base        = completion_query_ref(base);
+  query->database    = jumanji->database;
+  query->fuzzy       = fuzzy;
+  query->cancellable = g_cancellable_new();
+  query->done        = false;
+  query->ref_count   = 1;
+
+  g_mutex_init(&(query->lock));
+  g_cond_init(&(query->cond));
+
+  return query;
+}
+
+static jumanji_completion_query_t*
+completion_query_ref(jumanji_completion_query_t* query)
+{
+  if (query != NULL) {
+    g_atomic_int_inc(&(query->ref_count));
+  }
+
+  return query;
+}
+
+static void
+completion_query_unref(jumanji_completion_query_t* query)
+{
+  if (query == NULL || g_atomic_int_dec_and_test(&(query->ref_count)) == FALSE) {
+    return;
+  }
+
+  completion_query_unref(query->base);
+  jumanji_db_results_free(query->bookmarks);
+  jumanji_db_results_free(query->history);
+  g_object_unref(query->cancellable);
+  g_mutex_clear(&(query->lock));
+  g_cond_clear(&(query->cond));
+  g_free(query->input);
+  g_free(query);
+}
+
+static void
+completion_query_run(gpointer data, gpointer user_data)
+{
+  jumanji_completion_query_t* query = (jumanji_completion_query_t*) data;
+
+  jumanji_db_results_t* bookmarks = NULL;
+  jumanji_db_results_t* history   = NULL;
+
+  if (g_cancellable_is_cancelled(query->cancellable) == FALSE) {
+    if (query->base != NULL) {
+      bookmarks = completion_filter_links(query->base->bookmarks, query->input, query->fuzzy);
+      history   = completion_filter_links(query->base->history,   query->input, query->fuzzy);
+    } else if (query->fuzzy == true) {
+      bookmarks = jumanji_db_bookmark_find_fuzzy(query->database, query->input);
+      if (g_cancellable_is_cancelled(query->cancellable) == FALSE) {
+        history = jumanji_db_history_find_fuzzy(query->database, query->input);
+      }
+    } else {
+      bookmarks = jumanji_db_bookmark_find(query->database, query->input);
+      if (g_cancellable_is_cancelled(query->cancellable) == FALSE) {
+        history = jumanji_db_history_find(query->database, query->input);
+      }
+    }
+  }
+
+  /* the base is not needed anymore */
+  completion_query_unref(query->base);
+  query->base = NULL;
+
+  g_mutex_lock(&(query->lock));
+  query->bookmarks = bookmarks;
+  query->history   = history;
+  query->done      = true;
+  g_cond_broadcast(&(query->cond));
+  g_mutex_unlock(&(query->lock));
+
+  completion_query_unref(query);
+}
+
+static void
+completion_query_wait(jumanji_completion_query_t* query)
+{
+  g_mutex_lock(&(query->lock));
+  while (query->done == false) {
+    g_cond_wait(&(query->cond), &(query->lock));
+  }
+  g_mutex_unlock(&(query->lock));
+}
+
+static jumanji_db_results_t*
+completion_filter_links(jumanji_db_results_t* links, const char* input, bool fuzzy)
+{
+  if (links == NULL) {
+    return NULL;
+  }
+
+  /* the links of the new results point into the old ones */
+  jumanji_db_results_t* results = jumanji_db_results_new(links);
+  if (results == NULL) {
+    return NULL;
+  }
+
+  size_t number_of_links = jumanji_db_results_size(links);
+
+  /* every fuzzy match of the extended input is a fuzzy match of the old
+   * input, so only the old results are rescored */
+  if (fuzzy == true) {
+    fuzzy_pattern_t* pattern = fuzzy_pattern_new(input);
+    if (pattern == NULL) {
+      jumanji_db_results_free(results);
+      return NULL;
+    }
+
+    GArray* matches = g_array_new(FALSE, FALSE, sizeof(fuzzy_match_t));
+    for (size_t i = 0; i < number_of_links; i++) {
+      const jumanji_db_result_link_t* link = jumanji_db_results_get(links, i);
+      fuzzy_match_t match = { 0, jumanji_db_results_size(results), NULL };
+
+      if (jumanji_db_result_link_match(pattern, link, &(match.score)) == true) {
+        g_array_append_val(matches, match);
+        jumanji_db_results_add_view(results, link);
+      }
+    }
+
+    jumanji_db_results_rank(results, matches);
+
+    g_array_free(matches, TRUE);
+    fuzzy_pattern_free(pattern);
+
+    return results;
+  }
+
+  for (size_t i = 0; i < number_of_links; i++) {
+    const jumanji_db_result_link_t* link = jumanji_db_results_get(links, i);
+
+    /* the refined results have to match what the backend would find */
+    if (jumanji_db_result_link_contains(link, input) == true) {
+      jumanji_db_results_add_view(results, link);
+    }
+  }
+
+  return results;
+}
+
+static void
+completion_add_links(girara_session_t* session, girara_completion_t* completion,
+    const char* name, jumanji_db_results_t* links)
+{
+  size_t number_of_links = jumanji_db_results_size(links);
+  if (number_of_links == 0) {
+    return;
+  }
+
+  girara_completion_group_t* group = girara_completion_group_create(session, name);
+  if (group == NULL) {
+    return;
+  }
+
+  for (size_t i = 0; i < number_of_links; i++) {
+    const jumanji_db_result_link_t* link = jumanji_db_results_get(links, i);
+    girara_completion_group_add_element(group, link->url, link->title);
+  }
+
+  girara_completion_add_group(completion, group);
+}
@@ -5,6 +5,8 @@
 
 #include <girara/types.h>
 
+#include "jumanji.h"
+
 /**
  * Completion for the open command
  *
@@ -14,4 +16,50 @@
  */
 girara_completion_t* cc_open(girara_session_t* session, const char* input);
 
+/**
+ * Initializes the background completion queries
+ *
+ * @param jumanji The jumanji session
+ * @return true if no error occured
+ */
+bool completion_init(jumanji_t* jumanji);
+
+/**
+ * Cancels all pending completion queries and frees the completion state
+ *
+ * @param jumanji The jumanji session
+ */
+void completion_free(jumanji_t* jumanji);
+
+/**
+ * Starts a background query for the given input. A still pending query for
+ * an older input is cancelled. If the input extends the input of the last
+ * query, the results of the last query are refined instead of querying the
+ * database again.
+ *
+ * @param jumanji The jumanji session
+ * @param input The input
+ */
+void completion_query_start(jumanji_t* jumanji, const char* input);
+
+/**
+ * Returns the only link that matches the latest query. Links that are both
+ * bookmarked and in the history count once.
+ *
+ * @param jumanji The jumanji session
+ * @param uri Set to the uri of the link or to NULL if none or several links
+ *   match; has to be freed with g_free
+ * @return false if the latest query has not finished yet
+ */
+bool completion_query_candidate(jumanji_t* jumanji, char** uri);
+
+/**
+ * Starts a completion query whenever the argument of an open command in the
+ * inputbar changes
+ *
+ * @param editable The inputbar entry
+ * @param jumanji The jumanji session
+ */
+void cb_completion_inputbar_changed(GtkEditable* editable, jumanji_t* jumanji);
+
 #endif // COMPLETION_H
@@ -1,5 +1,6 @@
 /* See LICENSE file for license and copyright information */
 
+#include "cache.h"
 #include "callbacks.h"
 #include "config.h"
 #include "commands.h"
@@ -16,6 +17,7 @@
 #include <girara/shortcuts.h>
 #include <girara/commands.h>
 #include <girara/config.h>
+#include <girara/tabs.h>
 
 void
 config_load_default(jumanji_t* jumanji)
@@ -43,12 +45,28 @@ config_load_default(jumanji_t* jumanji)
   girara_setting_add(gsession, "auto-set-proxy",              &bool_value,  BOOLEAN, true,  "Set proxy on initialization", NULL, NULL);
   bool_value = true;
   girara_setting_add(gsession, "close-window-with-last-tab",  &bool_value,  BOOLEAN, false, "Close window with last tab", NULL, NULL);
+  string_value = NULL;
+  girara_setting_add(gsession, "cache-dir",                   string_value, STRING,  true,  "Cache directory",             NULL, NULL);
+  string_value = "web-browser";
+  girara_setting_add(gsession, "cache-model",                 string_value, STRING,  false, "Cache model (web-browser, document-browser or document-viewer)", cb_settings_cache_model, NULL);
+  int_value = 0;
+  girara_setting_add(gsession, "cache-size",                  &int_value,   INT,     false, "Maximal size of the disk cache in MiB, 0 for no limit", NULL, NULL);
+  string_value = "sqlite";
+  girara_setting_add(gsession, "cookie-storage",              string_value, STRING,  true,  "Cookie storage (sqlite or text)", NULL, NULL);
+  bool_value = true;
+  girara_setting_add(gsession, "dns-prefetch",                &bool_value,  BOOLEAN, false, "Resolve hovered and completed hosts in advance", NULL, NULL);
   string_value = "primary";
   girara_setting_add(gsession, "default-clipboard",           string_value, STRING,  false, "Default clipboard",           NULL, NULL);
   string_value = "~/dl";
   girara_setting_add(gsession, "download-dir",                string_value, STRING,  false, "Download directory",          NULL, NULL);
   string_value = NULL;
-  girara_setting_add(gsession, "download-command",            string_value, STRING,  false, "Download command",            NULL, NULL);
+  girara_setting_add(gsession, "download-command",            string_value, STRING,  false, "Download command, %s is replaced by the uri and the file", NULL, NULL);
+  int_value = 3;
+  girara_setting_add(gsession, "download-limit",              &int_value,   INT,     false, "Number of concurrent downloads", NULL, NULL);
+  bool_value = false;
+  girara_setting_add(gsession, "prerender",                   &bool_value,  BOOLEAN, false, "Load the only matching link while typing :open", NULL, NULL);
+  int_value = 1024;
+  girara_setting_add(gsession, "prerender-budget",            &int_value,   INT,     false, "Maximal KiB loaded for a link that is not opened yet", NULL, NULL);
   string_value = "http://pwmt.org";
   girara_setting_add(gsession, "homepage",                    string_value, STRING,  false, "Home page",                   NULL, NULL);
   int_value = 40;
@@ -61,6 +79,8 @@ config_load_default(jumanji_t* jumanji)
   girara_setting_add(gsession, "load-session-at-startup",     &bool_value,  BOOLEAN, true,  "Load the default session at startup", NULL, NULL);
   bool_value = true;
   girara_setting_add(gsession, "focus-new-tabs",              &bool_value,  BOOLEAN, true,  "Focus newly opened tabs",     NULL, NULL);
+  bool_value = true;
+  girara_setting_add(gsession, "fuzzy-completion",            &bool_value,  BOOLEAN, false, "Match completion input fuzzily", NULL, NULL);
 
   /* hint settings */
   string_value =
@@ -75,12 +95,12 @@ config_load_default(jumanji_t* jumanji)
     "background-color: #1F7DA0;";
 
   girara_setting_add(gsession, "hint-css", string_value, STRING,  false, "CSS of one hint node",          NULL, NULL);
+  string_value = "asdfghjkl";
+  girara_setting_add(gsession, "hint-alphabet", string_value, STRING,  false, "Letters of the hint labels", NULL, NULL);
 
   /* webkit settings */
   bool_value = true;
   girara_setting_add(gsession, "auto-load-images",            &bool_value,   BOOLEAN, false, "Load images automatically",             cb_settings_webkit, NULL);
-  bool_value = true;
-  girara_setting_add(gsession, "auto-shrink-images",          &bool_value,   BOOLEAN, false, "Shrink standalone images to fit",       cb_settings_webkit, NULL);
   string_value = "serif";
   girara_setting_add(gsession, "cursive-font-family",         &string_value, STRING,  false, "Default cursive font family",           cb_settings_webkit, NULL);
   string_value = "iso-8859-1";
@@ -102,13 +122,11 @@ config_load_default(jumanji_t* jumanji)
   bool_value = true;
   girara_setting_add(gsession, "enable-plugins",              &bool_value,   BOOLEAN, false, "Enable plugins",                        cb_settings_webkit, NULL);
   bool_value = false;
-  girara_setting_add(gsession, "enable-private-browsing",     &bool_value,   BOOLEAN, false, "Enable private browsing",               cb_settings_webkit, NULL);
+  girara_setting_add(gsession, "enable-private-browsing",     &bool_value,   BOOLEAN, false, "Enable private browsing",               NULL, NULL);
   bool_value = true;
   girara_setting_add(gsession, "enable-scripts",              &bool_value,   BOOLEAN, false, "Enable scripts",                        cb_settings_webkit, NULL);
   bool_value = false;
-  girara_setting_add(gsession, "enable-spell-checking",       &bool_value,   BOOLEAN, false, "Enable spell checking",                 cb_settings_webkit, NULL);
-  bool_value = false;
-  girara_setting_add(gsession, "enforce-96-dpi",              &bool_value,   BOOLEAN, false, "Enforce a resolution of 96 DPI",        cb_settings_webkit, NULL);
+  girara_setting_add(gsession, "enable-spell-checking",       &bool_value,   BOOLEAN, false, "Enable spell checking",                 cb_settings_spell_checking, NULL);
   string_value = "serif";
   girara_setting_add(gsession, "fantasy-font-family",         &string_value, STRING , false, "Fantasy font family",                   cb_settings_webkit, NULL);
   bool_value = false;
@@ -126,11 +144,11 @@ config_load_default(jumanji_t* jumanji)
   string_value = "serif";
   girara_setting_add(gsession, "serif-font-family",           &string_value, STRING,  false, "Serif font family",                     cb_settings_webkit, NULL);
   string_value = NULL;
-  girara_setting_add(gsession, "spell-checking-languages",    &string_value, STRING,  false, "Spell checking languages",              cb_settings_webkit, NULL);
+  girara_setting_add(gsession, "spell-checking-languages",    &string_value, STRING,  false, "Spell checking languages",              cb_settings_spell_checking, NULL);
   string_value = NULL;
   girara_setting_add(gsession, "user-agent",                  &string_value, STRING,  false, "User agent",                            cb_settings_webkit, NULL);
   string_value = NULL;
-  girara_setting_add(gsession, "user-stylesheet-uri",         &string_value, STRING,  false, "Custom stylesheet",                     cb_settings_webkit, NULL);
+  girara_setting_add(gsession, "user-stylesheet-uri",         &string_value, STRING,  false, "Custom stylesheet",                     cb_settings_user_stylesheet, NULL);
 
   /* define default shortcuts */
   girara_shortcut_add(gsession, 0,                GDK_KEY_apostrophe, NULL, sc_mark_evaluate,         NORMAL, 0,               NULL);
@@ -200,13 +218,17 @@ config_load_default(jumanji_t* jumanji)
   girara_inputbar_command_add(gsession, "delbmarks",     NULL,    cmd_bookmark_delete,   NULL,    "Delete a bookmark");
   girara_inputbar_command_add(gsession, "delmarks",      "delm",  cmd_marks_delete,      NULL,    "Delete the specified marks");
   girara_inputbar_command_add(gsession, "delqmarks",     "delqm", cmd_quickmarks_delete, NULL,    "Add quickmark");
-  girara_inputbar_command_add(gsession, "downloads",     NULL,    cmd_downloads,         NULL,    "Show downloads");
+  girara_inputbar_command_add(gsession, "cache",         NULL,    cmd_cache,             NULL,    "Show or clear the cache");
+  girara_inputbar_command_add(gsession, "downloads",     NULL,    cmd_downloads,         NULL,    "Show or cancel downloads");
   girara_inputbar_command_add(gsession, "mark",          NULL,    cmd_marks_add,         NULL,    "Mark current location within the web page");
   girara_inputbar_command_add(gsession, "open",          "o",     cmd_open,              cc_open, "Open URL in the current tab");
   girara_inputbar_command_add(gsession, "print",         NULL,    cmd_print,             NULL,    "Show print dialog");
   girara_inputbar_command_add(gsession, "qmark",         NULL,    cmd_quickmarks_add,    NULL,    "Add quickmark");
+  girara_inputbar_command_add(gsession, "siterule",      NULL,    cmd_siterule,          NULL,    "Block images, scripts, autoplay or media on a site");
   girara_inputbar_command_add(gsession, "stop",          NULL,    cmd_stop,              NULL,    "Stop loading the current page");
   girara_inputbar_command_add(gsession, "tabopen",       "t",     cmd_tabopen,           cc_open, "Open URL in a new tab");
+  girara_inputbar_command_add(gsession, "tabproxy",      NULL,    cmd_tabproxy,          NULL,    "Open URL in a new tab that uses the given proxy");
+  girara_inputbar_command_add(gsession, "tabset",        NULL,    cmd_tabset,            NULL,    "Override a setting for the current tab");
   girara_inputbar_command_add(gsession, "winopen",       "w",     cmd_winopen,           cc_open, "Open URL in a new window");
   girara_inputbar_command_add(gsession, "sessionsave",   "save",  cmd_sessionsave,       NULL,    "Save the current session");
   girara_inputbar_command_add(gsession, "sessionload",   "load",  cmd_sessionload,       NULL,    "Load a specific session");
@@ -278,5 +300,23 @@ config_load_file(jumanji_t* jumanji, char* path)
     return;
   }
 
+  /* settings that require a reload only mark the tabs while the file is
+   * parsed */
+  bool loading = jumanji->config.loading;
+  jumanji->config.loading = true;
   girara_config_parse(jumanji->ui.session, path);
+  jumanji->config.loading = loading;
+
+  if (loading == true) {
+    return;
+  }
+
+  int number_of_tabs = girara_get_number_of_tabs(jumanji->ui.session);
+  for (int i = 0; i < number_of_tabs; i++) {
+    jumanji_tab_t* tab = jumanji_tab_get_nth(jumanji, i);
+    if (tab != NULL && tab->reload == true) {
+      tab->reload = false;
+      webkit_web_view_reload(WEBKIT_WEB_VIEW(tab->web_view));
+    }
+  }
 }
@@ -13,8 +13,10 @@
 void config_load_default(jumanji_t* jumanji);
 
 /**
- * Loads and evaluates a configuration file
+ * Loads and evaluates a configuration file. Tabs whose settings have been
+ * changed in a way that requires a reload are reloaded once afterwards.
  *
+ * @param jumanji the jumanji session
  * @param path Path to the configuration file
  */
 void config_load_file(jumanji_t* jumanji, char* path);
@@ -6,13 +6,18 @@ VERSION = 0.0.0
 # paths
 PREFIX ?= /usr
 MANPREFIX ?= ${PREFIX}/share/man
+LIBDIR ?= ${PREFIX}/lib
+EXTENSIONDIR ?= ${LIBDIR}/jumanji
 
 # libs
 GTK_INC ?= $(shell pkg-config --cflags gtk+-3.0)
 GTK_LIB ?= $(shell pkg-config --libs   gtk+-3.0)
 
-WEBKIT_INC ?= $(shell pkg-config --cflags webkit2gtk-3.0)
-WEBKIT_LIB ?= $(shell pkg-config --libs   webkit2gtk-3.0 javascriptcoregtk-3.0)
+WEBKIT_INC ?= $(shell pkg-config --cflags webkit2gtk-4.0)
+WEBKIT_LIB ?= $(shell pkg-config --libs   webkit2gtk-4.0 javascriptcoregtk-4.0)
+
+EXTENSION_INC ?= $(shell pkg-config --cflags webkit2gtk-web-extension-4.0)
+EXTENSION_LIB ?= $(shell pkg-config --libs   webkit2gtk-web-extension-4.0)
 
 GIRARA_INC ?= $(shell pkg-config --cflags girara-gtk3)
 GIRARA_LIB ?= $(shell pkg-config --libs girara-gtk3)
@@ -38,8 +43,15 @@ INCS = ${GTK_INC} ${WEBKIT_INC} ${GIRARA_INC} ${GTHREAD_INC}
 LIBS = ${GIRARA_LIB} ${GTK_LIB} ${WEBKIT_LIB} ${GTHREAD_LIB} -lpthread -lm
 
 # flags
+CPPFLAGS += -DEXTENSIONDIR=\"${EXTENSIONDIR}\"
 CFLAGS += -std=c99 -pedantic -Wall -Wno-format-zero-length -Wunused-result $(INCS)
 
+# the web extension is built with its own flags
+EXTENSION_CFLAGS += -std=c99 -pedantic -Wall -fPIC $(EXTENSION_INC)
+
+# the fuzzy completion filter uses SSE2 or AVX2 if the compiler targets them,
+# e.g. add -mavx2 or -march=native to CFLAGS to use AVX2
+
 # debug
 DFLAGS = -O0 -g
 
@@ -17,9 +17,14 @@
 #define BOOKMARKS "bookmarks"
 #define HISTORY "history"
 #define QUICKMARKS "quickmarks"
+#define SITES "sites"
 #define COOKIES "cookies"
 #define SESSION_DIR "sessions"
 
+/* packs the three bytes starting at s into one key */
+#define TRIGRAM(s) ((((guint) (guchar) (s)[0]) << 16) | \
+    (((guint) (guchar) (s)[1]) << 8) | ((guint) (guchar) (s)[2]))
+
 #ifdef __GNU__
 #include <sys/file.h>
 #define file_lock_set(fd, cmd) flock(fd, cmd)
@@ -31,6 +36,8 @@
   }
 #endif
 
+typedef struct jumanji_db_index_s jumanji_db_index_t;
+
 /* forward declarations */
 static void jumanji_db_write_quickmarks_to_file(const char* filename,
     girara_list_t* quickmarks);
@@ -42,8 +49,34 @@ static girara_list_t* jumanji_db_read_urls_from_file(const char* filename);
 static girara_list_t* jumanji_db_read_quickmarks_from_file(const char*
     filename);
 static void jumanji_db_free_quickmark(void* data);
-static girara_list_t* jumanji_db_filter_url_list(girara_list_t* list, const
-    char* input);
+static girara_list_t* jumanji_db_read_sites_from_file(const char* filename);
+static void jumanji_db_write_sites_to_file(const char* filename, girara_list_t* sites);
+static jumanji_db_index_t* jumanji_db_index_new(girara_list_t* links);
+static void jumanji_db_index_free(jumanji_db_index_t* index);
+static void jumanji_db_index_add_text(jumanji_db_index_t* index, const char*
+    text, guint id);
+static void jumanji_db_index_add(jumanji_db_index_t* index,
+    jumanji_db_result_link_t* link);
+static void jumanji_db_index_remove(jumanji_db_index_t* index,
+    jumanji_db_result_link_t* link);
+static jumanji_db_index_t* jumanji_db_index_compact(jumanji_db_index_t* index,
+    girara_list_t* links);
+static jumanji_db_result_link_t* jumanji_db_index_lookup(jumanji_db_index_t*
+    index, const char* url);
+static jumanji_db_results_t* jumanji_db_index_find(jumanji_db_index_t* index,
+    const char* input);
+static jumanji_db_results_t* jumanji_db_index_find_fuzzy(jumanji_db_index_t*
+    index, const char* input);
+static void jumanji_db_index_match(jumanji_db_results_t* results,
+    jumanji_db_result_link_t* link, const char* input);
+static void jumanji_db_url_list_add(girara_list_t* list, jumanji_db_index_t**
+    index, const char* url, const char* title, int visited);
+static void jumanji_db_url_list_remove(girara_list_t* list, jumanji_db_index_t*
+    index, jumanji_db_result_link_t* link);
+static void jumanji_db_posting_free(gpointer data);
+static void jumanji_db_posting_add(GArray* posting, guint id);
+static bool jumanji_db_posting_contains(GArray* posting, guint id);
+static gint jumanji_db_posting_compare(gconstpointer a, gconstpointer b);
 static void jumanji_db_write_urls_to_file(const char* filename, girara_list_t*
     urls, bool visited);
 
@@ -51,17 +84,24 @@ struct jumanji_database_s
 {
   gchar* bookmark_file; /**> File path to the bookmark file */
   girara_list_t* bookmarks; /**> Temporary bookmarks */
+  jumanji_db_index_t* bookmark_index; /**> Trigram index of the bookmarks */
   GFileMonitor* bookmark_monitor; /**> File monitor for the bookmark file */
 
   gchar* history_file; /**> File path to the history file */
   girara_list_t* history; /**>  Temporary history */
+  jumanji_db_index_t* history_index; /**> Trigram index of the history */
   GFileMonitor* history_monitor; /**> File monitor for the history file */
 
   gchar* quickmarks_file; /**> File path to the quickmarks file */
   girara_list_t* quickmarks; /**>  Temporary quickmarks */
   GFileMonitor* quickmarks_monitor; /**> File monitor for the quickmarks file */
 
+  gchar* sites_file; /**> File path to the content rules of the sites */
+  girara_list_t* sites; /**> Content rules of the sites */
+
   gchar* session_dir; /**> Path to the session directory */
+
+  GMutex lock; /**> Protects bookmarks and history against concurrent finds */
 };
 
 typedef struct jumanji_db_quickmark_s
@@ -70,6 +110,15 @@ typedef struct jumanji_db_quickmark_s
   char* url; /**> Url */
 } jumanji_db_quickmark_t;
 
+struct jumanji_db_index_s
+{
+  GPtrArray* entries; /**> Indexed links by id, NULL once removed */
+  GHashTable* ids; /**> Maps urls to ids */
+  GHashTable* trigrams; /**> Maps trigrams to sorted arrays of ids */
+  GArray* charsets; /**> Character sets of the entries by id */
+  unsigned int removed; /**> Number of removed entries */
+};
+
 
 static bool
 jumanji_db_check_file(const char* path)
@@ -114,6 +163,8 @@ jumanji_db_init(const char* dir)
     goto error_ret;
   }
 
+  g_mutex_init(&(database->lock));
+
   /* get bookmark file path */
   database->bookmark_file = g_build_filename(dir, BOOKMARKS, NULL);
   if (database->bookmark_file == NULL ||
@@ -135,6 +186,13 @@ jumanji_db_init(const char* dir)
     goto error_free;
   }
 
+  /* get sites file path */
+  database->sites_file = g_build_filename(dir, SITES, NULL);
+  if (database->sites_file == NULL ||
+      jumanji_db_check_file(database->sites_file) == false) {
+    goto error_free;
+  }
+
   /* get session dir path */
   database->session_dir = g_build_filename(dir, SESSION_DIR, NULL);
   if (database->session_dir == NULL ||
@@ -146,11 +204,16 @@ jumanji_db_init(const char* dir)
   database->bookmarks  = jumanji_db_read_urls_from_file(database->bookmark_file);
   database->history    = jumanji_db_read_urls_from_file(database->history_file);
   database->quickmarks = jumanji_db_read_quickmarks_from_file(database->quickmarks_file);
+  database->sites      = jumanji_db_read_sites_from_file(database->sites_file);
 
   girara_list_set_free_function(database->bookmarks,  jumanji_db_free_result_link);
   girara_list_set_free_function(database->history,    jumanji_db_free_result_link);
   girara_list_set_free_function(database->quickmarks, jumanji_db_free_quickmark);
 
+  /* build indices */
+  database->bookmark_index = jumanji_db_index_new(database->bookmarks);
+  database->history_index  = jumanji_db_index_new(database->history);
+
   /* setup file monitors */
   GFile* bookmark_file = g_file_new_for_path(database->bookmark_file);
   if (bookmark_file != NULL) {
@@ -252,10 +315,15 @@ jumanji_db_free(jumanji_database_t* database)
   g_free(database->bookmark_file);
   g_free(database->history_file);
   g_free(database->quickmarks_file);
+  g_free(database->sites_file);
 
   girara_list_free(database->bookmarks);
   girara_list_free(database->history);
   girara_list_free(database->quickmarks);
+  girara_list_free(database->sites);
+
+  jumanji_db_index_free(database->bookmark_index);
+  jumanji_db_index_free(database->history_index);
 
   if (database->bookmark_monitor != NULL) {
     g_object_unref(database->bookmark_monitor);
@@ -269,17 +337,36 @@ jumanji_db_free(jumanji_database_t* database)
     g_object_unref(database->quickmarks_monitor);
   }
 
+  g_mutex_clear(&(database->lock));
   g_free(database);
 }
 
-girara_list_t*
+jumanji_db_results_t*
 jumanji_db_bookmark_find(jumanji_database_t* database, const char* input)
 {
   if (database == NULL || database->bookmarks == NULL || input == NULL) {
     return NULL;
   }
 
-  return jumanji_db_filter_url_list(database->bookmarks, input);
+  g_mutex_lock(&(database->lock));
+  jumanji_db_results_t* results = jumanji_db_index_find(database->bookmark_index, input);
+  g_mutex_unlock(&(database->lock));
+
+  return results;
+}
+
+jumanji_db_results_t*
+jumanji_db_bookmark_find_fuzzy(jumanji_database_t* database, const char* input)
+{
+  if (database == NULL || database->bookmarks == NULL || input == NULL) {
+    return NULL;
+  }
+
+  g_mutex_lock(&(database->lock));
+  jumanji_db_results_t* results = jumanji_db_index_find_fuzzy(database->bookmark_index, input);
+  g_mutex_unlock(&(database->lock));
+
+  return results;
 }
 
 void
@@ -289,24 +376,21 @@ jumanji_db_bookmark_remove(jumanji_database_t* database, const char* url)
     return;
   }
 
-  /* remove url from list */
-  if (girara_list_size(database->bookmarks) > 0) {
-    girara_list_iterator_t* iter = girara_list_iterator(database->bookmarks);
-
-    do {
-      jumanji_db_result_link_t* link = (jumanji_db_result_link_t*) girara_list_iterator_data(iter);
+  g_mutex_lock(&(database->lock));
 
-      if (strcmp(link->url, url) == 0) {
-        girara_list_remove(database->bookmarks, link);
-      }
-    } while (girara_list_iterator_next(iter) != NULL);
-
-    girara_list_iterator_free(iter);
+  /* remove url from list */
+  jumanji_db_result_link_t* link = jumanji_db_index_lookup(database->bookmark_index, url);
+  if (link != NULL) {
+    jumanji_db_url_list_remove(database->bookmarks, database->bookmark_index, link);
+    database->bookmark_index = jumanji_db_index_compact(database->bookmark_index,
+        database->bookmarks);
 
     jumanji_db_write_urls_to_file(database->bookmark_file, database->bookmarks, false);
     g_signal_connect(G_OBJECT(database->bookmark_monitor), "changed",
         G_CALLBACK(cb_jumanji_db_watch_file), database);
   }
+
+  g_mutex_unlock(&(database->lock));
 }
 
 void
@@ -316,102 +400,65 @@ jumanji_db_bookmark_add(jumanji_database_t* database, const char* url, const cha
     return;
   }
 
-  /* search for existing entry and update it */
-  if (girara_list_size(database->bookmarks) > 0) {
-    girara_list_iterator_t* iter = girara_list_iterator(database->bookmarks);
-    do {
-      jumanji_db_result_link_t* link = (jumanji_db_result_link_t*) girara_list_iterator_data(iter);
-      if (link == NULL) {
-        continue;
-      }
-
-      if (strstr(link->url, url) != NULL) {
-        g_free(link->title);
-        link->title = title ? g_strdup(title) : NULL;
-        jumanji_db_write_urls_to_file(database->bookmark_file, database->bookmarks, false);
-        g_signal_connect(G_OBJECT(database->bookmark_monitor), "changed",
-            G_CALLBACK(cb_jumanji_db_watch_file), database);
-        girara_list_iterator_free(iter);
-        return;
-      }
-    } while (girara_list_iterator_next(iter) != NULL);
-    girara_list_iterator_free(iter);
-  }
-
-  /* add url to list */
-  jumanji_db_result_link_t* link = (jumanji_db_result_link_t*) malloc(sizeof(jumanji_db_result_link_t));
-  if (link == NULL) {
-    return;
-  }
-
-  link->url     = g_strdup(url);
-  link->title   = g_strdup(title);
-  link->visited = 0;
+  g_mutex_lock(&(database->lock));
 
-  girara_list_append(database->bookmarks, link);
+  jumanji_db_url_list_add(database->bookmarks, &(database->bookmark_index),
+      url, title, 0);
 
   /* write to file */
   jumanji_db_write_urls_to_file(database->bookmark_file, database->bookmarks, false);
   g_signal_connect(G_OBJECT(database->bookmark_monitor), "changed",
       G_CALLBACK(cb_jumanji_db_watch_file), database);
+
+  g_mutex_unlock(&(database->lock));
 }
 
-girara_list_t*
+jumanji_db_results_t*
 jumanji_db_history_find(jumanji_database_t* database, const char* input)
 {
   if (database == NULL || database->history == NULL || input == NULL) {
     return NULL;
   }
 
-  return jumanji_db_filter_url_list(database->history, input);
+  g_mutex_lock(&(database->lock));
+  jumanji_db_results_t* results = jumanji_db_index_find(database->history_index, input);
+  g_mutex_unlock(&(database->lock));
+
+  return results;
 }
 
-void
-jumanji_db_history_add(jumanji_database_t* database, const char* url, const char* title)
+jumanji_db_results_t*
+jumanji_db_history_find_fuzzy(jumanji_database_t* database, const char* input)
 {
-  if (database == NULL || database->history == NULL || url == NULL) {
-    return;
+  if (database == NULL || database->history == NULL || input == NULL) {
+    return NULL;
   }
 
-  /* search for existing entry and update it */
-  if (girara_list_size(database->history) > 0) {
-    girara_list_iterator_t* iter = girara_list_iterator(database->history);
-    do {
-      jumanji_db_result_link_t* link = (jumanji_db_result_link_t*) girara_list_iterator_data(iter);
-      if (link == NULL) {
-        continue;
-      }
+  g_mutex_lock(&(database->lock));
+  jumanji_db_results_t* results = jumanji_db_index_find_fuzzy(database->history_index, input);
+  g_mutex_unlock(&(database->lock));
 
-      if (strstr(link->url, url) != NULL) {
-        g_free(link->title);
-        link->title   = title ? g_strdup(title) : NULL;
-        link->visited = time(NULL);
-        jumanji_db_write_urls_to_file(database->history_file, database->history, false);
-        g_signal_connect(G_OBJECT(database->history_monitor), "changed",
-            G_CALLBACK(cb_jumanji_db_watch_file), database);
-        girara_list_iterator_free(iter);
-        return;
-      }
-    } while (girara_list_iterator_next(iter) != NULL);
-    girara_list_iterator_free(iter);
-  }
+  return results;
+}
 
-  /* add url to list */
-  jumanji_db_result_link_t* link = (jumanji_db_result_link_t*) malloc(sizeof(jumanji_db_result_link_t));
-  if (link == NULL) {
+void
+jumanji_db_history_add(jumanji_database_t* database, const char* url, const char* title)
+{
+  if (database == NULL || database->history == NULL || url == NULL) {
     return;
   }
 
-  link->url     = g_strdup(url);
-  link->title   = g_strdup(title);
-  link->visited = time(NULL);
+  g_mutex_lock(&(database->lock));
 
-  girara_list_append(database->history, link);
+  jumanji_db_url_list_add(database->history, &(database->history_index),
+      url, title, time(NULL));
 
   /* write to file */
   jumanji_db_write_urls_to_file(database->history_file, database->history, false);
   g_signal_connect(G_OBJECT(database->history_monitor), "changed",
       G_CALLBACK(cb_jumanji_db_watch_file), database);
+
+  g_mutex_unlock(&(database->lock));
 }
 
 void
@@ -421,25 +468,39 @@ jumanji_db_history_clean(jumanji_database_t* database, unsigned int age)
     return;
   }
 
-  /* remove urls from list */
+  g_mutex_lock(&(database->lock));
+
+  /* remove urls from list; they are collected first since the list must not
+   * change while it is iterated */
   if (girara_list_size(database->history) > 0) {
-    girara_list_iterator_t* iter = girara_list_iterator(database->history);
+    GPtrArray* expired = g_ptr_array_new();
 
     int visited = time(NULL) - age;
+    girara_list_iterator_t* iter = girara_list_iterator(database->history);
     do {
       jumanji_db_result_link_t* link = (jumanji_db_result_link_t*) girara_list_iterator_data(iter);
 
-      if (link->visited >= visited) {
-        girara_list_remove(database->history, link);
+      if (link != NULL && link->visited >= visited) {
+        g_ptr_array_add(expired, link);
       }
     } while (girara_list_iterator_next(iter) != NULL);
-
     girara_list_iterator_free(iter);
 
+    for (guint i = 0; i < expired->len; i++) {
+      jumanji_db_url_list_remove(database->history, database->history_index,
+          g_ptr_array_index(expired, i));
+    }
+    g_ptr_array_free(expired, TRUE);
+
+    database->history_index = jumanji_db_index_compact(database->history_index,
+        database->history);
+
     jumanji_db_write_urls_to_file(database->history_file, database->history, false);
     g_signal_connect(G_OBJECT(database->history_monitor), "changed",
         G_CALLBACK(cb_jumanji_db_watch_file), database);
   }
+
+  g_mutex_unlock(&(database->lock));
 }
 
 void
@@ -548,6 +609,85 @@ jumanji_db_quickmark_remove(jumanji_database_t* database, const char identifier)
   }
 }
 
+void
+jumanji_db_site_set(jumanji_database_t* database, const char* host, unsigned int rules)
+{
+  if (database == NULL || database->sites == NULL || host == NULL) {
+    return;
+  }
+
+  /* search for existing entry and update or remove it */
+  jumanji_db_site_t* found = NULL;
+  if (girara_list_size(database->sites) > 0) {
+    girara_list_iterator_t* iter = girara_list_iterator(database->sites);
+    do {
+      jumanji_db_site_t* site = (jumanji_db_site_t*) girara_list_iterator_data(iter);
+      if (site != NULL && g_strcmp0(site->host, host) == 0) {
+        found = site;
+        break;
+      }
+    } while (girara_list_iterator_next(iter) != NULL);
+    girara_list_iterator_free(iter);
+  }
+
+  if (found != NULL && rules == 0) {
+    girara_list_remove(database->sites, found);
+  } else if (found != NULL) {
+    found->rules = rules;
+  } else if (rules != 0) {
+    jumanji_db_site_t* site = malloc(sizeof(jumanji_db_site_t));
+    if (site == NULL) {
+      return;
+    }
+
+    site->host  = g_strdup(host);
+    site->rules = rules;
+
+    girara_list_append(database->sites, site);
+  } else {
+    return;
+  }
+
+  /* write to file */
+  jumanji_db_write_sites_to_file(database->sites_file, database->sites);
+}
+
+girara_list_t*
+jumanji_db_site_list(jumanji_database_t* database)
+{
+  if (database == NULL || database->sites == NULL) {
+    return NULL;
+  }
+
+  girara_list_t* list = girara_list_new2(jumanji_db_free_site);
+  if (list == NULL) {
+    return NULL;
+  }
+
+  if (girara_list_size(database->sites) > 0) {
+    girara_list_iterator_t* iter = girara_list_iterator(database->sites);
+    do {
+      jumanji_db_site_t* site = (jumanji_db_site_t*) girara_list_iterator_data(iter);
+      if (site == NULL) {
+        continue;
+      }
+
+      jumanji_db_site_t* copy = malloc(sizeof(jumanji_db_site_t));
+      if (copy == NULL) {
+        continue;
+      }
+
+      copy->host  = g_strdup(site->host);
+      copy->rules = site->rules;
+
+      girara_list_append(list, copy);
+    } while (girara_list_iterator_next(iter) != NULL);
+    girara_list_iterator_free(iter);
+  }
+
+  return list;
+}
+
 static girara_list_t*
 jumanji_db_read_urls_from_file(const char* filename)
 {
@@ -583,17 +723,14 @@ jumanji_db_read_urls_from_file(const char* filename)
     gint    argc = 0;
 
     if (g_shell_parse_argv(line, &argc, &argv, NULL) != FALSE) {
-      jumanji_db_result_link_t* link = malloc(sizeof(jumanji_db_result_link_t));
+      jumanji_db_result_link_t* link = jumanji_db_result_link_new(argv[0],
+          (argc > 1) ? argv[1] : NULL, (argc > 2) ? atoi(argv[2]) : 0);
       if (link == NULL) {
         g_strfreev(argv);
         free(line);
         continue;
       }
 
-      link->url     = g_strdup(argv[0]);
-      link->title   = (argc > 1) ? g_strdup(argv[1]) : NULL;
-      link->visited = (argc > 2) ? atoi(argv[2])     : 0;
-
       girara_list_append(list, link);
     }
 
@@ -755,39 +892,414 @@ jumanji_db_write_quickmarks_to_file(const char* filename, girara_list_t* quickma
 }
 
 static girara_list_t*
-jumanji_db_filter_url_list(girara_list_t* list, const char* input)
+jumanji_db_read_sites_from_file(const char* filename)
 {
-  if (list == NULL || girara_list_size(list) == 0) {
+  if (filename == NULL) {
     return NULL;
   }
 
-  girara_list_t* new_list = girara_list_new();
-  if (new_list == NULL) {
-    girara_list_free(list);
+  /* open file */
+  FILE* file = fopen(filename, "r");
+  if (file == NULL) {
     return NULL;
   }
 
-  girara_list_set_free_function(new_list, jumanji_db_free_result_link);
-  girara_list_iterator_t* iter = girara_list_iterator(list);
+  girara_list_t* list = girara_list_new2(jumanji_db_free_site);
+  if (list == NULL) {
+    fclose(file);
+    return NULL;
+  }
+
+  file_lock_set(fileno(file), F_WRLCK);
+
+  /* read lines */
+  char* line = NULL;
+  while ((line = girara_file_read_line(file)) != NULL) {
+    /* parse line: host rules */
+    char** tokens = g_strsplit(line, " ", 2);
+    if (tokens[0] != NULL && tokens[0][0] != '\0' && tokens[1] != NULL) {
+      unsigned int rules = g_ascii_strtoull(tokens[1], NULL, 10);
+      jumanji_db_site_t* site = (rules != 0) ? malloc(sizeof(jumanji_db_site_t)) : NULL;
+      if (site != NULL) {
+        site->host  = g_strdup(tokens[0]);
+        site->rules = rules;
+
+        girara_list_append(list, site);
+      }
+    }
+
+    g_strfreev(tokens);
+    free(line);
+  }
+
+  file_lock_set(fileno(file), F_UNLCK);
+  fclose(file);
+
+  return list;
+}
+
+static void
+jumanji_db_write_sites_to_file(const char* filename, girara_list_t* sites)
+{
+  if (filename == NULL || sites == NULL) {
+    return;
+  }
+
+  /* open file; removed hosts must not be left at its end */
+  int fd = open(filename, O_RDWR | O_TRUNC);
+  if (fd == -1) {
+    return;
+  }
+
+  file_lock_set(fd, F_WRLCK);
 
-  do {
-    jumanji_db_result_link_t* link = (jumanji_db_result_link_t*) girara_list_iterator_data(iter);
+  if (girara_list_size(sites) > 0) {
+    girara_list_iterator_t* iter = girara_list_iterator(sites);
+    do {
+      jumanji_db_site_t* site = (jumanji_db_site_t*) girara_list_iterator_data(iter);
+      if (site == NULL) {
+        continue;
+      }
 
-    if (strstr(link->url, input) != NULL || (link->title && strstr(link->title, input)) ) {
-      /* duplicate entry */
-      jumanji_db_result_link_t* link_dup = malloc(sizeof(jumanji_db_result_link_t));
-      if (link_dup != NULL) {
-        link_dup->url     = g_strdup(link->url);
-        link_dup->title   = g_strdup(link->title);
-        link_dup->visited = link->visited;
-        girara_list_append(new_list, link_dup);
+      char* text = g_strdup_printf("%s %u\n", site->host, site->rules);
+      if (write(fd, text, strlen(text)) != strlen(text)) {
+        girara_error("Could not write to %s", filename);
       }
+      g_free(text);
+    } while (girara_list_iterator_next(iter) != NULL);
+    girara_list_iterator_free(iter);
+  }
+
+  file_lock_set(fd, F_UNLCK);
+  close(fd);
+}
+
+static jumanji_db_index_t*
+jumanji_db_index_new(girara_list_t* links)
+{
+  jumanji_db_index_t* index = g_malloc0(sizeof(jumanji_db_index_t));
+  if (index == NULL) {
+    return NULL;
+  }
+
+  index->entries  = g_ptr_array_new();
+  index->ids      = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  index->trigrams = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+      jumanji_db_posting_free);
+  index->charsets = g_array_new(FALSE, FALSE, sizeof(guint64));
+  index->removed  = 0;
+
+  if (links != NULL && girara_list_size(links) > 0) {
+    girara_list_iterator_t* iter = girara_list_iterator(links);
+    do {
+      jumanji_db_index_add(index, girara_list_iterator_data(iter));
+    } while (girara_list_iterator_next(iter) != NULL);
+    girara_list_iterator_free(iter);
+  }
+
+  return index;
+}
+
+static void
+jumanji_db_index_free(jumanji_db_index_t* index)
+{
+  if (index == NULL) {
+    return;
+  }
+
+  /* the links themselves are owned by the lists */
+  g_ptr_array_free(index->entries, TRUE);
+  g_hash_table_destroy(index->ids);
+  g_hash_table_destroy(index->trigrams);
+  g_array_free(index->charsets, TRUE);
+  g_free(index);
+}
+
+static void
+jumanji_db_index_add_text(jumanji_db_index_t* index, const char* text, guint id)
+{
+  if (text == NULL) {
+    return;
+  }
+
+  size_t length = strlen(text);
+  for (size_t i = 0; i + 2 < length; i++) {
+    gpointer key    = GUINT_TO_POINTER(TRIGRAM(text + i));
+    GArray* posting = g_hash_table_lookup(index->trigrams, key);
+
+    if (posting == NULL) {
+      posting = g_array_new(FALSE, FALSE, sizeof(guint));
+      g_hash_table_insert(index->trigrams, key, posting);
+    }
+
+    jumanji_db_posting_add(posting, id);
+  }
+}
+
+static void
+jumanji_db_index_add(jumanji_db_index_t* index, jumanji_db_result_link_t* link)
+{
+  if (index == NULL || link == NULL || link->url == NULL) {
+    return;
+  }
+
+  /* a url that the file contains more than once shares the entry of its
+   * first occurrence */
+  if (g_hash_table_contains(index->ids, link->url) == TRUE) {
+    return;
+  }
+
+  /* ids grow monotonically, so every posting list stays sorted */
+  guint id = index->entries->len;
+  g_ptr_array_add(index->entries, link);
+  g_hash_table_insert(index->ids, g_strdup(link->url), GUINT_TO_POINTER(id));
+
+  guint64 charset = fuzzy_charset(link->url) | fuzzy_charset(link->title);
+  g_array_append_val(index->charsets, charset);
+
+  jumanji_db_index_add_text(index, link->url, id);
+  jumanji_db_index_add_text(index, link->title, id);
+}
+
+static void
+jumanji_db_index_remove(jumanji_db_index_t* index, jumanji_db_result_link_t* link)
+{
+  if (index == NULL || link == NULL || link->url == NULL) {
+    return;
+  }
+
+  /* the posting lists are left alone; finds skip removed entries until the
+   * index is compacted. Further occurrences of a url are not indexed. */
+  gpointer value = NULL;
+  if (g_hash_table_lookup_extended(index->ids, link->url, NULL, &value) == TRUE &&
+      g_ptr_array_index(index->entries, GPOINTER_TO_UINT(value)) == link) {
+    g_hash_table_remove(index->ids, link->url);
+    g_ptr_array_index(index->entries, GPOINTER_TO_UINT(value)) = NULL;
+    index->removed++;
+  }
+}
+
+static jumanji_db_index_t*
+jumanji_db_index_compact(jumanji_db_index_t* index, girara_list_t* links)
+{
+  if (index != NULL && index->removed * 2 <= index->entries->len) {
+    return index;
+  }
+
+  /* rebuild once half of the entries are stale */
+  jumanji_db_index_free(index);
+  return jumanji_db_index_new(links);
+}
+
+static jumanji_db_result_link_t*
+jumanji_db_index_lookup(jumanji_db_index_t* index, const char* url)
+{
+  if (index == NULL || url == NULL) {
+    return NULL;
+  }
+
+  gpointer value = NULL;
+  if (g_hash_table_lookup_extended(index->ids, url, NULL, &value) == FALSE) {
+    return NULL;
+  }
+
+  return g_ptr_array_index(index->entries, GPOINTER_TO_UINT(value));
+}
+
+static jumanji_db_results_t*
+jumanji_db_index_find(jumanji_db_index_t* index, const char* input)
+{
+  if (index == NULL || input == NULL) {
+    return NULL;
+  }
+
+  jumanji_db_results_t* results = jumanji_db_results_new(NULL);
+  if (results == NULL) {
+    return NULL;
+  }
+
+  /* inputs shorter than a trigram are matched against every entry */
+  size_t length = strlen(input);
+  if (length < 3) {
+    for (guint id = 0; id < index->entries->len; id++) {
+      jumanji_db_index_match(results, g_ptr_array_index(index->entries, id), input);
+    }
+
+    return results;
+  }
+
+  /* every trigram of the input has to occur in a match */
+  GPtrArray* postings = g_ptr_array_sized_new(length - 2);
+  for (size_t i = 0; i + 2 < length; i++) {
+    GArray* posting = g_hash_table_lookup(index->trigrams,
+        GUINT_TO_POINTER(TRIGRAM(input + i)));
+    if (posting == NULL) {
+      g_ptr_array_free(postings, TRUE);
+      return results;
+    }
+
+    g_ptr_array_add(postings, posting);
+  }
+
+  /* intersect the posting lists starting with the shortest one */
+  g_ptr_array_sort(postings, jumanji_db_posting_compare);
+
+  GArray* shortest = g_ptr_array_index(postings, 0);
+  for (guint i = 0; i < shortest->len; i++) {
+    guint id       = g_array_index(shortest, guint, i);
+    bool candidate = true;
+
+    for (guint j = 1; j < postings->len && candidate == true; j++) {
+      candidate = jumanji_db_posting_contains(g_ptr_array_index(postings, j), id);
+    }
+
+    /* trigrams may span url and title, so candidates are verified */
+    if (candidate == true) {
+      jumanji_db_index_match(results, g_ptr_array_index(index->entries, id), input);
+    }
+  }
+
+  g_ptr_array_free(postings, TRUE);
+
+  return results;
+}
+
+static jumanji_db_results_t*
+jumanji_db_index_find_fuzzy(jumanji_db_index_t* index, const char* input)
+{
+  if (index == NULL || input == NULL) {
+    return NULL;
+  }
+
+  fuzzy_pattern_t* pattern = fuzzy_pattern_new(input);
+  if (pattern == NULL) {
+    return NULL;
+  }
+
+  jumanji_db_results_t* results = jumanji_db_results_new(NULL);
+  if (results == NULL) {
+    fuzzy_pattern_free(pattern);
+    return NULL;
+  }
+
+  /* entries that lack a character of the input are rejected before they are
+   * scored */
+  unsigned int* candidates = g_malloc(sizeof(unsigned int) * (index->charsets->len + 1));
+  size_t number_of_candidates = fuzzy_filter((const guint64*) index->charsets->data,
+      index->charsets->len, fuzzy_pattern_charset(pattern), candidates);
+
+  GArray* matches = g_array_new(FALSE, FALSE, sizeof(fuzzy_match_t));
+  for (size_t i = 0; i < number_of_candidates; i++) {
+    jumanji_db_result_link_t* link = g_ptr_array_index(index->entries, candidates[i]);
+    fuzzy_match_t match = { 0, jumanji_db_results_size(results), link };
+
+    if (link != NULL && jumanji_db_result_link_match(pattern, link, &(match.score)) == true) {
+      g_array_append_val(matches, match);
+      jumanji_db_results_add_reference(results, link);
+    }
+  }
+
+  jumanji_db_results_rank(results, matches);
+
+  g_array_free(matches, TRUE);
+  g_free(candidates);
+  fuzzy_pattern_free(pattern);
+
+  return results;
+}
+
+static void
+jumanji_db_index_match(jumanji_db_results_t* results, jumanji_db_result_link_t* link,
+    const char* input)
+{
+  if (jumanji_db_result_link_contains(link, input) == true) {
+    jumanji_db_results_add_reference(results, link);
+  }
+}
+
+bool
+jumanji_db_result_link_contains(const jumanji_db_result_link_t* link, const char* input)
+{
+  if (link == NULL || input == NULL) {
+    return false;
+  }
+
+  return strstr(link->url, input) != NULL || (link->title && strstr(link->title, input));
+}
+
+static void
+jumanji_db_url_list_add(girara_list_t* list, jumanji_db_index_t** index,
+    const char* url, const char* title, int visited)
+{
+  /* an existing entry is replaced and moves to the end of the list */
+  jumanji_db_result_link_t* link = jumanji_db_index_lookup(*index, url);
+  if (link != NULL) {
+    jumanji_db_url_list_remove(list, *index, link);
+  }
+
+  link = jumanji_db_result_link_new(url, title, visited);
+  if (link == NULL) {
+    return;
+  }
+
+  girara_list_append(list, link);
+  jumanji_db_index_add(*index, link);
+
+  *index = jumanji_db_index_compact(*index, list);
+}
+
+static void
+jumanji_db_url_list_remove(girara_list_t* list, jumanji_db_index_t* index,
+    jumanji_db_result_link_t* link)
+{
+  jumanji_db_index_remove(index, link);
+  girara_list_remove(list, link);
+}
+
+static void
+jumanji_db_posting_free(gpointer data)
+{
+  g_array_free((GArray*) data, TRUE);
+}
+
+static void
+jumanji_db_posting_add(GArray* posting, guint id)
+{
+  /* a trigram may occur several times in the same entry */
+  if (posting->len == 0 || g_array_index(posting, guint, posting->len - 1) != id) {
+    g_array_append_val(posting, id);
+  }
+}
+
+static bool
+jumanji_db_posting_contains(GArray* posting, guint id)
+{
+  guint low  = 0;
+  guint high = posting->len;
+
+  while (low < high) {
+    guint middle = low + (high - low) / 2;
+    guint value  = g_array_index(posting, guint, middle);
+
+    if (value == id) {
+      return true;
+    } else if (value < id) {
+      low = middle + 1;
+    } else {
+      high = middle;
     }
-  } while (girara_list_iterator_next(iter) != NULL);
+  }
+
+  return false;
+}
 
-  girara_list_iterator_free(iter);
+static gint
+jumanji_db_posting_compare(gconstpointer a, gconstpointer b)
+{
+  const GArray* posting_a = *((GArray* const*) a);
+  const GArray* posting_b = *((GArray* const*) b);
 
-  return new_list;
+  return (gint) posting_a->len - (gint) posting_b->len;
 }
 
 static void
@@ -804,20 +1316,28 @@ cb_jumanji_db_watch_file(GFileMonitor* monitor, GFile* file, GFile* other_file,
     return;
   }
 
+  g_mutex_lock(&(database->lock));
+
   if (database->bookmark_file && strcmp(database->bookmark_file, path) == 0) {
     girara_list_free(database->bookmarks);
     database->bookmarks = jumanji_db_read_urls_from_file(database->bookmark_file);
     girara_list_set_free_function(database->bookmarks,  jumanji_db_free_result_link);
+    jumanji_db_index_free(database->bookmark_index);
+    database->bookmark_index = jumanji_db_index_new(database->bookmarks);
   } else if (database->history_file && strcmp(database->history_file, path) == 0) {
     girara_list_free(database->history);
     database->history = jumanji_db_read_urls_from_file(database->history_file);
     girara_list_set_free_function(database->history,    jumanji_db_free_result_link);
+    jumanji_db_index_free(database->history_index);
+    database->history_index = jumanji_db_index_new(database->history);
   } else if (database->quickmarks_file && strcmp(database->quickmarks_file, path) == 0) {
     girara_list_free(database->quickmarks);
     database->quickmarks = jumanji_db_read_quickmarks_from_file(database->quickmarks_file);
     girara_list_set_free_function(database->quickmarks, jumanji_db_free_quickmark);
   }
 
+  g_mutex_unlock(&(database->lock));
+
   g_free(path);
 }
 
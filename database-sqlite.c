@@ -3,6 +3,7 @@
 #include <girara/datastructures.h>
 #include <girara/utils.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <sqlite3.h>
 
@@ -15,6 +16,8 @@ struct jumanji_database_s
   sqlite3* session;
 };
 
+static bool jumanji_db_contains(const char* text, const char* input);
+
 jumanji_database_t*
 jumanji_db_init(const char* dir)
 {
@@ -55,7 +58,16 @@ jumanji_db_init(const char* dir)
       "url TEXT"
       ");";
 
-  if (sqlite3_open(path, &(database->session)) != SQLITE_OK) {
+  static const char SQL_SITES_INIT[] =
+    /* sites table */
+    "CREATE TABLE IF NOT EXISTS sites ("
+      "host TEXT PRIMARY KEY,"
+      "rules INT"
+      ");";
+
+  /* the connection is shared with the completion worker threads */
+  if (sqlite3_open_v2(path, &(database->session), SQLITE_OPEN_READWRITE |
+        SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX, NULL) != SQLITE_OK) {
     goto error_free;
   }
 
@@ -75,6 +87,11 @@ jumanji_db_init(const char* dir)
     goto error_free;
   }
 
+  if (sqlite3_exec(database->session, SQL_SITES_INIT, NULL, 0, NULL) != SQLITE_OK) {
+    girara_error("Could not initialize database: %s\n", path);
+    goto error_free;
+  }
+
   return database;
 
 error_free:
@@ -155,7 +172,60 @@ error_free:
   return NULL;
 }
 
-girara_list_t*
+static jumanji_db_results_t*
+jumanji_db_find_fuzzy(sqlite3* session, const char* statement_text, const char*
+    input)
+{
+  sqlite3_stmt* statement = jumanji_db_prepare_statement(session, statement_text);
+  if (statement == NULL) {
+    return NULL;
+  }
+
+  fuzzy_pattern_t* pattern = fuzzy_pattern_new(input);
+  jumanji_db_results_t* results = jumanji_db_results_new(NULL);
+  if (pattern == NULL || results == NULL) {
+    fuzzy_pattern_free(pattern);
+    jumanji_db_results_free(results);
+    sqlite3_finalize(statement);
+    return NULL;
+  }
+
+  guint64 required = fuzzy_pattern_charset(pattern);
+  GArray* matches  = g_array_new(FALSE, FALSE, sizeof(fuzzy_match_t));
+  bool visited     = (sqlite3_column_count(statement) > 2);
+
+  while (sqlite3_step(statement) == SQLITE_ROW) {
+    jumanji_db_result_link_t row = {
+      .url       = (char*) sqlite3_column_text(statement, 0),
+      .title     = (char*) sqlite3_column_text(statement, 1),
+      .visited   = (visited == true) ? sqlite3_column_int(statement, 2) : 0,
+      .ref_count = 0
+    };
+
+    /* rows that lack a character of the input are rejected before they are
+     * scored; only matching rows are copied */
+    if (((fuzzy_charset(row.url) | fuzzy_charset(row.title)) & required) != required) {
+      continue;
+    }
+
+    fuzzy_match_t match = { 0, jumanji_db_results_size(results), NULL };
+    if (jumanji_db_result_link_match(pattern, &row, &(match.score)) == true) {
+      g_array_append_val(matches, match);
+      jumanji_db_results_add_copy(results, row.url, row.title, row.visited);
+    }
+  }
+
+  sqlite3_finalize(statement);
+
+  jumanji_db_results_rank(results, matches);
+
+  g_array_free(matches, TRUE);
+  fuzzy_pattern_free(pattern);
+
+  return results;
+}
+
+jumanji_db_results_t*
 jumanji_db_bookmark_find(jumanji_database_t* database, const char* input)
 {
   if (database == NULL || database->session == NULL || input == NULL) {
@@ -184,30 +254,18 @@ jumanji_db_bookmark_find(jumanji_database_t* database, const char* input)
     return NULL;
   }
 
-  girara_list_t* results = girara_list_new();
+  jumanji_db_results_t* results = jumanji_db_results_new(NULL);
 
   if (results == NULL) {
     sqlite3_finalize(statement);
     return NULL;
   }
 
-  girara_list_set_free_function(results, jumanji_db_free_result_link);
-
   while(sqlite3_step(statement) == SQLITE_ROW) {
-    jumanji_db_result_link_t* link = malloc(sizeof(jumanji_db_result_link_t));
-    if (link == NULL) {
-      sqlite3_finalize(statement);
-      return NULL;
-    }
-
     char* url   = (char*) sqlite3_column_text(statement, 0);
     char* title = (char*) sqlite3_column_text(statement, 1);
 
-    link->url     = g_strdup(url);
-    link->title   = g_strdup(title);
-    link->visited = 0;
-
-    girara_list_append(results, link);
+    jumanji_db_results_add_copy(results, url, title, 0);
   }
 
   sqlite3_finalize(statement);
@@ -215,6 +273,19 @@ jumanji_db_bookmark_find(jumanji_database_t* database, const char* input)
   return results;
 }
 
+jumanji_db_results_t*
+jumanji_db_bookmark_find_fuzzy(jumanji_database_t* database, const char* input)
+{
+  if (database == NULL || database->session == NULL || input == NULL) {
+    return NULL;
+  }
+
+  static const char SQL_BOOKMARK_FIND_FUZZY[] =
+    "SELECT url, title FROM bookmarks;";
+
+  return jumanji_db_find_fuzzy(database->session, SQL_BOOKMARK_FIND_FUZZY, input);
+}
+
 void
 jumanji_db_bookmark_remove(jumanji_database_t* database, const char* url)
 {
@@ -276,7 +347,7 @@ jumanji_db_bookmark_add(jumanji_database_t* database, const char* url, const cha
   sqlite3_finalize(statement);
 }
 
-girara_list_t*
+jumanji_db_results_t*
 jumanji_db_history_find(jumanji_database_t* database, const char* input)
 {
   if (database == NULL || database->session == NULL || input == NULL) {
@@ -305,30 +376,18 @@ jumanji_db_history_find(jumanji_database_t* database, const char* input)
     return NULL;
   }
 
-  girara_list_t* results = girara_list_new();
+  jumanji_db_results_t* results = jumanji_db_results_new(NULL);
 
   if (results == NULL) {
     sqlite3_finalize(statement);
     return NULL;
   }
 
-  girara_list_set_free_function(results, jumanji_db_free_result_link);
-
   while(sqlite3_step(statement) == SQLITE_ROW) {
-    jumanji_db_result_link_t* link = malloc(sizeof(jumanji_db_result_link_t));
-    if (link == NULL) {
-      sqlite3_finalize(statement);
-      return NULL;
-    }
-
     char* url   = (char*) sqlite3_column_text(statement, 0);
     char* title = (char*) sqlite3_column_text(statement, 1);
 
-    link->url     = g_strdup(url);
-    link->title   = g_strdup(title);
-    link->visited = sqlite3_column_int(statement, 2);
-
-    girara_list_append(results, link);
+    jumanji_db_results_add_copy(results, url, title, sqlite3_column_int(statement, 2));
   }
 
   sqlite3_finalize(statement);
@@ -336,6 +395,19 @@ jumanji_db_history_find(jumanji_database_t* database, const char* input)
   return results;
 }
 
+jumanji_db_results_t*
+jumanji_db_history_find_fuzzy(jumanji_database_t* database, const char* input)
+{
+  if (database == NULL || database->session == NULL || input == NULL) {
+    return NULL;
+  }
+
+  static const char SQL_HISTORY_FIND_FUZZY[] =
+    "SELECT url, title, visited FROM history;";
+
+  return jumanji_db_find_fuzzy(database->session, SQL_HISTORY_FIND_FUZZY, input);
+}
+
 void
 jumanji_db_history_add(jumanji_database_t* database, const char* url, const char* title)
 {
@@ -492,6 +564,109 @@ jumanji_db_quickmark_remove(jumanji_database_t* database, const char identifier)
   sqlite3_finalize(statement);
 }
 
+bool
+jumanji_db_result_link_contains(const jumanji_db_result_link_t* link, const char* input)
+{
+  if (link == NULL || input == NULL) {
+    return false;
+  }
+
+  return jumanji_db_contains(link->url, input) == true ||
+    jumanji_db_contains(link->title, input) == true;
+}
+
+static bool
+jumanji_db_contains(const char* text, const char* input)
+{
+  if (text == NULL) {
+    return false;
+  }
+
+  /* LIKE only ignores the case of ASCII letters */
+  size_t length = strlen(input);
+  for (const char* position = text; *position != '\0'; position++) {
+    if (g_ascii_strncasecmp(position, input, length) == 0) {
+      return true;
+    }
+  }
+
+  return length == 0;
+}
+
+void
+jumanji_db_site_set(jumanji_database_t* database, const char* host, unsigned int rules)
+{
+  if (database == NULL || database->session == NULL || host == NULL) {
+    return;
+  }
+
+  /* prepare statement */
+  static const char SQL_SITE_SET[] =
+    "REPLACE INTO sites (host, rules) VALUES (?, ?);";
+  static const char SQL_SITE_REMOVE[] =
+    "DELETE FROM sites WHERE host = ?;";
+
+  sqlite3_stmt* statement = jumanji_db_prepare_statement(database->session,
+      (rules != 0) ? SQL_SITE_SET : SQL_SITE_REMOVE);
+
+  if (statement == NULL) {
+    return;
+  }
+
+  /* bind values */
+  if (sqlite3_bind_text(statement, 1, host, -1, NULL) != SQLITE_OK ||
+      (rules != 0 && sqlite3_bind_int(statement, 2, rules) != SQLITE_OK)
+      ) {
+    girara_error("Could not bind query parameters");
+    sqlite3_finalize(statement);
+    return;
+  }
+
+  sqlite3_step(statement);
+  sqlite3_finalize(statement);
+}
+
+girara_list_t*
+jumanji_db_site_list(jumanji_database_t* database)
+{
+  if (database == NULL || database->session == NULL) {
+    return NULL;
+  }
+
+  /* prepare statement */
+  static const char SQL_SITE_LIST[] =
+    "SELECT host, rules FROM sites;";
+
+  sqlite3_stmt* statement = jumanji_db_prepare_statement(database->session,
+      SQL_SITE_LIST);
+
+  if (statement == NULL) {
+    return NULL;
+  }
+
+  girara_list_t* list = girara_list_new2(jumanji_db_free_site);
+  if (list == NULL) {
+    sqlite3_finalize(statement);
+    return NULL;
+  }
+
+  while (sqlite3_step(statement) == SQLITE_ROW) {
+    jumanji_db_site_t* site = malloc(sizeof(jumanji_db_site_t));
+    if (site == NULL) {
+      continue;
+    }
+
+    site->host  = g_strdup((const char*) sqlite3_column_text(statement, 0));
+    site->rules = sqlite3_column_int(statement, 1);
+
+    girara_list_append(list, site);
+  }
+
+  sqlite3_finalize(statement);
+
+  return list;
+}
+
 void
 jumanji_db_save_session(jumanji_database_t* database, const char* name, girara_list_t* urls)
 {
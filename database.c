@@ -4,6 +4,70 @@
 
 #include "database.h"
 
+struct jumanji_db_results_s
+{
+  GArray* links; /**> The links; their strings point into the storage below */
+  GPtrArray* references; /**> Referenced links of the database */
+  GStringChunk* strings; /**> Copied strings */
+  jumanji_db_results_t* base; /**> Result set the links may point into */
+  gint ref_count; /**> Reference count */
+};
+
+jumanji_db_result_link_t*
+jumanji_db_result_link_new(const char* url, const char* title, int visited)
+{
+  jumanji_db_result_link_t* link = malloc(sizeof(jumanji_db_result_link_t));
+  if (link == NULL) {
+    return NULL;
+  }
+
+  link->url       = g_strdup(url);
+  link->title     = g_strdup(title);
+  link->visited   = visited;
+  link->ref_count = 1;
+
+  return link;
+}
+
+jumanji_db_result_link_t*
+jumanji_db_result_link_ref(jumanji_db_result_link_t* link)
+{
+  if (link != NULL) {
+    g_atomic_int_inc(&(link->ref_count));
+  }
+
+  return link;
+}
+
+bool
+jumanji_db_result_link_match(const fuzzy_pattern_t* pattern, const
+    jumanji_db_result_link_t* link, int* score)
+{
+  if (pattern == NULL || link == NULL) {
+    return false;
+  }
+
+  int url_score   = 0;
+  int title_score = 0;
+
+  bool url_match   = fuzzy_match(pattern, link->url, &url_score);
+  bool title_match = fuzzy_match(pattern, link->title, &title_score);
+
+  if (url_match == false && title_match == false) {
+    return false;
+  }
+
+  if (score != NULL) {
+    if (url_match == true && title_match == true) {
+      *score = MAX(url_score, title_score);
+    } else {
+      *score = (url_match == true) ? url_score : title_score;
+    }
+  }
+
+  return true;
+}
+
 void
 jumanji_db_free_result_link(void* data)
 {
@@ -12,7 +76,166 @@ jumanji_db_free_result_link(void* data)
   }
 
   jumanji_db_result_link_t* link = (jumanji_db_result_link_t*) data;
+  if (g_atomic_int_dec_and_test(&(link->ref_count)) == FALSE) {
+    return;
+  }
+
   g_free(link->url);
   g_free(link->title);
   free(link);
 }
+
+void
+jumanji_db_free_site(void* data)
+{
+  if (data == NULL) {
+    return;
+  }
+
+  jumanji_db_site_t* site = (jumanji_db_site_t*) data;
+  g_free(site->host);
+  free(site);
+}
+
+jumanji_db_results_t*
+jumanji_db_results_new(jumanji_db_results_t* base)
+{
+  jumanji_db_results_t* results = g_malloc0(sizeof(jumanji_db_results_t));
+  if (results == NULL) {
+    return NULL;
+  }
+
+  results->links      = g_array_new(FALSE, FALSE, sizeof(jumanji_db_result_link_t));
+  results->references = NULL;
+  results->strings    = NULL;
+  results->base       = jumanji_db_results_ref(base);
+  results->ref_count  = 1;
+
+  return results;
+}
+
+jumanji_db_results_t*
+jumanji_db_results_ref(jumanji_db_results_t* results)
+{
+  if (results != NULL) {
+    g_atomic_int_inc(&(results->ref_count));
+  }
+
+  return results;
+}
+
+void
+jumanji_db_results_free(jumanji_db_results_t* results)
+{
+  if (results == NULL || g_atomic_int_dec_and_test(&(results->ref_count)) == FALSE) {
+    return;
+  }
+
+  if (results->references != NULL) {
+    g_ptr_array_free(results->references, TRUE);
+  }
+
+  if (results->strings != NULL) {
+    g_string_chunk_free(results->strings);
+  }
+
+  g_array_free(results->links, TRUE);
+  jumanji_db_results_free(results->base);
+  g_free(results);
+}
+
+size_t
+jumanji_db_results_size(const jumanji_db_results_t* results)
+{
+  return (results != NULL) ? results->links->len : 0;
+}
+
+const jumanji_db_result_link_t*
+jumanji_db_results_get(const jumanji_db_results_t* results, size_t index)
+{
+  if (results == NULL || index >= results->links->len) {
+    return NULL;
+  }
+
+  return &g_array_index(results->links, jumanji_db_result_link_t, index);
+}
+
+void
+jumanji_db_results_add_reference(jumanji_db_results_t* results,
+    jumanji_db_result_link_t* link)
+{
+  if (results == NULL || link == NULL) {
+    return;
+  }
+
+  if (results->references == NULL) {
+    results->references = g_ptr_array_new_with_free_func(jumanji_db_free_result_link);
+  }
+
+  g_ptr_array_add(results->references, jumanji_db_result_link_ref(link));
+  jumanji_db_results_add_view(results, link);
+}
+
+void
+jumanji_db_results_add_copy(jumanji_db_results_t* results, const char* url,
+    const char* title, int visited)
+{
+  if (results == NULL || url == NULL) {
+    return;
+  }
+
+  if (results->strings == NULL) {
+    results->strings = g_string_chunk_new(4096);
+  }
+
+  jumanji_db_result_link_t link = {
+    .url       = g_string_chunk_insert(results->strings, url),
+    .title     = (title != NULL) ? g_string_chunk_insert(results->strings, title) : NULL,
+    .visited   = visited,
+    .ref_count = 0
+  };
+
+  g_array_append_val(results->links, link);
+}
+
+void
+jumanji_db_results_add_view(jumanji_db_results_t* results, const
+    jumanji_db_result_link_t* link)
+{
+  if (results == NULL || link == NULL) {
+    return;
+  }
+
+  /* views are not reference counted, their strings are owned elsewhere */
+  jumanji_db_result_link_t view = {
+    .url       = link->url,
+    .title     = link->title,
+    .visited   = link->visited,
+    .ref_count = 0
+  };
+
+  g_array_append_val(results->links, view);
+}
+
+void
+jumanji_db_results_rank(jumanji_db_results_t* results, GArray* matches)
+{
+  if (results == NULL || matches == NULL) {
+    return;
+  }
+
+  fuzzy_sort(matches);
+
+  GArray* links = g_array_sized_new(FALSE, FALSE, sizeof(jumanji_db_result_link_t),
+      matches->len);
+
+  for (guint i = 0; i < matches->len; i++) {
+    unsigned int position = g_array_index(matches, fuzzy_match_t, i).position;
+    if (position < results->links->len) {
+      g_array_append_val(links, g_array_index(results->links, jumanji_db_result_link_t, position));
+    }
+  }
+
+  g_array_free(results->links, TRUE);
+  results->links = links;
+}
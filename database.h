@@ -6,14 +6,24 @@
 #include <stdbool.h>
 
 #include "jumanji.h"
+#include "fuzzy.h"
 
 typedef struct jumanji_db_result_link_s
 {
   char* url; /**> The url of the link */
   char* title; /**> The link title */
   int visited; /**> Last time the link has been visited */
+  int ref_count; /**> Reference count */
 } jumanji_db_result_link_t;
 
+typedef struct jumanji_db_site_s
+{
+  char* host; /**> Host the rules apply to, including its subdomains */
+  unsigned int rules; /**> Content rules of the host */
+} jumanji_db_site_t;
+
+typedef struct jumanji_db_results_s jumanji_db_results_t;
+
 /**
  * Creates a new database object
  *
@@ -48,13 +58,23 @@ void jumanji_db_free(jumanji_database_t* database);
 void jumanji_db_bookmark_add(jumanji_database_t* database, const char* url, const char* title);
 
 /**
- * Find bookmarks
+ * Find bookmarks. This function may be called from any thread.
+ *
+ * @param session The databases session
+ * @param input The data that the bookmark should match
+ * @return result set or NULL if an error occured
+ */
+jumanji_db_results_t* jumanji_db_bookmark_find(jumanji_database_t* database, const char* input);
+
+/**
+ * Find bookmarks that fuzzily match the input. The results are sorted by
+ * relevance. This function may be called from any thread.
  *
  * @param session The databases session
  * @param input The data that the bookmark should match
- * @return list or NULL if an error occured
+ * @return result set or NULL if an error occured
  */
-girara_list_t* jumanji_db_bookmark_find(jumanji_database_t* database, const char* input);
+jumanji_db_results_t* jumanji_db_bookmark_find_fuzzy(jumanji_database_t* database, const char* input);
 
 /**
  * Removes a saved bookmark
@@ -74,13 +94,23 @@ void jumanji_db_bookmark_remove(jumanji_database_t* database, const char* url);
 void jumanji_db_history_add(jumanji_database_t* database, const char* url, const char* title);
 
 /**
- * Find history
+ * Find history. This function may be called from any thread.
  *
  * @param session The databases session
  * @param input The data that the bookmark should match
- * @return list or NULL if an error occured
+ * @return result set or NULL if an error occured
+ */
+jumanji_db_results_t* jumanji_db_history_find(jumanji_database_t* database, const char* input);
+
+/**
+ * Find history entries that fuzzily match the input. The results are sorted
+ * by relevance. This function may be called from any thread.
+ *
+ * @param session The databases session
+ * @param input The data that the history item should match
+ * @return result set or NULL if an error occured
  */
-girara_list_t* jumanji_db_history_find(jumanji_database_t* database, const char* input);
+jumanji_db_results_t* jumanji_db_history_find_fuzzy(jumanji_database_t* database, const char* input);
 
 /**
  * Cleans the history
@@ -116,14 +146,80 @@ char* jumanji_db_quickmark_find(jumanji_database_t* database, const char identif
  */
 void jumanji_db_quickmark_remove(jumanji_database_t* database, const char identifier);
 
+/**
+ * Saves the content rules of a host (or overwrites the existing ones)
+ *
+ * @param database The database session
+ * @param host The host
+ * @param rules The rules; 0 removes the host
+ */
+void jumanji_db_site_set(jumanji_database_t* database, const char* host, unsigned int rules);
+
+/**
+ * Loads the content rules of all hosts
+ *
+ * @param database The database session
+ * @return List of jumanji_db_site_t or NULL if an error occured
+ */
+girara_list_t* jumanji_db_site_list(jumanji_database_t* database);
+
+/**
+ * Frees the content rules of a host
+ *
+ * @param data Site data
+ */
+void jumanji_db_free_site(void* data);
+
+/**
+ * Creates a new result link with a reference count of one
+ *
+ * @param url The url of the link
+ * @param title The title of the link (optional)
+ * @param visited Last time the link has been visited
+ * @return The link or NULL if an error occured
+ */
+jumanji_db_result_link_t* jumanji_db_result_link_new(const char* url, const
+    char* title, int visited);
+
+/**
+ * Increases the reference count of a result link
+ *
+ * @param link The link
+ * @return The link
+ */
+jumanji_db_result_link_t* jumanji_db_result_link_ref(jumanji_db_result_link_t* link);
+
+/**
+ * Matches a link against a fuzzy pattern
+ *
+ * @param pattern The pattern
+ * @param link The link
+ * @param score Receives the better score of the url and the title
+ * @return true if the url or the title matches
+ */
+bool jumanji_db_result_link_match(const fuzzy_pattern_t* pattern, const
+    jumanji_db_result_link_t* link, int* score);
 
 /**
- * Frees a result link
+ * Releases a reference of a result link and frees it once the last reference
+ * is gone
  *
  * @param data Link data
  */
 void jumanji_db_free_result_link(void* data);
 
+/**
+ * Checks if the url or the title of a link contains the input. The input is
+ * compared like the find functions of the database backend compare it, e.g.
+ * ignoring the case of ASCII letters like LIKE does in SQLite.
+ *
+ * @param link The link
+ * @param input The input
+ * @return true if the url or the title contains the input
+ */
+bool jumanji_db_result_link_contains(const jumanji_db_result_link_t* link,
+    const char* input);
+
 /**
  * Write a list of urls in a session
  *
@@ -140,4 +236,87 @@ void jumanji_db_save_session(jumanji_database_t* database, const char* name, gir
  */
 girara_list_t* jumanji_db_load_session(jumanji_database_t* database, const char* name);
 
+/**
+ * Creates a new, empty result set. Result sets keep the strings of their links
+ * in a few shared blocks: links of the database are referenced instead of
+ * copied, other strings are copied into one string chunk.
+ *
+ * @param base A result set that links of the new set may point into (optional)
+ * @return The result set or NULL if an error occured
+ */
+jumanji_db_results_t* jumanji_db_results_new(jumanji_db_results_t* base);
+
+/**
+ * Increases the reference count of a result set
+ *
+ * @param results The result set
+ * @return The result set
+ */
+jumanji_db_results_t* jumanji_db_results_ref(jumanji_db_results_t* results);
+
+/**
+ * Releases a reference of a result set and frees it, including all of its
+ * links, once the last reference is gone
+ *
+ * @param results The result set
+ */
+void jumanji_db_results_free(jumanji_db_results_t* results);
+
+/**
+ * Returns the number of links of a result set
+ *
+ * @param results The result set
+ * @return The number of links
+ */
+size_t jumanji_db_results_size(const jumanji_db_results_t* results);
+
+/**
+ * Returns a link of a result set. The link stays valid as long as the result
+ * set and must not be modified or freed.
+ *
+ * @param results The result set
+ * @param index Index of the link
+ * @return The link or NULL if the index is out of range
+ */
+const jumanji_db_result_link_t* jumanji_db_results_get(const
+    jumanji_db_results_t* results, size_t index);
+
+/**
+ * Adds a link of the database to a result set without copying it
+ *
+ * @param results The result set
+ * @param link The link, the result set holds a reference of it
+ */
+void jumanji_db_results_add_reference(jumanji_db_results_t* results,
+    jumanji_db_result_link_t* link);
+
+/**
+ * Adds a link to a result set by copying its strings into the result set
+ *
+ * @param results The result set
+ * @param url The url of the link
+ * @param title The title of the link (optional)
+ * @param visited Last time the link has been visited
+ */
+void jumanji_db_results_add_copy(jumanji_db_results_t* results, const char*
+    url, const char* title, int visited);
+
+/**
+ * Adds a link of the base result set to a result set without copying it
+ *
+ * @param results The result set
+ * @param link A link of the base of the result set
+ */
+void jumanji_db_results_add_view(jumanji_db_results_t* results, const
+    jumanji_db_result_link_t* link);
+
+/**
+ * Reorders a result set by relevance
+ *
+ * @param results The result set
+ * @param matches Array of fuzzy_match_t whose positions are indices into the
+ *   result set; links without a match are dropped
+ */
+void jumanji_db_results_rank(jumanji_db_results_t* results, GArray* matches);
+
 #endif // DATABASE_H
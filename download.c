@@ -1,7 +1,10 @@
 /* See LICENSE file for license and copyright information */
 
+#include <errno.h>
+#include <signal.h>
 #include <string.h>
 #include <stdlib.h>
+#include <glib/gstdio.h>
 
 #include "download.h"
 #include <girara/settings.h>
@@ -9,124 +12,268 @@
 #include <girara/session.h>
 #include <girara/datastructures.h>
 
-#if 0
+static jumanji_download_t* jumanji_download_new(jumanji_t* jumanji, const char* uri, char* file, const char* referer);
+static char* jumanji_download_destination(jumanji_t* jumanji, const char* uri, const char* suggested_filename);
+static char* jumanji_download_part_file(jumanji_download_t* download);
+static void jumanji_download_schedule(jumanji_t* jumanji);
+static void jumanji_download_start(jumanji_download_t* download);
+static void jumanji_download_done(jumanji_download_t* download, GError* error);
+static gboolean cb_jumanji_download_retry(gpointer data);
+static void cb_jumanji_download_cookies(GObject* source, GAsyncResult* result, gpointer data);
+static void cb_jumanji_download_sent(GObject* source, GAsyncResult* result, gpointer data);
+static char* jumanji_download_validator(SoupMessageHeaders* headers);
+static void jumanji_download_restart(jumanji_download_t* download);
+static char** jumanji_download_command_argv(const char* command, const char* uri, const char* file, GError** error);
+static void jumanji_download_spawn(jumanji_download_t* download, const char* command);
+static void cb_jumanji_download_child_exited(GPid pid, gint status, gpointer data);
+static void jumanji_download_read(jumanji_download_t* download);
+static void cb_jumanji_download_read(GObject* source, GAsyncResult* result, gpointer data);
+static void cb_jumanji_download_written(GObject* source, GAsyncResult* result, gpointer data);
+static void jumanji_download_sample(jumanji_download_t* download, gint64 time);
+static double jumanji_download_throughput(jumanji_download_t* download);
+static void jumanji_download_progress_start(jumanji_t* jumanji);
+static gboolean cb_jumanji_download_progress(gpointer data);
+static bool cb_jumanji_download_decide_destination(WebKitDownload* webkit_download, gchar* suggested_filename, jumanji_t* jumanji);
+static void cb_jumanji_download_webkit_failed(WebKitDownload* webkit_download, GError* error, jumanji_download_t* download);
+static void cb_jumanji_download_webkit_finished(WebKitDownload* webkit_download, jumanji_download_t* download);
+
 bool
-jumanji_download_file(jumanji_t* jumanji, WebKitDownload* download)
+jumanji_downloads_init(jumanji_t* jumanji)
 {
-  if (jumanji == NULL || jumanji->ui.session == NULL || download == NULL) {
+  if (jumanji == NULL || jumanji->downloads.list == NULL || jumanji->config.data_dir == NULL) {
     return false;
   }
 
-  const char* uri = webkit_download_get_uri(download);
-  char* file      = (char*) webkit_download_get_suggested_filename(download);
-
-  if (uri == NULL) {
+  /* downloads are transferred by jumanji so that they can be resumed, webkit
+   * neither sends range requests nor keeps the data of interrupted downloads */
+  jumanji->downloads.session = soup_session_new();
+  if (jumanji->downloads.session == NULL) {
     return false;
   }
 
-  /* get download dir */
-  char* download_dir_tmp = NULL;
-  girara_setting_get(jumanji->ui.session, "download-dir", &download_dir_tmp);
-  if (download_dir_tmp == NULL) {
-    return false;
+  jumanji->downloads.file = g_build_filename(jumanji->config.data_dir,
+      JUMANJI_DOWNLOAD_QUEUE_FILE, NULL);
+
+  g_signal_connect(G_OBJECT(jumanji->global.web_context), "download-started",
+      G_CALLBACK(cb_jumanji_download_started), jumanji);
+
+  /* restore the downloads that did not finish */
+  GKeyFile* key_file = g_key_file_new();
+  if (g_key_file_load_from_file(key_file, jumanji->downloads.file, G_KEY_FILE_NONE, NULL) == TRUE) {
+    gchar** groups = g_key_file_get_groups(key_file, NULL);
+    for (unsigned int i = 0; groups != NULL && groups[i] != NULL; i++) {
+      char* uri       = g_key_file_get_string(key_file, groups[i], "uri", NULL);
+      char* file      = g_key_file_get_string(key_file, groups[i], "file", NULL);
+      char* referer   = g_key_file_get_string(key_file, groups[i], "referer", NULL);
+      char* validator = g_key_file_get_string(key_file, groups[i], "validator", NULL);
+
+      /* the validator has to be known before the download is started */
+      if (uri != NULL && file != NULL) {
+        jumanji_download_t* download = jumanji_download_new(jumanji, uri, file, referer);
+        if (download != NULL) {
+          download->validator = validator;
+          validator = NULL;
+        }
+      } else {
+        g_free(file);
+      }
+
+      g_free(uri);
+      g_free(referer);
+      g_free(validator);
+    }
+    g_strfreev(groups);
   }
+  g_key_file_free(key_file);
 
-  char* download_dir = girara_fix_path(download_dir_tmp);
-  g_free(download_dir_tmp);
+  jumanji_download_schedule(jumanji);
 
-  if (download_dir == NULL) {
+  return true;
+}
+
+void
+jumanji_downloads_free(jumanji_t* jumanji)
+{
+  if (jumanji == NULL) {
+    return;
+  }
+
+  jumanji_downloads_save(jumanji);
+
+  g_signal_handlers_disconnect_by_func(jumanji->global.web_context,
+      cb_jumanji_download_started, jumanji);
+
+  if (jumanji->downloads.progress_source != 0) {
+    g_source_remove(jumanji->downloads.progress_source);
+    jumanji->downloads.progress_source = 0;
+  }
+
+  girara_list_free(jumanji->downloads.list);
+  jumanji->downloads.list = NULL;
+
+  if (jumanji->downloads.session != NULL) {
+    soup_session_abort(jumanji->downloads.session);
+    g_object_unref(jumanji->downloads.session);
+    jumanji->downloads.session = NULL;
+  }
+
+  g_free(jumanji->downloads.file);
+  jumanji->downloads.file = NULL;
+}
+
+bool
+jumanji_downloads_save(jumanji_t* jumanji)
+{
+  if (jumanji == NULL || jumanji->downloads.list == NULL || jumanji->downloads.file == NULL) {
     return false;
   }
 
-  /* build filename */
-  if (file == NULL) {
-    file = g_strdup(uri);
-    for (unsigned int i = 0; i < strlen(file); i++) {
-      if (file[i] == '/') {
-        file[i] = '-';
+  GKeyFile* key_file = g_key_file_new();
+  unsigned int n     = 0;
+
+  if (girara_list_size(jumanji->downloads.list) > 0) {
+    girara_list_iterator_t* iter = girara_list_iterator(jumanji->downloads.list);
+    do {
+      jumanji_download_t* download = (jumanji_download_t*) girara_list_iterator_data(iter);
+
+      /* downloads that are run by webkit can not be resumed and running
+       * download commands outlive jumanji */
+      if (download->download != NULL || download->file == NULL ||
+          (download->state != JUMANJI_DOWNLOAD_QUEUED &&
+           download->state != JUMANJI_DOWNLOAD_RUNNING) ||
+          (download->state == JUMANJI_DOWNLOAD_RUNNING && download->external == true)) {
+        continue;
       }
-    }
-  } else {
-    file = g_strdup(file);
+
+      char* group = g_strdup_printf("%u", n++);
+      g_key_file_set_string(key_file, group, "uri", download->uri);
+      g_key_file_set_string(key_file, group, "file", download->file);
+      if (download->referer != NULL) {
+        g_key_file_set_string(key_file, group, "referer", download->referer);
+      }
+      if (download->validator != NULL) {
+        g_key_file_set_string(key_file, group, "validator", download->validator);
+      }
+      g_free(group);
+    } while (girara_list_iterator_next(iter) != NULL);
+    girara_list_iterator_free(iter);
   }
 
-  char* filename = g_build_filename(download_dir, file, NULL);
+  GError* error = NULL;
+  bool result   = true;
+  if (g_key_file_save_to_file(key_file, jumanji->downloads.file, &error) == FALSE) {
+    girara_error("Could not save the download queue: %s", error->message);
+    g_error_free(error);
+    result = false;
+  }
+
+  g_key_file_free(key_file);
+
+  return result;
+}
+
+jumanji_download_t*
+jumanji_download_add(jumanji_t* jumanji, const char* uri, const char* file,
+    const char* referer)
+{
+  if (jumanji == NULL || jumanji->downloads.list == NULL || uri == NULL) {
+    return NULL;
+  }
+
+  char* destination = (file != NULL) ? g_strdup(file)
+    : jumanji_download_destination(jumanji, uri, NULL);
+  if (destination == NULL) {
+    return NULL;
+  }
 
-  if (filename == NULL) {
-    g_free(download_dir);
+  jumanji_download_t* download = jumanji_download_new(jumanji, uri, destination, referer);
+  if (download == NULL) {
+    return NULL;
+  }
+
+  girara_notify(jumanji->ui.session, GIRARA_INFO, "Added download: %s", download->file);
+
+  jumanji_downloads_save(jumanji);
+  jumanji_download_schedule(jumanji);
+
+  return download;
+}
+
+bool
+jumanji_download_cancel(jumanji_download_t* download)
+{
+  if (download == NULL || (download->state != JUMANJI_DOWNLOAD_QUEUED &&
+        download->state != JUMANJI_DOWNLOAD_RUNNING)) {
     return false;
   }
 
-  /* check for custom download command */
-  char* download_command = NULL;
-  girara_setting_get(jumanji->ui.session, "download-command", &download_command);
-  if (download_command != NULL) {
-    char* command = strstr(download_command, "%s");
-    if (command == NULL) {
-      girara_error("Invalid download command: %s", download_command);
-      g_free(download_command);
-      return false;
+  jumanji_t* jumanji = download->jumanji;
+
+  if (download->retry != 0) {
+    g_source_remove(download->retry);
+    download->retry = 0;
+  }
+
+  if (download->state == JUMANJI_DOWNLOAD_RUNNING) {
+    if (download->download != NULL) {
+      g_signal_handlers_disconnect_by_data(download->download, download);
+      webkit_download_cancel(download->download);
+    } else if (download->external == true && download->child_watch != 0) {
+      /* the process is still reaped by its child watch */
+      kill(download->pid, SIGTERM);
     }
 
-    /* one argument (uri) */
-    if ((command = strstr(command, "%s")) == NULL) {
-      command = g_strdup_printf(download_command, uri);
-    /* two arguments (uri, filename) */
-    } else {
-      command = g_strdup_printf(download_command, uri, filename);
+    /* the pending callbacks see the cancellation and leave the download alone */
+    if (download->cancellable != NULL) {
+      g_cancellable_cancel(download->cancellable);
+      g_object_unref(download->cancellable);
+      download->cancellable = NULL;
+    }
+
+    if (download->message != NULL) {
+      g_object_unref(download->message);
+      download->message = NULL;
     }
 
-    g_spawn_command_line_async(command, NULL);
+    if (download->input != NULL) {
+      g_object_unref(download->input);
+      download->input = NULL;
+    }
 
-    girara_notify(jumanji->ui.session, GIRARA_INFO, "Started download: %s", filename);
+    if (download->output != NULL) {
+      g_object_unref(download->output);
+      download->output = NULL;
+    }
 
-    free(download_command);
-    g_free(command);
-  /* internal download handler */
-  } else {
-    jumanji_download_t* jumanji_download = malloc(sizeof(jumanji_download_t));
-    if (jumanji_download == NULL) {
-      return false;
+    if (download->buffer != NULL) {
+      g_bytes_unref(download->buffer);
+      download->buffer = NULL;
     }
 
-    /* set up download */
-    char* file_uri = g_filename_to_uri(filename, NULL, NULL);
-    webkit_download_set_destination_uri(download, file_uri);
-    g_free(file_uri);
-
-    g_signal_connect(G_OBJECT(download), "notify::status",   G_CALLBACK(cb_jumanji_download_status),   jumanji_download);
-    g_signal_connect(G_OBJECT(download), "notify::progress", G_CALLBACK(cb_jumanji_download_progress), jumanji_download);
-
-    jumanji_download->size        = -1;
-    jumanji_download->uri         = uri;
-    jumanji_download->download    = download;
-    jumanji_download->file        = file;
-    jumanji_download->jumanji     = jumanji;
-
-    if (jumanji_download_create_widget(jumanji, jumanji_download) == false) {
-      free(jumanji_download);
-      g_free(filename);
-      g_free(download_dir);
-      return false;
+    if (jumanji->downloads.running > 0) {
+      jumanji->downloads.running--;
     }
+  }
 
-    jumanji_download_set_status(jumanji_download);
+  if (download->download == NULL && download->external == false) {
+    char* part_file = jumanji_download_part_file(download);
+    g_unlink(part_file);
+    g_free(part_file);
+  }
 
-    /* add to list */
-    girara_list_append(jumanji->downloads.list, jumanji_download);
+  download->state = JUMANJI_DOWNLOAD_CANCELLED;
 
-    /* start download */
-    webkit_download_start(download);
+  g_free(download->error);
+  download->error = NULL;
 
-    girara_notify(jumanji->ui.session, GIRARA_INFO, "Started download: %s", file);
-  }
+  girara_notify(jumanji->ui.session, GIRARA_INFO, "Cancelled download: %s", download->file);
 
-  g_free(filename);
-  g_free(download_dir);
+  jumanji_download_set_status(download);
+  jumanji_downloads_save(jumanji);
+  jumanji_download_schedule(jumanji);
 
   return true;
 }
-#endif
 
 void
 jumanji_download_free(void* data)
@@ -137,33 +284,67 @@ jumanji_download_free(void* data)
 
   jumanji_download_t* download = (jumanji_download_t*) data;
 
+  /* the pending callbacks see the cancellation and leave the download alone */
+  if (download->cancellable != NULL) {
+    g_cancellable_cancel(download->cancellable);
+    g_object_unref(download->cancellable);
+  }
+
+  if (download->message != NULL) {
+    g_object_unref(download->message);
+  }
+
+  if (download->input != NULL) {
+    g_object_unref(download->input);
+  }
+
+  if (download->output != NULL) {
+    g_object_unref(download->output);
+  }
+
+  if (download->buffer != NULL) {
+    g_bytes_unref(download->buffer);
+  }
+
+  if (download->download != NULL) {
+    g_signal_handlers_disconnect_by_data(download->download, download);
+    g_object_unref(download->download);
+  }
+
+  if (download->child_watch != 0) {
+    g_source_remove(download->child_watch);
+    g_spawn_close_pid(download->pid);
+  }
+
+  if (download->retry != 0) {
+    g_source_remove(download->retry);
+  }
+
   if (download->jumanji != NULL && download->widget.main != NULL) {
     gtk_container_remove(GTK_CONTAINER(download->jumanji->downloads.widget), download->widget.main);
   }
 
-  free(download->file);
+  g_free(download->file);
+  g_free(download->uri);
+  g_free(download->referer);
+  g_free(download->validator);
+  g_free(download->error);
   free(download);
 }
 
-#if 0
 void
-cb_jumanji_download_status(WebKitDownload* download, GParamSpec* pspec, jumanji_download_t* jumanji_download)
+cb_jumanji_download_started(WebKitWebContext* context, WebKitDownload* download, jumanji_t* jumanji)
 {
-  if (download == NULL || jumanji_download == NULL) {
+  if (download == NULL || jumanji == NULL) {
     return;
   }
 
-  jumanji_download_set_status(jumanji_download);
-}
+  /* the queue only has the cookies and the proxy of the default context */
+  g_object_set_data(G_OBJECT(download), "jumanji-queue",
+      GINT_TO_POINTER(context == jumanji->global.web_context));
 
-void
-cb_jumanji_download_progress(WebKitDownload* download, GParamSpec* pspec, jumanji_download_t* jumanji_download)
-{
-  if (download == NULL || jumanji_download == NULL) {
-    return;
-  }
-
-  jumanji_download_set_status(jumanji_download);
+  g_signal_connect(G_OBJECT(download), "decide-destination",
+      G_CALLBACK(cb_jumanji_download_decide_destination), jumanji);
 }
 
 bool
@@ -219,46 +400,843 @@ jumanji_download_create_widget(jumanji_t* jumanji, jumanji_download_t* download)
 void
 jumanji_download_set_status(jumanji_download_t* download)
 {
-  if (download == NULL || download->download == NULL) {
+  if (download == NULL || download->widget.main == NULL) {
     return;
   }
 
-  /* download progress */
-  double progress    = webkit_download_get_progress(download->download);
-  int percent        = (int) (progress * 100.0);
-  char* percent_text = g_strdup_printf("%d%%", percent);
-
-  /* download status */
-  char* status = NULL;
-  switch (webkit_download_get_status(download->download)) {
-    case WEBKIT_DOWNLOAD_STATUS_STARTED:
-      download->size = webkit_download_get_total_size(download->download);
+  const char* status = NULL;
+  switch (download->state) {
+    case JUMANJI_DOWNLOAD_QUEUED:
+      status = "Queued";
       break;
-    case WEBKIT_DOWNLOAD_STATUS_CANCELLED:
-      status = "Cancelled";
+    case JUMANJI_DOWNLOAD_RUNNING:
+      status = "Running";
       break;
-    case WEBKIT_DOWNLOAD_STATUS_FINISHED:
+    case JUMANJI_DOWNLOAD_FINISHED:
       status = "Finished";
       break;
-    case WEBKIT_DOWNLOAD_STATUS_ERROR:
-      status = "Error";
+    case JUMANJI_DOWNLOAD_FAILED:
+      status = "Failed";
       break;
-    default:
+    case JUMANJI_DOWNLOAD_CANCELLED:
+      status = "Cancelled";
       break;
   }
 
-  if (status != NULL && download->jumanji != NULL && download->jumanji->ui.session != NULL) {
-    girara_notify(download->jumanji->ui.session, GIRARA_INFO, "%s download: %s",
-        status, download->file);
-  }
+  char* text = NULL;
+  if (download->state == JUMANJI_DOWNLOAD_RUNNING && download->external == false) {
+    guint64 received  = download->offset + download->received;
+    double throughput = jumanji_download_throughput(download);
+    char* size_text   = g_format_size(received);
+    char* speed_text  = g_format_size((guint64) throughput);
+    char* progress    = NULL;
 
-  /* update entry */
-  char* text = g_strdup_printf("%s - %s", (status != NULL) ? status : percent_text, download->uri);
+    if (download->size > 0 && received <= download->size) {
+      int percent = (int) (received * 100 / download->size);
+      if (throughput > 0.0) {
+        guint64 eta = (guint64) ((download->size - received) / throughput);
+        progress = g_strdup_printf("%d%% (%s, %s/s, %" G_GUINT64_FORMAT ":%02u:%02u left)",
+            percent, size_text, speed_text, eta / 3600,
+            (unsigned int) (eta / 60 % 60), (unsigned int) (eta % 60));
+      } else {
+        progress = g_strdup_printf("%d%% (%s)", percent, size_text);
+      }
+    } else {
+      progress = g_strdup_printf("%s (%s/s)", size_text, speed_text);
+    }
 
-  gtk_label_set_text(GTK_LABEL(download->widget.filename), download->file);
-  gtk_label_set_text(GTK_LABEL(download->widget.status),   text);
+    text = g_strdup_printf("%s - %s", progress, download->uri);
+
+    g_free(progress);
+    g_free(speed_text);
+    g_free(size_text);
+  } else if ((download->state == JUMANJI_DOWNLOAD_FAILED ||
+        download->state == JUMANJI_DOWNLOAD_QUEUED) && download->error != NULL) {
+    text = g_strdup_printf("%s: %s - %s", status, download->error, download->uri);
+  } else {
+    text = g_strdup_printf("%s - %s", status, download->uri);
+  }
+
+  gtk_label_set_text(GTK_LABEL(download->widget.filename),
+      (download->file != NULL) ? download->file : download->uri);
+  gtk_label_set_text(GTK_LABEL(download->widget.status), text);
 
   g_free(text);
-  g_free(percent_text);
 }
-#endif
+
+static jumanji_download_t*
+jumanji_download_new(jumanji_t* jumanji, const char* uri, char* file, const char* referer)
+{
+  jumanji_download_t* download = calloc(1, sizeof(jumanji_download_t));
+  if (download == NULL) {
+    g_free(file);
+    return NULL;
+  }
+
+  download->uri     = g_strdup(uri);
+  download->file    = file;
+  download->referer = g_strdup(referer);
+  download->state   = JUMANJI_DOWNLOAD_QUEUED;
+  download->jumanji = jumanji;
+
+  if (jumanji_download_create_widget(jumanji, download) == false) {
+    jumanji_download_free(download);
+    return NULL;
+  }
+
+  jumanji_download_set_status(download);
+
+  girara_list_append(jumanji->downloads.list, download);
+
+  return download;
+}
+
+static char*
+jumanji_download_destination(jumanji_t* jumanji, const char* uri, const char* suggested_filename)
+{
+  /* get download dir */
+  char* download_dir_tmp = NULL;
+  girara_setting_get(jumanji->ui.session, "download-dir", &download_dir_tmp);
+  if (download_dir_tmp == NULL) {
+    return NULL;
+  }
+
+  char* download_dir = girara_fix_path(download_dir_tmp);
+  g_free(download_dir_tmp);
+
+  if (download_dir == NULL) {
+    return NULL;
+  }
+
+  g_mkdir_with_parents(download_dir, 0700);
+
+  /* build filename */
+  char* name = NULL;
+  if (suggested_filename != NULL && suggested_filename[0] != '\0') {
+    name = g_path_get_basename(suggested_filename);
+  } else {
+    SoupURI* soup_uri = soup_uri_new(uri);
+    if (soup_uri != NULL && soup_uri->path != NULL) {
+      char* path = soup_uri_decode(soup_uri->path);
+      name = g_path_get_basename(path);
+      g_free(path);
+    }
+    if (soup_uri != NULL) {
+      soup_uri_free(soup_uri);
+    }
+  }
+
+  if (name == NULL || strcmp(name, "/") == 0 || strcmp(name, ".") == 0 ||
+      strcmp(name, "..") == 0) {
+    g_free(name);
+    name = g_strdup("download");
+  }
+
+  /* never overwrite existing files, part files or queued downloads */
+  char* filename = g_build_filename(download_dir, name, NULL);
+  for (unsigned int i = 1; ; i++) {
+    char* part_file = g_strconcat(filename, JUMANJI_DOWNLOAD_PART_SUFFIX, NULL);
+    bool exists = g_file_test(filename, G_FILE_TEST_EXISTS) == TRUE ||
+      g_file_test(part_file, G_FILE_TEST_EXISTS) == TRUE;
+    g_free(part_file);
+
+    if (exists == false && girara_list_size(jumanji->downloads.list) > 0) {
+      girara_list_iterator_t* iter = girara_list_iterator(jumanji->downloads.list);
+      do {
+        jumanji_download_t* download = (jumanji_download_t*) girara_list_iterator_data(iter);
+        if (g_strcmp0(download->file, filename) == 0) {
+          exists = true;
+          break;
+        }
+      } while (girara_list_iterator_next(iter) != NULL);
+      girara_list_iterator_free(iter);
+    }
+
+    if (exists == false) {
+      break;
+    }
+
+    g_free(filename);
+    char* numbered_name = g_strdup_printf("%s.%u", name, i);
+    filename = g_build_filename(download_dir, numbered_name, NULL);
+    g_free(numbered_name);
+  }
+
+  g_free(name);
+  g_free(download_dir);
+
+  return filename;
+}
+
+static char*
+jumanji_download_part_file(jumanji_download_t* download)
+{
+  return g_strconcat(download->file, JUMANJI_DOWNLOAD_PART_SUFFIX, NULL);
+}
+
+static void
+jumanji_download_schedule(jumanji_t* jumanji)
+{
+  if (jumanji->downloads.list == NULL || girara_list_size(jumanji->downloads.list) == 0) {
+    return;
+  }
+
+  int limit = 0;
+  girara_setting_get(jumanji->ui.session, "download-limit", &limit);
+  if (limit < 1) {
+    limit = 1;
+  }
+
+  girara_list_iterator_t* iter = girara_list_iterator(jumanji->downloads.list);
+  do {
+    if (jumanji->downloads.running >= (unsigned int) limit) {
+      break;
+    }
+
+    jumanji_download_t* download = (jumanji_download_t*) girara_list_iterator_data(iter);
+    if (download->state == JUMANJI_DOWNLOAD_QUEUED && download->retry == 0) {
+      jumanji_download_start(download);
+    }
+  } while (girara_list_iterator_next(iter) != NULL);
+  girara_list_iterator_free(iter);
+}
+
+static void
+jumanji_download_start(jumanji_download_t* download)
+{
+  jumanji_t* jumanji = download->jumanji;
+
+  download->state = JUMANJI_DOWNLOAD_RUNNING;
+  jumanji->downloads.running++;
+
+  /* hand the download over to the download command */
+  char* command = NULL;
+  girara_setting_get(jumanji->ui.session, "download-command", &command);
+  download->external = (command != NULL && command[0] != '\0');
+
+  if (download->external == true) {
+    jumanji_download_spawn(download, command);
+    g_free(command);
+    return;
+  }
+
+  g_free(command);
+
+  /* continue after the data that is already on disk, as long as the server
+   * can tell if the file changed in the meantime */
+  char* part_file = jumanji_download_part_file(download);
+  GStatBuf buffer;
+  download->offset        = (download->validator != NULL && g_stat(part_file, &buffer) == 0) ?
+    (guint64) buffer.st_size : 0;
+  download->received      = 0;
+  download->size          = 0;
+  download->samples.count = 0;
+  g_free(part_file);
+
+  jumanji_download_progress_start(jumanji);
+
+  /* the request carries the cookies of the browser */
+  download->cancellable = g_cancellable_new();
+
+  WebKitCookieManager* cookie_manager =
+    webkit_web_context_get_cookie_manager(jumanji->global.web_context);
+  webkit_cookie_manager_get_cookies(cookie_manager, download->uri,
+      download->cancellable, cb_jumanji_download_cookies, download);
+
+  jumanji_download_set_status(download);
+}
+
+static void
+jumanji_download_done(jumanji_download_t* download, GError* error)
+{
+  jumanji_t* jumanji = download->jumanji;
+
+  if (download->message != NULL) {
+    g_object_unref(download->message);
+    download->message = NULL;
+  }
+
+  if (download->input != NULL) {
+    g_object_unref(download->input);
+    download->input = NULL;
+  }
+
+  if (download->output != NULL) {
+    if (g_output_stream_close(download->output, NULL, NULL) == FALSE && error == NULL) {
+      error = g_error_new(G_IO_ERROR, G_IO_ERROR_FAILED, "Could not write %s", download->file);
+    }
+    g_object_unref(download->output);
+    download->output = NULL;
+  }
+
+  if (download->buffer != NULL) {
+    g_bytes_unref(download->buffer);
+    download->buffer = NULL;
+  }
+
+  if (download->cancellable != NULL) {
+    g_object_unref(download->cancellable);
+    download->cancellable = NULL;
+  }
+
+  if (jumanji->downloads.running > 0) {
+    jumanji->downloads.running--;
+  }
+
+  /* move the complete part file to its destination */
+  if (error == NULL && download->download == NULL && download->external == false) {
+    char* part_file = jumanji_download_part_file(download);
+    if (g_rename(part_file, download->file) != 0) {
+      error = g_error_new(G_FILE_ERROR, g_file_error_from_errno(errno),
+          "Could not rename %s: %s", part_file, g_strerror(errno));
+    }
+    g_free(part_file);
+  }
+
+  if (error == NULL) {
+    download->state = JUMANJI_DOWNLOAD_FINISHED;
+    girara_notify(jumanji->ui.session, GIRARA_INFO, "Finished download: %s", download->file);
+  } else if (download->download == NULL && download->external == false &&
+      ++download->attempts < JUMANJI_DOWNLOAD_ATTEMPTS) {
+    /* retry later, the part file keeps what has been received so far */
+    unsigned int delay = JUMANJI_DOWNLOAD_RETRY_DELAY << (download->attempts - 1);
+    download->state    = JUMANJI_DOWNLOAD_QUEUED;
+    download->retry    = g_timeout_add_seconds(delay, cb_jumanji_download_retry, download);
+    girara_warning("Download of %s interrupted, retrying in %u seconds: %s",
+        download->uri, delay, error->message);
+  } else {
+    download->state = JUMANJI_DOWNLOAD_FAILED;
+    girara_notify(jumanji->ui.session, GIRARA_ERROR, "Failed download: %s (%s)",
+        download->file, error->message);
+  }
+
+  g_free(download->error);
+  download->error = NULL;
+
+  if (error != NULL) {
+    download->error = g_strdup(error->message);
+    g_error_free(error);
+  }
+
+  jumanji_download_set_status(download);
+  jumanji_downloads_save(jumanji);
+  jumanji_download_schedule(jumanji);
+}
+
+static gboolean
+cb_jumanji_download_retry(gpointer data)
+{
+  jumanji_download_t* download = (jumanji_download_t*) data;
+
+  download->retry = 0;
+  jumanji_download_schedule(download->jumanji);
+
+  return FALSE;
+}
+
+static char**
+jumanji_download_command_argv(const char* command, const char* uri, const char* file,
+    GError** error)
+{
+  gint argc    = 0;
+  gchar** argv = NULL;
+
+  if (g_shell_parse_argv(command, &argc, &argv, error) == FALSE) {
+    return NULL;
+  }
+
+  /* the arguments are substituted after splitting, so the uri and the file
+   * name are never interpreted by a shell */
+  const char* values[] = { uri, file };
+  unsigned int used    = 0;
+
+  for (gint i = 0; i < argc; i++) {
+    if (strstr(argv[i], "%s") == NULL) {
+      continue;
+    }
+
+    GString* argument  = g_string_new(NULL);
+    const char* start  = argv[i];
+    const char* format = NULL;
+
+    while ((format = strstr(start, "%s")) != NULL) {
+      g_string_append_len(argument, start, format - start);
+      if (used < G_N_ELEMENTS(values)) {
+        g_string_append(argument, values[used]);
+      }
+      used++;
+      start = format + 2;
+    }
+    g_string_append(argument, start);
+
+    g_free(argv[i]);
+    argv[i] = g_string_free(argument, FALSE);
+  }
+
+  if (used == 0) {
+    g_set_error(error, G_SHELL_ERROR, G_SHELL_ERROR_FAILED,
+        "Invalid download command: %s", command);
+    g_strfreev(argv);
+    return NULL;
+  }
+
+  return argv;
+}
+
+static void
+jumanji_download_spawn(jumanji_download_t* download, const char* command)
+{
+  GError* error = NULL;
+  char** argv   = jumanji_download_command_argv(command, download->uri, download->file, &error);
+  if (argv == NULL) {
+    jumanji_download_done(download, error);
+    return;
+  }
+
+  GPid pid = 0;
+  if (g_spawn_async(NULL, argv, NULL, G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
+        NULL, NULL, &pid, &error) == FALSE) {
+    g_strfreev(argv);
+    jumanji_download_done(download, error);
+    return;
+  }
+
+  g_strfreev(argv);
+
+  download->pid         = pid;
+  download->child_watch = g_child_watch_add(pid, cb_jumanji_download_child_exited, download);
+
+  jumanji_download_set_status(download);
+}
+
+static void
+cb_jumanji_download_child_exited(GPid pid, gint status, gpointer data)
+{
+  jumanji_download_t* download = (jumanji_download_t*) data;
+
+  g_spawn_close_pid(pid);
+  download->pid         = 0;
+  download->child_watch = 0;
+
+  if (download->state == JUMANJI_DOWNLOAD_CANCELLED) {
+    return;
+  }
+
+  GError* error = NULL;
+  g_spawn_check_exit_status(status, &error);
+
+  jumanji_download_done(download, error);
+}
+
+static void
+cb_jumanji_download_cookies(GObject* source, GAsyncResult* result, gpointer data)
+{
+  GError* error  = NULL;
+  GList* cookies = webkit_cookie_manager_get_cookies_finish(WEBKIT_COOKIE_MANAGER(source), result, &error);
+
+  if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) == TRUE) {
+    g_error_free(error);
+    return;
+  }
+
+  /* try without cookies */
+  if (error != NULL) {
+    g_error_free(error);
+    error = NULL;
+  }
+
+  jumanji_download_t* download = (jumanji_download_t*) data;
+  jumanji_t* jumanji           = download->jumanji;
+
+  SoupMessage* message = soup_message_new(SOUP_METHOD_GET, download->uri);
+  if (message == NULL) {
+    g_list_free_full(cookies, (GDestroyNotify) soup_cookie_free);
+    jumanji_download_done(download, g_error_new(G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+          "Invalid uri"));
+    return;
+  }
+
+  if (cookies != NULL) {
+    GString* header = g_string_new(NULL);
+    for (GList* cookie = cookies; cookie != NULL; cookie = g_list_next(cookie)) {
+      char* value = soup_cookie_to_cookie_header((SoupCookie*) cookie->data);
+      g_string_append_printf(header, "%s%s", (header->len > 0) ? "; " : "", value);
+      g_free(value);
+    }
+    soup_message_headers_replace(message->request_headers, "Cookie", header->str);
+    g_string_free(header, TRUE);
+    g_list_free_full(cookies, (GDestroyNotify) soup_cookie_free);
+  }
+
+  if (download->referer != NULL) {
+    soup_message_headers_replace(message->request_headers, "Referer", download->referer);
+  }
+
+  const char* user_agent = webkit_settings_get_user_agent(jumanji->global.browser_settings);
+  if (user_agent != NULL) {
+    soup_message_headers_replace(message->request_headers, "User-Agent", user_agent);
+  }
+
+  /* a changed file is sent as a whole instead of the range */
+  if (download->offset > 0) {
+    soup_message_headers_set_range(message->request_headers, download->offset, -1);
+    soup_message_headers_replace(message->request_headers, "If-Range", download->validator);
+  }
+
+  download->message = message;
+  soup_session_send_async(jumanji->downloads.session, message,
+      download->cancellable, cb_jumanji_download_sent, download);
+}
+
+static void
+cb_jumanji_download_sent(GObject* source, GAsyncResult* result, gpointer data)
+{
+  GError* error       = NULL;
+  GInputStream* input = soup_session_send_finish(SOUP_SESSION(source), result, &error);
+
+  if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) == TRUE) {
+    g_error_free(error);
+    return;
+  }
+
+  jumanji_download_t* download = (jumanji_download_t*) data;
+
+  if (input == NULL) {
+    jumanji_download_done(download, error);
+    return;
+  }
+
+  guint status                = download->message->status_code;
+  SoupMessageHeaders* headers = download->message->response_headers;
+  char* part_file             = jumanji_download_part_file(download);
+  GFile* file                 = g_file_new_for_path(part_file);
+  GFileOutputStream* output   = NULL;
+  g_free(part_file);
+
+  goffset start = 0;
+  goffset end   = 0;
+  goffset total = 0;
+
+  if (status == SOUP_STATUS_PARTIAL_CONTENT && download->offset > 0) {
+    /* the data has to continue exactly where the part file ends */
+    if (soup_message_headers_get_content_range(headers, &start, &end, &total) == FALSE ||
+        start != (goffset) download->offset) {
+      g_object_unref(file);
+      g_object_unref(input);
+      jumanji_download_restart(download);
+      return;
+    }
+    output = g_file_append_to(file, G_FILE_CREATE_NONE, NULL, &error);
+  } else if (status == SOUP_STATUS_REQUESTED_RANGE_NOT_SATISFIABLE && download->offset > 0) {
+    /* the part file already holds the whole file */
+    g_object_unref(file);
+    g_object_unref(input);
+    jumanji_download_done(download, NULL);
+    return;
+  } else if (SOUP_STATUS_IS_SUCCESSFUL(status) == TRUE) {
+    /* the file changed or the server ignored the range, start over */
+    download->offset = 0;
+    g_free(download->validator);
+    download->validator = jumanji_download_validator(headers);
+    output = g_file_replace(file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, &error);
+  } else {
+    error = g_error_new(G_IO_ERROR, G_IO_ERROR_FAILED, "%u %s", status,
+        download->message->reason_phrase);
+  }
+
+  g_object_unref(file);
+
+  if (output == NULL) {
+    g_object_unref(input);
+    jumanji_download_done(download, error);
+    return;
+  }
+
+  goffset length = soup_message_headers_get_content_length(headers);
+  if (total > 0) {
+    download->size = total;
+  } else {
+    download->size = (length > 0) ? download->offset + length : 0;
+  }
+
+  download->input  = input;
+  download->output = G_OUTPUT_STREAM(output);
+
+  jumanji_download_set_status(download);
+  jumanji_download_read(download);
+}
+
+static void
+jumanji_download_read(jumanji_download_t* download)
+{
+  g_input_stream_read_bytes_async(download->input, JUMANJI_DOWNLOAD_BUFFER_SIZE,
+      G_PRIORITY_DEFAULT, download->cancellable, cb_jumanji_download_read, download);
+}
+
+static void
+cb_jumanji_download_read(GObject* source, GAsyncResult* result, gpointer data)
+{
+  GError* error = NULL;
+  GBytes* bytes = g_input_stream_read_bytes_finish(G_INPUT_STREAM(source), result, &error);
+
+  if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) == TRUE) {
+    g_error_free(error);
+    return;
+  }
+
+  jumanji_download_t* download = (jumanji_download_t*) data;
+
+  if (bytes == NULL) {
+    jumanji_download_done(download, error);
+    return;
+  }
+
+  /* end of the body */
+  if (g_bytes_get_size(bytes) == 0) {
+    g_bytes_unref(bytes);
+
+    if (download->size > 0 && download->offset + download->received < download->size) {
+      error = g_error_new(G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+          "Connection closed after %" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT " bytes",
+          download->offset + download->received, download->size);
+    }
+
+    jumanji_download_done(download, error);
+    return;
+  }
+
+  gsize size        = 0;
+  const void* chunk = g_bytes_get_data(bytes, &size);
+
+  download->buffer = bytes;
+  g_output_stream_write_all_async(download->output, chunk, size, G_PRIORITY_DEFAULT,
+      download->cancellable, cb_jumanji_download_written, download);
+}
+
+static char*
+jumanji_download_validator(SoupMessageHeaders* headers)
+{
+  /* weak etags must not be used in If-Range */
+  const char* etag = soup_message_headers_get_one(headers, "ETag");
+  if (etag != NULL && g_str_has_prefix(etag, "W/") == FALSE) {
+    return g_strdup(etag);
+  }
+
+  return g_strdup(soup_message_headers_get_one(headers, "Last-Modified"));
+}
+
+static void
+jumanji_download_restart(jumanji_download_t* download)
+{
+  girara_warning("Download of %s can not be resumed, starting over", download->uri);
+
+  g_object_unref(download->message);
+  download->message = NULL;
+
+  char* part_file = jumanji_download_part_file(download);
+  g_unlink(part_file);
+  g_free(part_file);
+
+  g_free(download->validator);
+  download->validator = NULL;
+  download->offset    = 0;
+
+  WebKitCookieManager* cookie_manager =
+    webkit_web_context_get_cookie_manager(download->jumanji->global.web_context);
+  webkit_cookie_manager_get_cookies(cookie_manager, download->uri,
+      download->cancellable, cb_jumanji_download_cookies, download);
+}
+
+static void
+cb_jumanji_download_written(GObject* source, GAsyncResult* result, gpointer data)
+{
+  GError* error    = NULL;
+  gsize written    = 0;
+  gboolean success = g_output_stream_write_all_finish(G_OUTPUT_STREAM(source),
+      result, &written, &error);
+
+  if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) == TRUE) {
+    g_error_free(error);
+    return;
+  }
+
+  jumanji_download_t* download = (jumanji_download_t*) data;
+
+  g_bytes_unref(download->buffer);
+  download->buffer = NULL;
+
+  /* only count the data, the widget is redrawn by the progress timer */
+  download->received += written;
+
+  if (success == FALSE) {
+    jumanji_download_done(download, error);
+    return;
+  }
+
+  jumanji_download_read(download);
+}
+
+static void
+jumanji_download_sample(jumanji_download_t* download, gint64 time)
+{
+  unsigned int position = 0;
+  if (download->samples.count < JUMANJI_DOWNLOAD_SAMPLES) {
+    position = (download->samples.first + download->samples.count++) % JUMANJI_DOWNLOAD_SAMPLES;
+  } else {
+    /* overwrite the oldest sample */
+    position = download->samples.first;
+    download->samples.first = (download->samples.first + 1) % JUMANJI_DOWNLOAD_SAMPLES;
+  }
+
+  download->samples.time[position]     = time;
+  download->samples.received[position] = download->received;
+}
+
+static double
+jumanji_download_throughput(jumanji_download_t* download)
+{
+  if (download->samples.count < 2) {
+    return 0.0;
+  }
+
+  unsigned int first = download->samples.first;
+  unsigned int last  = (first + download->samples.count - 1) % JUMANJI_DOWNLOAD_SAMPLES;
+  gint64 duration    = download->samples.time[last] - download->samples.time[first];
+
+  if (duration <= 0) {
+    return 0.0;
+  }
+
+  guint64 received = download->samples.received[last] - download->samples.received[first];
+
+  return (double) received * G_USEC_PER_SEC / duration;
+}
+
+static void
+jumanji_download_progress_start(jumanji_t* jumanji)
+{
+  if (jumanji->downloads.progress_source != 0) {
+    return;
+  }
+
+  jumanji->downloads.progress_source = g_timeout_add(JUMANJI_DOWNLOAD_UPDATE_INTERVAL,
+      cb_jumanji_download_progress, jumanji);
+}
+
+static gboolean
+cb_jumanji_download_progress(gpointer data)
+{
+  jumanji_t* jumanji = (jumanji_t*) data;
+
+  if (jumanji->downloads.running == 0 || girara_list_size(jumanji->downloads.list) == 0) {
+    jumanji->downloads.progress_source = 0;
+    return FALSE;
+  }
+
+  gint64 now = g_get_monotonic_time();
+
+  girara_list_iterator_t* iter = girara_list_iterator(jumanji->downloads.list);
+  do {
+    jumanji_download_t* download = (jumanji_download_t*) girara_list_iterator_data(iter);
+    if (download->state != JUMANJI_DOWNLOAD_RUNNING || download->external == true) {
+      continue;
+    }
+
+    if (download->download != NULL) {
+      download->received = webkit_download_get_received_data_length(download->download);
+
+      WebKitURIResponse* response = webkit_download_get_response(download->download);
+      if (response != NULL) {
+        download->size = webkit_uri_response_get_content_length(response);
+      }
+    }
+
+    jumanji_download_sample(download, now);
+    jumanji_download_set_status(download);
+  } while (girara_list_iterator_next(iter) != NULL);
+  girara_list_iterator_free(iter);
+
+  return TRUE;
+}
+
+static bool
+cb_jumanji_download_decide_destination(WebKitDownload* webkit_download,
+    gchar* suggested_filename, jumanji_t* jumanji)
+{
+  WebKitURIRequest* request   = webkit_download_get_request(webkit_download);
+  const char* uri             = webkit_uri_request_get_uri(request);
+  const char* method          = webkit_uri_request_get_http_method(request);
+  SoupMessageHeaders* headers = webkit_uri_request_get_http_headers(request);
+  const char* referer         = (headers != NULL) ?
+    soup_message_headers_get_one(headers, "Referer") : NULL;
+
+  char* file = jumanji_download_destination(jumanji, uri, suggested_filename);
+  if (file == NULL) {
+    return false;
+  }
+
+  /* plain http requests of the default context are repeated by the queue,
+   * which can resume them */
+  bool queue = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(webkit_download), "jumanji-queue")) != 0;
+  if (queue == true && (method == NULL || g_strcmp0(method, SOUP_METHOD_GET) == 0) &&
+      (g_str_has_prefix(uri, "http://") == TRUE || g_str_has_prefix(uri, "https://") == TRUE)) {
+    char* download_uri     = g_strdup(uri);
+    char* download_referer = g_strdup(referer);
+
+    g_signal_handlers_disconnect_by_data(webkit_download, jumanji);
+    webkit_download_cancel(webkit_download);
+
+    jumanji_download_add(jumanji, download_uri, file, download_referer);
+
+    g_free(download_uri);
+    g_free(download_referer);
+    g_free(file);
+
+    return true;
+  }
+
+  /* everything else is left to webkit */
+  jumanji_download_t* download = jumanji_download_new(jumanji, uri, file, referer);
+  if (download == NULL) {
+    return false;
+  }
+
+  download->download = g_object_ref(webkit_download);
+  download->state    = JUMANJI_DOWNLOAD_RUNNING;
+  jumanji->downloads.running++;
+
+  jumanji_download_progress_start(jumanji);
+
+  char* file_uri = g_filename_to_uri(download->file, NULL, NULL);
+  webkit_download_set_destination(webkit_download, file_uri);
+  g_free(file_uri);
+
+  g_signal_connect(G_OBJECT(webkit_download), "failed",
+      G_CALLBACK(cb_jumanji_download_webkit_failed), download);
+  g_signal_connect(G_OBJECT(webkit_download), "finished",
+      G_CALLBACK(cb_jumanji_download_webkit_finished), download);
+
+  jumanji_download_set_status(download);
+  girara_notify(jumanji->ui.session, GIRARA_INFO, "Started download: %s", download->file);
+
+  return true;
+}
+
+static void
+cb_jumanji_download_webkit_failed(WebKitDownload* webkit_download, GError* error,
+    jumanji_download_t* download)
+{
+  /* finished is emitted after failed */
+  g_signal_handlers_disconnect_by_data(webkit_download, download);
+
+  jumanji_download_done(download, g_error_copy(error));
+}
+
+static void
+cb_jumanji_download_webkit_finished(WebKitDownload* webkit_download,
+    jumanji_download_t* download)
+{
+  g_signal_handlers_disconnect_by_data(webkit_download, download);
+
+  jumanji_download_done(download, NULL);
+}
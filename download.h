@@ -7,14 +7,55 @@
 
 #include "jumanji.h"
 
+#define JUMANJI_DOWNLOAD_QUEUE_FILE "downloads"
+#define JUMANJI_DOWNLOAD_PART_SUFFIX ".part"
+#define JUMANJI_DOWNLOAD_ATTEMPTS 3
+#define JUMANJI_DOWNLOAD_RETRY_DELAY 2 /* seconds, doubled after every attempt */
+#define JUMANJI_DOWNLOAD_BUFFER_SIZE 65536
+#define JUMANJI_DOWNLOAD_UPDATE_INTERVAL 250 /* 4 Hz */
+#define JUMANJI_DOWNLOAD_SAMPLES 20 /* 5 seconds */
+
+typedef enum jumanji_download_state_e
+{
+  JUMANJI_DOWNLOAD_QUEUED, /**> Waiting for a free slot */
+  JUMANJI_DOWNLOAD_RUNNING, /**> Transferring data */
+  JUMANJI_DOWNLOAD_FINISHED, /**> Completed */
+  JUMANJI_DOWNLOAD_FAILED, /**> Failed after all attempts */
+  JUMANJI_DOWNLOAD_CANCELLED /**> Cancelled */
+} jumanji_download_state_t;
+
 typedef struct jumanji_download_s
 {
-  char* file; /**> File name */
-  const char* uri; /**> Download uri */
-  int64_t size; /**> Size of the downloaded file */
-  WebKitDownload* download; /**> Webkit download object */
+  char* file; /**> Path of the downloaded file, NULL until it is known */
+  char* uri; /**> Download uri */
+  char* referer; /**> Referer of the request (optional) */
+  jumanji_download_state_t state; /**> State of the download */
+  unsigned int attempts; /**> Number of failed attempts */
+  guint retry; /**> Queues the download again after a failed attempt */
+  char* error; /**> Reason of the last failure */
+  bool external; /**> True if the download is run by the download-command */
+  GPid pid; /**> Process of the download-command */
+  guint child_watch; /**> Watches the exit of the process */
+  guint64 offset; /**> Bytes that were already in the part file */
+  char* validator; /**> ETag or Last-Modified of the part file, sent as If-Range */
+  guint64 received; /**> Bytes received by the running request */
+  guint64 size; /**> Expected size of the file, 0 if unknown */
+  WebKitDownload* download; /**> Webkit download object for requests that can not be resumed */
+  SoupMessage* message; /**> Running request */
+  GInputStream* input; /**> Body of the running request */
+  GOutputStream* output; /**> Part file that is written */
+  GBytes* buffer; /**> Data that is being written */
+  GCancellable* cancellable; /**> Cancels the running request */
   jumanji_t* jumanji; /**> Jumanji session */
 
+  struct
+  {
+    gint64 time[JUMANJI_DOWNLOAD_SAMPLES]; /**> Monotonic time of the samples */
+    guint64 received[JUMANJI_DOWNLOAD_SAMPLES]; /**> Received bytes at the samples */
+    unsigned int first; /**> Index of the oldest sample */
+    unsigned int count; /**> Number of samples */
+  } samples;
+
   struct
   {
     GtkWidget* main; /**> Webkit widget */
@@ -24,38 +65,70 @@ typedef struct jumanji_download_s
 } jumanji_download_t;
 
 /**
- * Download a file
+ * Initializes the download manager and restarts the downloads that were
+ * queued or running when jumanji was closed
  *
- * @param jumanji Jumanji session
- * @param download Webkit download object
- * @return true if no error occured processing
+ * @param jumanji The jumanji session
+ * @return true if no error occured
  */
-bool jumanji_download_file(jumanji_t* jumanji, WebKitDownload* download);
+bool jumanji_downloads_init(jumanji_t* jumanji);
 
 /**
- * Frees a jumanji download object
+ * Stores the unfinished downloads and frees the download manager
  *
- * @param data Jumani download object
+ * @param jumanji The jumanji session
  */
-void jumanji_download_free(void* data);
+void jumanji_downloads_free(jumanji_t* jumanji);
 
 /**
- * Callback for the status of the download
+ * Stores the queued and running downloads so that they are resumed on the
+ * next start
  *
- * @param download Webkit download object
- * @param pspec -
- * @param jumanji_download Jumanji download object
+ * @param jumanji The jumanji session
+ * @return true if no error occured
+ */
+bool jumanji_downloads_save(jumanji_t* jumanji);
+
+/**
+ * Adds a download to the queue. It is started as soon as less than
+ * download-limit downloads are running. If download-command is set, the
+ * download is run by that command instead. Its first %s is replaced by the
+ * uri and the second one by the path of the file.
+ *
+ * @param jumanji The jumanji session
+ * @param uri The uri that is downloaded
+ * @param file Path of the downloaded file or NULL to derive it from the uri
+ * @param referer Referer of the request or NULL
+ * @return The download or NULL if an error occured
+ */
+jumanji_download_t* jumanji_download_add(jumanji_t* jumanji, const char* uri,
+    const char* file, const char* referer);
+
+/**
+ * Cancels a queued or running download and removes its part file
+ *
+ * @param download The jumanji download
+ * @return false if the download is neither queued nor running
  */
-void cb_jumanji_download_status(WebKitDownload* download, GParamSpec* pspec, jumanji_download_t* jumanji_download);
+bool jumanji_download_cancel(jumanji_download_t* download);
 
 /**
- * Callback for the progress of the download
+ * Frees a jumanji download object
+ *
+ * @param data Jumani download object
+ */
+void jumanji_download_free(void* data);
+
+/**
+ * Called when webkit starts a download. Downloads of GET requests of the
+ * default context are handed over to the queue, others, e.g. those of tabs
+ * with a proxy of their own, are tracked as they are.
  *
+ * @param context The web context
  * @param download Webkit download object
- * @param pspec -
- * @param jumanji_download Jumanji download object
+ * @param jumanji The jumanji session
  */
-void cb_jumanji_download_progress(WebKitDownload* download, GParamSpec* pspec, jumanji_download_t* jumanji_download);
+void cb_jumanji_download_started(WebKitWebContext* context, WebKitDownload* download, jumanji_t* jumanji);
 
 /**
  * Creates the widget that will be displayed for the jumanji download
@@ -67,7 +140,9 @@ void cb_jumanji_download_progress(WebKitDownload* download, GParamSpec* pspec, j
 bool jumanji_download_create_widget(jumanji_t* jumanji, jumanji_download_t* download);
 
 /**
- * Updates the status of a download
+ * Updates the status of a download. The progress of running downloads is
+ * redrawn every JUMANJI_DOWNLOAD_UPDATE_INTERVAL milliseconds, not for
+ * every received chunk.
  *
  * @param download The jumanji download
  */
@@ -0,0 +1,491 @@
+/* See LICENSE file for license and copyright information */
+
+#include <webkit2/webkit-web-extension.h>
+#include <string.h>
+
+#include "extension.h"
+
+/* the hint code runs in its own script world, so it neither sees nor changes
+ * the scripts of the page; it is split into chunks that are evaluated in
+ * order */
+static const char* hints_script[] = {
+  "var jumanji = {\n"
+  "  elements: [], /* clickable elements by hint id, null once they are gone */\n"
+  "  rects: [], /* their bounding rects in document coordinates */\n"
+  "  hints: [], /* hint nodes by hint id */\n"
+  "  ids: null, /* maps elements to their hint ids */\n"
+  "  observer: null, /* reports elements that enter or leave the viewport */\n"
+  "  layer: null /* overlay that contains all hint nodes */\n"
+  "};\n"
+  "\n"
+  "jumanji.selector = \"a[href], area[href], button, select, textarea, \" +\n"
+  "  \"input:not([type=hidden]), [onclick], [role=button], [role=link]\";\n"
+  "\n"
+  "/* the style is only checked for elements that are in the viewport */\n"
+  "jumanji.visible = function(element, rect) {\n"
+  "  return rect.width > 0 && rect.height > 0 && rect.bottom >= 0 &&\n"
+  "    rect.right >= 0 && rect.top <= window.innerHeight &&\n"
+  "    rect.left <= window.innerWidth &&\n"
+  "    window.getComputedStyle(element).visibility != \"hidden\";\n"
+  "};\n"
+  "\n"
+  "/* the page may be scrolled before the hint is rendered, so the position is\n"
+  " * kept relative to the document instead of the viewport */\n"
+  "jumanji.add = function(element, rect, added) {\n"
+  "  var id       = this.elements.length;\n"
+  "  var position = {\n"
+  "    left: rect.left + window.scrollX, top: rect.top + window.scrollY,\n"
+  "    right: rect.right + window.scrollX, bottom: rect.bottom + window.scrollY\n"
+  "  };\n"
+  "\n"
+  "  this.elements.push(element);\n"
+  "  this.rects.push(position);\n"
+  "  this.hints.push(null);\n"
+  "  this.ids.set(element, id);\n"
+  "\n"
+  "  added.push(id, Math.round(position.left), Math.round(position.top),\n"
+  "      Math.round(rect.width), Math.round(rect.height));\n"
+  "};\n"
+  "\n"
+  "jumanji.remove = function(id, removed) {\n"
+  "  this.ids.delete(this.elements[id]);\n"
+  "  this.elements[id] = null;\n"
+  "  this.rects[id]    = null;\n"
+  "\n"
+  "  if (this.hints[id] != null) {\n"
+  "    this.layer.removeChild(this.hints[id]);\n"
+  "    this.hints[id] = null;\n"
+  "  }\n"
+  "\n"
+  "  removed.push(id);\n"
+  "};\n",
+  "/* collects all clickable elements in the viewport with one pass over their\n"
+  " * bounding rects and returns them as a flat array of ids and rects; elements\n"
+  " * entering or leaving the viewport later on are reported by changed() */\n"
+  "jumanji.show = function(css) {\n"
+  "  this.clear();\n"
+  "\n"
+  "  this.ids   = new Map();\n"
+  "  this.layer = document.createElement(\"div\");\n"
+  "  this.layer.setAttribute(\"style\", \"position: absolute !important;\" +\n"
+  "      \"left: 0 !important; top: 0 !important; z-index: 2147483647 !important;\" +\n"
+  "      \"pointer-events: none !important;\");\n"
+  "\n"
+  "  var style = document.createElement(\"style\");\n"
+  "  style.textContent = \".__jumanji_hint { \" + css + \" }\";\n"
+  "  this.layer.appendChild(style);\n"
+  "\n"
+  "  document.documentElement.appendChild(this.layer);\n"
+  "\n"
+  "  var nodes = document.querySelectorAll(this.selector);\n"
+  "  var added = [];\n"
+  "\n"
+  "  for (var i = 0; i < nodes.length; i++) {\n"
+  "    var rect = nodes[i].getBoundingClientRect();\n"
+  "    if (this.visible(nodes[i], rect) == true) {\n"
+  "      this.add(nodes[i], rect, added);\n"
+  "    }\n"
+  "  }\n"
+  "\n"
+  "  var self = this;\n"
+  "  this.observer = new IntersectionObserver(function(entries) {\n"
+  "    self.intersect(entries);\n"
+  "  });\n"
+  "\n"
+  "  for (var i = 0; i < nodes.length; i++) {\n"
+  "    this.observer.observe(nodes[i]);\n"
+  "  }\n"
+  "\n"
+  "  return added;\n"
+  "};\n"
+  "\n"
+  "/* the observer batches all changes of one frame */\n"
+  "jumanji.intersect = function(entries) {\n"
+  "  if (this.layer == null) {\n"
+  "    return;\n"
+  "  }\n"
+  "\n"
+  "  var added   = [];\n"
+  "  var removed = [];\n"
+  "\n"
+  "  for (var i = 0; i < entries.length; i++) {\n"
+  "    var element = entries[i].target;\n"
+  "    var rect    = entries[i].boundingClientRect;\n"
+  "    var id      = this.ids.get(element);\n"
+  "\n"
+  "    if (entries[i].isIntersecting == true) {\n"
+  "      if (id === undefined && this.visible(element, rect) == true) {\n"
+  "        this.add(element, rect, added);\n"
+  "      }\n"
+  "    } else if (id !== undefined) {\n"
+  "      this.remove(id, removed);\n"
+  "    }\n"
+  "  }\n"
+  "\n"
+  "  if (added.length > 0 || removed.length > 0) {\n"
+  "    this.changed(removed, added);\n"
+  "  }\n"
+  "};\n",
+  "/* renders labels given as a flat array of ids and labels; hints that exist\n"
+  " * already are relabeled */\n"
+  "jumanji.label = function(labels) {\n"
+  "  if (this.layer == null) {\n"
+  "    return;\n"
+  "  }\n"
+  "\n"
+  "  var fragment = document.createDocumentFragment();\n"
+  "\n"
+  "  for (var i = 0; i + 1 < labels.length; i += 2) {\n"
+  "    var id   = labels[i];\n"
+  "    var rect = this.rects[id];\n"
+  "    if (rect == null) {\n"
+  "      continue;\n"
+  "    }\n"
+  "\n"
+  "    var hint = this.hints[id];\n"
+  "    if (hint == null) {\n"
+  "      hint = document.createElement(\"div\");\n"
+  "      hint.className = \"__jumanji_hint\";\n"
+  "      hint.setAttribute(\"style\", \"position: absolute !important;\" +\n"
+  "          \"left: \" + Math.round(rect.right) + \"px !important;\" +\n"
+  "          \"top: \" + Math.round(rect.bottom) + \"px !important;\" +\n"
+  "          \"width: auto !important; height: auto !important;\");\n"
+  "\n"
+  "      this.hints[id] = hint;\n"
+  "      fragment.appendChild(hint);\n"
+  "    }\n"
+  "\n"
+  "    hint.textContent = labels[i + 1];\n"
+  "  }\n"
+  "\n"
+  "  this.layer.appendChild(fragment);\n"
+  "};\n"
+  "\n"
+  "/* the browser filters the labels, only the hints whose visibility changes\n"
+  " * are touched */\n"
+  "jumanji.update = function(hidden, shown) {\n"
+  "  for (var i = 0; i < hidden.length; i++) {\n"
+  "    if (this.hints[hidden[i]] != null) {\n"
+  "      this.hints[hidden[i]].style.display = \"none\";\n"
+  "    }\n"
+  "  }\n"
+  "\n"
+  "  for (var i = 0; i < shown.length; i++) {\n"
+  "    if (this.hints[shown[i]] != null) {\n"
+  "      this.hints[shown[i]].style.display = \"\";\n"
+  "    }\n"
+  "  }\n"
+  "};\n",
+  "/* focuses input elements and clicks everything else */\n"
+  "jumanji.activate = function(id, new_tab) {\n"
+  "  var element = this.elements[id];\n"
+  "  this.clear();\n"
+  "\n"
+  "  if (element == undefined || element == null) {\n"
+  "    return;\n"
+  "  }\n"
+  "\n"
+  "  var tag  = element.tagName.toLowerCase();\n"
+  "  var type = (element.getAttribute(\"type\") || \"\").toLowerCase();\n"
+  "\n"
+  "  if (tag == \"textarea\" || tag == \"select\" || element.isContentEditable ||\n"
+  "      (tag == \"input\" && [\"\", \"text\", \"search\", \"password\", \"email\", \"url\",\n"
+  "        \"tel\", \"number\"].indexOf(type) != -1)) {\n"
+  "    element.focus();\n"
+  "    return;\n"
+  "  }\n"
+  "\n"
+  "  element.dispatchEvent(new MouseEvent(\"click\", {\n"
+  "    bubbles: true, cancelable: true, view: window, button: new_tab ? 1 : 0\n"
+  "  }));\n"
+  "};\n"
+  "\n"
+  "jumanji.clear = function() {\n"
+  "  if (this.observer != null) {\n"
+  "    this.observer.disconnect();\n"
+  "  }\n"
+  "\n"
+  "  if (this.layer != null && this.layer.parentNode != null) {\n"
+  "    this.layer.parentNode.removeChild(this.layer);\n"
+  "  }\n"
+  "\n"
+  "  this.elements = [];\n"
+  "  this.rects    = [];\n"
+  "  this.hints    = [];\n"
+  "  this.ids      = null;\n"
+  "  this.observer = null;\n"
+  "  this.layer    = null;\n"
+  "};\n",
+  NULL
+};
+
+static WebKitScriptWorld* script_world = NULL;
+
+/* forward declarations */
+static JSCValue* extension_hints_object(WebKitWebPage* page);
+static void cb_extension_page_created(WebKitWebExtension* extension,
+    WebKitWebPage* page, gpointer data);
+static gboolean cb_extension_user_message_received(WebKitWebPage* page,
+    WebKitUserMessage* message, gpointer data);
+static void extension_hints_show(WebKitWebPage* page, WebKitUserMessage* message);
+static void cb_extension_hints_changed(JSCValue* removed, JSCValue* added,
+    WebKitWebPage* page);
+static gint32 extension_array_length(JSCValue* array);
+static JSCValue* extension_array_new_from_ids(JSCContext* context, GVariant* ids);
+static gint32 extension_array_get_int32(JSCValue* array, gint32 index);
+static void extension_hints_add_to_builder(GVariantBuilder* builder, JSCValue*
+    added);
+
+G_MODULE_EXPORT void
+webkit_web_extension_initialize(WebKitWebExtension* extension)
+{
+  script_world = webkit_script_world_new();
+
+  g_signal_connect(extension, "page-created",
+      G_CALLBACK(cb_extension_page_created), NULL);
+}
+
+static void
+cb_extension_page_created(WebKitWebExtension* extension, WebKitWebPage* page,
+    gpointer data)
+{
+  g_signal_connect(page, "user-message-received",
+      G_CALLBACK(cb_extension_user_message_received), NULL);
+}
+
+static gboolean
+cb_extension_user_message_received(WebKitWebPage* page, WebKitUserMessage*
+    message, gpointer data)
+{
+  const char* name = webkit_user_message_get_name(message);
+  GVariant* parameters = webkit_user_message_get_parameters(message);
+
+  if (g_strcmp0(name, EXTENSION_MESSAGE_HINTS_SHOW) == 0) {
+    extension_hints_show(page, message);
+    return TRUE;
+  }
+
+  JSCValue* hints = extension_hints_object(page);
+  if (hints == NULL) {
+    return FALSE;
+  }
+
+  JSCValue* result = NULL;
+
+  if (g_strcmp0(name, EXTENSION_MESSAGE_HINTS_LABEL) == 0 && parameters != NULL) {
+    JSCContext* context = jsc_value_get_context(hints);
+    JSCValue* array     = jsc_value_new_array(context, G_TYPE_NONE);
+
+    /* flatten the pairs of ids and labels */
+    GVariantIter* iter = NULL;
+    g_variant_get(parameters, "(a(us))", &iter);
+
+    guint32 id        = 0;
+    const char* label = NULL;
+    guint position    = 0;
+
+    while (g_variant_iter_loop(iter, "(u&s)", &id, &label) == TRUE) {
+      JSCValue* value = jsc_value_new_number(context, id);
+      jsc_value_object_set_property_at_index(array, position++, value);
+      g_object_unref(value);
+
+      value = jsc_value_new_string(context, label);
+      jsc_value_object_set_property_at_index(array, position++, value);
+      g_object_unref(value);
+    }
+    g_variant_iter_free(iter);
+
+    result = jsc_value_object_invoke_method(hints, "label", JSC_TYPE_VALUE,
+        array, G_TYPE_NONE);
+
+    g_object_unref(array);
+  } else if (g_strcmp0(name, EXTENSION_MESSAGE_HINTS_UPDATE) == 0 && parameters != NULL) {
+    JSCContext* context = jsc_value_get_context(hints);
+
+    GVariant* ids    = g_variant_get_child_value(parameters, 0);
+    JSCValue* hidden = extension_array_new_from_ids(context, ids);
+    g_variant_unref(ids);
+
+    ids              = g_variant_get_child_value(parameters, 1);
+    JSCValue* shown  = extension_array_new_from_ids(context, ids);
+    g_variant_unref(ids);
+
+    result = jsc_value_object_invoke_method(hints, "update", JSC_TYPE_VALUE,
+        hidden, JSC_TYPE_VALUE, shown, G_TYPE_NONE);
+
+    g_object_unref(hidden);
+    g_object_unref(shown);
+  } else if (g_strcmp0(name, EXTENSION_MESSAGE_HINTS_ACTIVATE) == 0 && parameters != NULL) {
+    guint32 index    = 0;
+    gboolean new_tab = FALSE;
+    g_variant_get(parameters, "(ub)", &index, &new_tab);
+
+    result = jsc_value_object_invoke_method(hints, "activate", G_TYPE_UINT,
+        index, G_TYPE_BOOLEAN, new_tab, G_TYPE_NONE);
+  } else if (g_strcmp0(name, EXTENSION_MESSAGE_HINTS_CLEAR) == 0) {
+    result = jsc_value_object_invoke_method(hints, "clear", G_TYPE_NONE);
+  }
+
+  if (result != NULL) {
+    g_object_unref(result);
+  }
+
+  g_object_unref(hints);
+
+  return (result != NULL) ? TRUE : FALSE;
+}
+
+static JSCValue*
+extension_hints_object(WebKitWebPage* page)
+{
+  WebKitFrame* frame = webkit_web_page_get_main_frame(page);
+  if (frame == NULL) {
+    return NULL;
+  }
+
+  JSCContext* context = webkit_frame_get_js_context_for_script_world(frame,
+      script_world);
+  if (context == NULL) {
+    return NULL;
+  }
+
+  /* every new document gets a new context */
+  JSCValue* hints = jsc_context_get_value(context, "jumanji");
+  if (jsc_value_is_undefined(hints) == TRUE) {
+    g_object_unref(hints);
+
+    for (unsigned int i = 0; hints_script[i] != NULL; i++) {
+      JSCValue* result = jsc_context_evaluate(context, hints_script[i], -1);
+      g_object_unref(result);
+    }
+
+    hints = jsc_context_get_value(context, "jumanji");
+
+    /* changes of the hints are forwarded to the browser */
+    if (jsc_value_is_object(hints) == TRUE) {
+      JSCValue* changed = jsc_value_new_function(context, "changed",
+          G_CALLBACK(cb_extension_hints_changed), page, NULL, G_TYPE_NONE, 2,
+          JSC_TYPE_VALUE, JSC_TYPE_VALUE);
+      jsc_value_object_set_property(hints, "changed", changed);
+      g_object_unref(changed);
+    }
+  }
+
+  g_object_unref(context);
+
+  if (jsc_value_is_object(hints) == FALSE) {
+    g_object_unref(hints);
+    return NULL;
+  }
+
+  return hints;
+}
+
+static void
+extension_hints_show(WebKitWebPage* page, WebKitUserMessage* message)
+{
+  GVariant* parameters = webkit_user_message_get_parameters(message);
+
+  GVariantBuilder builder;
+  g_variant_builder_init(&builder, G_VARIANT_TYPE("a(uiiii)"));
+
+  const char* css = "";
+  if (parameters != NULL) {
+    g_variant_get(parameters, "(&s)", &css);
+  }
+
+  /* the rects are collected in the web process, only the result crosses the
+   * process boundary */
+  JSCValue* hints = extension_hints_object(page);
+  if (hints != NULL) {
+    JSCValue* added = jsc_value_object_invoke_method(hints, "show",
+        G_TYPE_STRING, css, G_TYPE_NONE);
+
+    if (added != NULL) {
+      extension_hints_add_to_builder(&builder, added);
+      g_object_unref(added);
+    }
+
+    g_object_unref(hints);
+  }
+
+  webkit_user_message_send_reply(message, webkit_user_message_new(
+        EXTENSION_MESSAGE_HINTS_SHOW, g_variant_new("(a(uiiii))", &builder)));
+}
+
+static void
+cb_extension_hints_changed(JSCValue* removed, JSCValue* added, WebKitWebPage* page)
+{
+  GVariantBuilder removed_builder;
+  g_variant_builder_init(&removed_builder, G_VARIANT_TYPE("au"));
+
+  gint32 length = extension_array_length(removed);
+  for (gint32 i = 0; i < length; i++) {
+    g_variant_builder_add(&removed_builder, "u", extension_array_get_int32(removed, i));
+  }
+
+  GVariantBuilder added_builder;
+  g_variant_builder_init(&added_builder, G_VARIANT_TYPE("a(uiiii)"));
+  extension_hints_add_to_builder(&added_builder, added);
+
+  webkit_web_page_send_message_to_view(page, webkit_user_message_new(
+        EXTENSION_MESSAGE_HINTS_CHANGED, g_variant_new("(aua(uiiii))",
+          &removed_builder, &added_builder)), NULL, NULL, NULL);
+}
+
+static void
+extension_hints_add_to_builder(GVariantBuilder* builder, JSCValue* added)
+{
+  /* the array holds an id and four coordinates per hint */
+  gint32 length = extension_array_length(added);
+  for (gint32 i = 0; i + 4 < length; i += 5) {
+    g_variant_builder_add(builder, "(uiiii)",
+        extension_array_get_int32(added, i),
+        extension_array_get_int32(added, i + 1),
+        extension_array_get_int32(added, i + 2),
+        extension_array_get_int32(added, i + 3),
+        extension_array_get_int32(added, i + 4));
+  }
+}
+
+static gint32
+extension_array_length(JSCValue* array)
+{
+  if (array == NULL || jsc_value_is_array(array) == FALSE) {
+    return 0;
+  }
+
+  JSCValue* length = jsc_value_object_get_property(array, "length");
+  gint32 result    = jsc_value_to_int32(length);
+  g_object_unref(length);
+
+  return result;
+}
+
+static gint32
+extension_array_get_int32(JSCValue* array, gint32 index)
+{
+  JSCValue* value = jsc_value_object_get_property_at_index(array, index);
+  gint32 result   = jsc_value_to_int32(value);
+  g_object_unref(value);
+
+  return result;
+}
+
+static JSCValue*
+extension_array_new_from_ids(JSCContext* context, GVariant* ids)
+{
+  JSCValue* array = jsc_value_new_array(context, G_TYPE_NONE);
+
+  gsize length = g_variant_n_children(ids);
+  for (gsize i = 0; i < length; i++) {
+    guint32 id = 0;
+    g_variant_get_child(ids, i, "u", &id);
+
+    JSCValue* value = jsc_value_new_number(context, id);
+    jsc_value_object_set_property_at_index(array, i, value);
+    g_object_unref(value);
+  }
+
+  return array;
+}
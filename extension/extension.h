@@ -0,0 +1,35 @@
+/* See LICENSE file for license and copyright information */
+
+#ifndef EXTENSION_H
+#define EXTENSION_H
+
+/**
+ * Messages the browser sends to the web extension. Every message is sent to
+ * the page of one tab. Hints are identified by ids that stay the same while
+ * the hints are shown.
+ *
+ * EXTENSION_MESSAGE_HINTS_SHOW: (s) hint css; collects the clickable elements
+ *   in the viewport. The reply carries their ids and rects relative to the
+ *   document as a(uiiii) (id, x, y, width, height).
+ * EXTENSION_MESSAGE_HINTS_LABEL: a(us) pairs of ids and labels; renders the
+ *   hints or changes their labels.
+ * EXTENSION_MESSAGE_HINTS_UPDATE: (auau) ids of hints to hide and ids of
+ *   hints to show; only hints whose visibility changes are sent.
+ * EXTENSION_MESSAGE_HINTS_ACTIVATE: (ub) hint id and whether to open the
+ *   link in a new tab; focuses or clicks the element and clears the hints.
+ * EXTENSION_MESSAGE_HINTS_CLEAR: no parameters; removes all hints.
+ *
+ * Messages the web extension sends to the browser:
+ *
+ * EXTENSION_MESSAGE_HINTS_CHANGED: (aua(uiiii)) ids of hints whose elements
+ *   left the viewport and ids and rects of elements that entered it; the new
+ *   hints are rendered once they have been labeled.
+ */
+#define EXTENSION_MESSAGE_HINTS_SHOW "hints-show"
+#define EXTENSION_MESSAGE_HINTS_LABEL "hints-label"
+#define EXTENSION_MESSAGE_HINTS_UPDATE "hints-update"
+#define EXTENSION_MESSAGE_HINTS_ACTIVATE "hints-activate"
+#define EXTENSION_MESSAGE_HINTS_CLEAR "hints-clear"
+#define EXTENSION_MESSAGE_HINTS_CHANGED "hints-changed"
+
+#endif // EXTENSION_H
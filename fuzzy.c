@@ -0,0 +1,285 @@
+/* See LICENSE file for license and copyright information */
+
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "fuzzy.h"
+
+/* scores, similar to the ones used by fzf */
+#define FUZZY_SCORE_MATCH 16
+#define FUZZY_PENALTY_GAP_START 3
+#define FUZZY_PENALTY_GAP_EXTENSION 1
+#define FUZZY_BONUS_BOUNDARY 8
+#define FUZZY_BONUS_CAMEL 7
+#define FUZZY_BONUS_CONSECUTIVE 4
+#define FUZZY_BONUS_FIRST_MULTIPLIER 2
+
+struct fuzzy_pattern_s
+{
+  char* text; /**> The pattern, lower case unless it is case sensitive */
+  size_t length; /**> Length of the pattern */
+  bool case_sensitive; /**> true if the pattern contains upper case characters */
+  guint64 charset; /**> Characters every match contains */
+};
+
+/* forward declarations */
+static guint64 fuzzy_charset_bit(unsigned char c);
+static int fuzzy_bonus(const char* text, size_t position);
+static gint fuzzy_match_compare(gconstpointer a, gconstpointer b);
+
+fuzzy_pattern_t*
+fuzzy_pattern_new(const char* input)
+{
+  if (input == NULL) {
+    return NULL;
+  }
+
+  fuzzy_pattern_t* pattern = g_malloc0(sizeof(fuzzy_pattern_t));
+  if (pattern == NULL) {
+    return NULL;
+  }
+
+  pattern->length         = strlen(input);
+  pattern->case_sensitive = false;
+
+  for (size_t i = 0; i < pattern->length; i++) {
+    if (g_ascii_isupper(input[i])) {
+      pattern->case_sensitive = true;
+      break;
+    }
+  }
+
+  pattern->text    = (pattern->case_sensitive == true) ? g_strdup(input) :
+    g_ascii_strdown(input, -1);
+  pattern->charset = fuzzy_charset(input);
+
+  return pattern;
+}
+
+void
+fuzzy_pattern_free(fuzzy_pattern_t* pattern)
+{
+  if (pattern == NULL) {
+    return;
+  }
+
+  g_free(pattern->text);
+  g_free(pattern);
+}
+
+guint64
+fuzzy_pattern_charset(const fuzzy_pattern_t* pattern)
+{
+  return (pattern != NULL) ? pattern->charset : 0;
+}
+
+guint64
+fuzzy_charset(const char* text)
+{
+  guint64 charset = 0;
+
+  if (text == NULL) {
+    return charset;
+  }
+
+  for (const char* c = text; *c != '\0'; c++) {
+    charset |= fuzzy_charset_bit(*c);
+  }
+
+  return charset;
+}
+
+size_t
+fuzzy_filter(const guint64* charsets, size_t count, guint64 required,
+    unsigned int* matches)
+{
+  if (charsets == NULL || matches == NULL) {
+    return 0;
+  }
+
+  size_t number_of_matches = 0;
+  size_t i = 0;
+
+#if defined(__AVX2__)
+  /* compare four character sets at once */
+  const __m256i mask = _mm256_set1_epi64x((long long) required);
+  for (; i + 4 <= count; i += 4) {
+    __m256i block = _mm256_loadu_si256((const __m256i*) (charsets + i));
+    __m256i hits  = _mm256_cmpeq_epi64(_mm256_and_si256(block, mask), mask);
+    int bits      = _mm256_movemask_pd(_mm256_castsi256_pd(hits));
+
+    for (unsigned int j = 0; bits != 0; j++, bits >>= 1) {
+      if (bits & 1) {
+        matches[number_of_matches++] = i + j;
+      }
+    }
+  }
+#elif defined(__SSE2__)
+  /* compare two character sets at once; SSE2 has no 64 bit comparison, so
+   * both 32 bit halves have to match */
+  const __m128i mask = _mm_set1_epi64x((long long) required);
+  for (; i + 2 <= count; i += 2) {
+    __m128i block = _mm_loadu_si128((const __m128i*) (charsets + i));
+    __m128i hits  = _mm_cmpeq_epi32(_mm_and_si128(block, mask), mask);
+    int bits      = _mm_movemask_ps(_mm_castsi128_ps(hits));
+
+    if ((bits & 0x3) == 0x3) {
+      matches[number_of_matches++] = i;
+    }
+
+    if ((bits & 0xc) == 0xc) {
+      matches[number_of_matches++] = i + 1;
+    }
+  }
+#endif
+
+  for (; i < count; i++) {
+    if ((charsets[i] & required) == required) {
+      matches[number_of_matches++] = i;
+    }
+  }
+
+  return number_of_matches;
+}
+
+bool
+fuzzy_match(const fuzzy_pattern_t* pattern, const char* text, int* score)
+{
+  if (pattern == NULL || text == NULL) {
+    return false;
+  }
+
+  if (pattern->length == 0) {
+    if (score != NULL) {
+      *score = 0;
+    }
+    return true;
+  }
+
+#define FOLD(c) ((pattern->case_sensitive == true) ? (c) : g_ascii_tolower(c))
+
+  /* find the first occurrence of the pattern as a subsequence */
+  size_t length = strlen(text);
+  size_t p      = 0;
+  size_t end    = length;
+
+  for (size_t i = 0; i < length; i++) {
+    if (FOLD(text[i]) == pattern->text[p] && ++p == pattern->length) {
+      end = i;
+      break;
+    }
+  }
+
+  if (end == length) {
+    return false;
+  }
+
+  /* walk back from its end to find the shortest occurrence */
+  size_t start = end;
+  for (size_t i = end + 1; i-- > 0;) {
+    if (FOLD(text[i]) == pattern->text[p - 1] && --p == 0) {
+      start = i;
+      break;
+    }
+  }
+
+  /* score the occurrence */
+  int result       = 0;
+  bool in_gap      = false;
+  bool consecutive = false;
+
+  p = 0;
+  for (size_t i = start; i <= end; i++) {
+    if (p < pattern->length && FOLD(text[i]) == pattern->text[p]) {
+      int bonus = fuzzy_bonus(text, i);
+      if (consecutive == true && bonus < FUZZY_BONUS_CONSECUTIVE) {
+        bonus = FUZZY_BONUS_CONSECUTIVE;
+      }
+
+      if (p == 0) {
+        bonus *= FUZZY_BONUS_FIRST_MULTIPLIER;
+      }
+
+      result     += FUZZY_SCORE_MATCH + bonus;
+      in_gap      = false;
+      consecutive = true;
+      p++;
+    } else {
+      result     -= (in_gap == true) ? FUZZY_PENALTY_GAP_EXTENSION : FUZZY_PENALTY_GAP_START;
+      in_gap      = true;
+      consecutive = false;
+    }
+  }
+
+#undef FOLD
+
+  if (score != NULL) {
+    *score = result;
+  }
+
+  return true;
+}
+
+void
+fuzzy_sort(GArray* matches)
+{
+  if (matches == NULL) {
+    return;
+  }
+
+  g_array_sort(matches, fuzzy_match_compare);
+}
+
+static guint64
+fuzzy_charset_bit(unsigned char c)
+{
+  c = g_ascii_tolower(c);
+
+  if (c >= 'a' && c <= 'z') {
+    return G_GUINT64_CONSTANT(1) << (c - 'a');
+  } else if (c >= '0' && c <= '9') {
+    return G_GUINT64_CONSTANT(1) << (26 + c - '0');
+  }
+
+  /* all other characters share the remaining bits */
+  return G_GUINT64_CONSTANT(1) << (36 + c % 28);
+}
+
+static int
+fuzzy_bonus(const char* text, size_t position)
+{
+  if (position == 0) {
+    return FUZZY_BONUS_BOUNDARY;
+  }
+
+  char previous = text[position - 1];
+  char current  = text[position];
+
+  if (g_ascii_isalnum(previous) == FALSE) {
+    return FUZZY_BONUS_BOUNDARY;
+  } else if ((g_ascii_islower(previous) && g_ascii_isupper(current)) ||
+      (g_ascii_isalpha(previous) && g_ascii_isdigit(current))) {
+    return FUZZY_BONUS_CAMEL;
+  }
+
+  return 0;
+}
+
+static gint
+fuzzy_match_compare(gconstpointer a, gconstpointer b)
+{
+  const fuzzy_match_t* match_a = (const fuzzy_match_t*) a;
+  const fuzzy_match_t* match_b = (const fuzzy_match_t*) b;
+
+  if (match_a->score != match_b->score) {
+    return (match_a->score > match_b->score) ? -1 : 1;
+  }
+
+  return (match_a->position < match_b->position) ? -1 :
+    (match_a->position > match_b->position) ? 1 : 0;
+}
@@ -0,0 +1,90 @@
+/* See LICENSE file for license and copyright information */
+
+#ifndef FUZZY_H
+#define FUZZY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <glib.h>
+
+typedef struct fuzzy_pattern_s fuzzy_pattern_t;
+
+/**
+ * A scored candidate
+ */
+typedef struct fuzzy_match_s
+{
+  int score; /**> Score of the candidate, higher is better */
+  unsigned int position; /**> Original position of the candidate */
+  void* data; /**> The candidate */
+} fuzzy_match_t;
+
+/**
+ * Compiles a pattern. The pattern matches case insensitive unless it contains
+ * an upper case character.
+ *
+ * @param input The input
+ * @return The pattern or NULL if an error occured
+ */
+fuzzy_pattern_t* fuzzy_pattern_new(const char* input);
+
+/**
+ * Frees a pattern
+ *
+ * @param pattern The pattern
+ */
+void fuzzy_pattern_free(fuzzy_pattern_t* pattern);
+
+/**
+ * Returns the character set every candidate has to contain to match the
+ * pattern
+ *
+ * @param pattern The pattern
+ * @return The character set
+ */
+guint64 fuzzy_pattern_charset(const fuzzy_pattern_t* pattern);
+
+/**
+ * Calculates the character set of a text. Every character is mapped to one bit
+ * of the set, upper and lower case letters share the same bit.
+ *
+ * @param text The text
+ * @return The character set
+ */
+guint64 fuzzy_charset(const char* text);
+
+/**
+ * Collects the positions of all character sets that contain the required
+ * characters. This is done with SSE2 or AVX2 if the compiler targets them.
+ *
+ * @param charsets The character sets of the candidates
+ * @param count Number of candidates
+ * @param required The character set of the pattern
+ * @param matches Receives the positions of the remaining candidates, has to
+ *   have room for count entries
+ * @return Number of remaining candidates
+ */
+size_t fuzzy_filter(const guint64* charsets, size_t count, guint64 required,
+    unsigned int* matches);
+
+/**
+ * Matches the pattern as a subsequence of the text and scores the match.
+ * Matches at word boundaries, consecutive matches and short matches are
+ * preferred.
+ *
+ * @param pattern The pattern
+ * @param text The text
+ * @param score Receives the score of the match
+ * @return true if the text matches the pattern
+ */
+bool fuzzy_match(const fuzzy_pattern_t* pattern, const char* text, int* score);
+
+/**
+ * Sorts matches by descending score, matches with the same score keep their
+ * original order
+ *
+ * @param matches Array of fuzzy_match_t
+ */
+void fuzzy_sort(GArray* matches);
+
+#endif // FUZZY_H
@@ -2,16 +2,62 @@
 
 #include <stdlib.h>
 #include <string.h>
-#include <math.h>
 #include <webkit2/webkit2.h>
-#include <webkitdom/webkitdom.h>
 
 #include "hints.h"
+#include "extension/extension.h"
 #include <girara/session.h>
 #include <girara/settings.h>
 #include <girara/callbacks.h>
 
+/* node of the trie over the labels of the shown hints */
+typedef struct hints_node_s
+{
+  struct hints_node_s* parent; /**> Parent node */
+  struct hints_node_s* child; /**> First child */
+  struct hints_node_s* next; /**> Next sibling */
+  char key; /**> Letter of the label at the depth of the node */
+  guint32 id; /**> Hint id + 1 of the label that ends here, otherwise 0 */
+  unsigned int count; /**> Number of labels in the subtree */
+} hints_node_t;
+
+/* centre of a hint relative to the viewport */
+typedef struct hints_position_s
+{
+  gint32 x; /**> X coordinate */
+  gint32 y; /**> Y coordinate */
+} hints_position_t;
+
+/* hint id with the distance used to rank its label */
+typedef struct hints_rank_s
+{
+  guint32 id; /**> Hint id */
+  gint64 distance; /**> Squared distance */
+} hints_rank_t;
+
 static bool cb_hints_activate(GtkWidget* widget, jumanji_t* jumanji);
+static void cb_hints_show_finished(GObject* source, GAsyncResult* result,
+    gpointer data);
+static void hints_send_message(jumanji_t* jumanji, WebKitUserMessage* message);
+static void hints_change(jumanji_t* jumanji, GVariantIter* removed, GVariantIter* added);
+static GPtrArray* hints_create_labels(const char* alphabet, guint number_of_labels);
+static void hints_rank(jumanji_t* jumanji, GArray* ids);
+static int hints_rank_compare(const void* a, const void* b);
+static char* hints_alphabet(jumanji_t* jumanji);
+static hints_node_t* hints_label_set(jumanji_t* jumanji, guint32 id, char* label,
+    GVariantBuilder* builder);
+static void hints_send_update(jumanji_t* jumanji, GArray* hidden, GArray* shown);
+static hints_node_t* hints_node_new(hints_node_t* parent, char key);
+static void hints_node_free(hints_node_t* node);
+static hints_node_t* hints_node_child(hints_node_t* node, char key);
+static hints_node_t* hints_node_insert(hints_node_t* trie, const char* label,
+    guint32 id);
+static void hints_node_remove(hints_node_t* trie, const char* label);
+static hints_node_t* hints_node_find(hints_node_t* trie, const char* label);
+static bool hints_node_is_ancestor(hints_node_t* ancestor, hints_node_t* node);
+static void hints_node_collect(hints_node_t* node, GArray* ids);
+static void hints_node_collect_except(hints_node_t* ancestor, hints_node_t* node,
+    GArray* ids);
 
 bool
 sc_hints(girara_session_t* session, girara_argument_t* argument, girara_event_t* event, unsigned int t)
@@ -48,7 +94,6 @@ sc_hints(girara_session_t* session, girara_argument_t* argument, girara_event_t*
 bool
 cb_hints_activate(GtkWidget* widget, jumanji_t* jumanji)
 {
-  fprintf(stderr, "reset\n");
   g_return_val_if_fail(jumanji != NULL, false);
   hints_reset(jumanji);
   return true;
@@ -67,11 +112,13 @@ cb_hints_key_press_event_add(GtkWidget* widget, GdkEventKey* event,
     jumanji->hints.input = g_string_new("");
   }
 
-  /* only allow numbers and characters */
-  if (((event->keyval >= 0x30 && event->keyval <= 0x39) || (event->keyval >= 0x41 && event->keyval <= 0x5A) ||
-      (event->keyval >= 0x61 && event->keyval <= 0x7A)) == true) {
+  /* only allow printable characters, the letters of the hint alphabet */
+  if (event->keyval >= 0x21 && event->keyval <= 0x7E) {
     g_string_append_c(jumanji->hints.input, (char) event->keyval);
     return hints_update(jumanji, jumanji->hints.input->str);
+  } else if (event->keyval == GDK_KEY_BackSpace && jumanji->hints.input->len > 0) {
+    g_string_truncate(jumanji->hints.input, jumanji->hints.input->len - 1);
+    return hints_update(jumanji, jumanji->hints.input->str);
   } else if (event->keyval == GDK_KEY_Escape || event->keyval == GDK_KEY_Return) {
     hints_reset(jumanji);
   }
@@ -89,359 +136,616 @@ hints_show(jumanji_t* jumanji, jumanji_tab_t* tab)
 
   hints_clear(jumanji);
 
-  WebKitWebView *web_view         = WEBKIT_WEB_VIEW(tab->web_view);
-  WebKitDOMDocument *dom_document = NULL;//webkit_web_view_get_dom_document(web_view);
+  char* css = NULL;
+  girara_setting_get(jumanji->ui.session, "hint-css", &css);
 
-  if (dom_document == NULL) {
+  jumanji->hints.tab         = tab;
+  jumanji->hints.cancellable = g_cancellable_new();
+  jumanji->hints.labels      = g_ptr_array_new_with_free_func(g_free);
+  jumanji->hints.unused      = g_ptr_array_new_with_free_func(g_free);
+  jumanji->hints.positions   = g_array_new(FALSE, TRUE, sizeof(hints_position_t));
+  jumanji->hints.alphabet    = hints_alphabet(jumanji);
+  jumanji->hints.trie        = hints_node_new(NULL, '\0');
+  jumanji->hints.node        = jumanji->hints.trie;
+
+  /* the web extension collects the elements in the web process and replies
+   * with their rects in one message */
+  WebKitUserMessage* message = webkit_user_message_new(EXTENSION_MESSAGE_HINTS_SHOW,
+      g_variant_new("(s)", (css != NULL) ? css : ""));
+
+  webkit_web_view_send_message_to_page(WEBKIT_WEB_VIEW(tab->web_view), message,
+      jumanji->hints.cancellable, cb_hints_show_finished, jumanji);
+
+  g_free(css);
+}
+
+void
+hints_clear(jumanji_t* jumanji)
+{
+  if (jumanji == NULL) {
     return;
   }
 
-  WebKitDOMElement *style = webkit_dom_document_create_element(dom_document, "style", NULL);
+  if (jumanji->hints.cancellable != NULL) {
+    g_cancellable_cancel(jumanji->hints.cancellable);
+    g_object_unref(jumanji->hints.cancellable);
+    jumanji->hints.cancellable = NULL;
+  }
 
-  if (style == NULL) {
-    return;
+  if (jumanji->hints.tab != NULL) {
+    hints_send_message(jumanji, webkit_user_message_new(EXTENSION_MESSAGE_HINTS_CLEAR, NULL));
+    jumanji->hints.tab = NULL;
   }
 
-  webkit_dom_element_set_attribute(style, "type", "text/css", NULL);
+  if (jumanji->hints.labels != NULL) {
+    g_ptr_array_free(jumanji->hints.labels, TRUE);
+    jumanji->hints.labels = NULL;
+  }
 
-  char* string_value = NULL;
-  girara_setting_get(jumanji->ui.session, "hint-css", &string_value);
-  if (string_value == NULL) {
-    return;
+  if (jumanji->hints.trie != NULL) {
+    hints_node_free(jumanji->hints.trie);
+    jumanji->hints.trie = NULL;
+    jumanji->hints.node = NULL;
   }
 
-  char* hint_div_style = g_strdup_printf(".__jumanji_hint { %s }\n", string_value);
-  if (hint_div_style == NULL) {
-    return;
+  if (jumanji->hints.unused != NULL) {
+    g_ptr_array_free(jumanji->hints.unused, TRUE);
+    jumanji->hints.unused = NULL;
   }
 
-  webkit_dom_html_element_set_inner_html(WEBKIT_DOM_HTML_ELEMENT(style), hint_div_style, NULL);
+  if (jumanji->hints.positions != NULL) {
+    g_array_free(jumanji->hints.positions, TRUE);
+    jumanji->hints.positions = NULL;
+  }
 
-  g_free(string_value);
-  g_free(hint_div_style);
+  g_free(jumanji->hints.alphabet);
+  jumanji->hints.alphabet = NULL;
+}
 
-  WebKitDOMNodeList *list = webkit_dom_document_get_elements_by_tag_name(dom_document, "head");
+bool
+hints_process(jumanji_t* jumanji, guint n)
+{
+  if (jumanji == NULL || jumanji->hints.tab == NULL ||
+      jumanji->hints.labels == NULL || n >= jumanji->hints.labels->len ||
+      g_ptr_array_index(jumanji->hints.labels, n) == NULL) {
+    return false;
+  }
 
-  if (list == NULL) {
-    return;
+  /* the next labels are ranked by their distance to the followed hint */
+  if (n < jumanji->hints.positions->len) {
+    hints_position_t* position = &g_array_index(jumanji->hints.positions,
+        hints_position_t, n);
+
+    jumanji->hints.followed   = true;
+    jumanji->hints.followed_x = position->x;
+    jumanji->hints.followed_y = position->y;
   }
 
-  WebKitDOMNode *head = webkit_dom_node_list_item(list, 0);
+  /* the extension clears its hints on its own */
+  hints_send_message(jumanji, webkit_user_message_new(EXTENSION_MESSAGE_HINTS_ACTIVATE,
+        g_variant_new("(ub)", n, (jumanji->hints.open_mode == NEW_TAB) ? TRUE : FALSE)));
+  jumanji->hints.tab = NULL;
 
-  if (head == NULL) {
-    return;
+  hints_reset(jumanji);
+
+  return true;
+}
+
+bool
+hints_update(jumanji_t* jumanji, char* input)
+{
+  if (jumanji == NULL || input == NULL || jumanji->hints.trie == NULL) {
+    return false;
   }
 
-  webkit_dom_node_append_child(head, WEBKIT_DOM_NODE(style), NULL);
+  /* the input selects a subtree of the trie; NULL if no label matches */
+  hints_node_t* node = hints_node_find(jumanji->hints.trie, input);
+  if (node != NULL && node->id != 0) {
+    return hints_process(jumanji, node->id - 1);
+  }
 
-  list = webkit_dom_document_get_elements_by_tag_name(dom_document, "body");
+  /* only the hints that enter or leave the selected subtree are updated */
+  GArray* hidden = g_array_new(FALSE, FALSE, sizeof(guint32));
+  GArray* shown  = g_array_new(FALSE, FALSE, sizeof(guint32));
+  hints_node_t* previous = jumanji->hints.node;
 
-  if (list == NULL) {
-    return;
+  if (previous == NULL && node != NULL) {
+    hints_node_collect(node, shown);
+  } else if (previous != NULL && node == NULL) {
+    hints_node_collect(previous, hidden);
+  } else if (hints_node_is_ancestor(previous, node) == true) {
+    hints_node_collect_except(previous, node, hidden);
+  } else if (hints_node_is_ancestor(node, previous) == true) {
+    hints_node_collect_except(node, previous, shown);
+  } else if (previous != node) {
+    hints_node_collect(previous, hidden);
+    hints_node_collect(node, shown);
   }
 
-  WebKitDOMNode *body = webkit_dom_node_list_item(list, 0);
+  jumanji->hints.node = node;
+  hints_send_update(jumanji, hidden, shown);
 
-  /* get fields */
-  WebKitDOMXPathNSResolver *ns_resolver = webkit_dom_document_create_ns_resolver(dom_document, body);
+  return false;
+}
 
-  if (ns_resolver == NULL) {
+void
+hints_reset(jumanji_t* jumanji)
+{
+  if (jumanji == NULL) {
     return;
   }
 
-  WebKitDOMXPathResult *result = webkit_dom_document_evaluate(dom_document,
-      "//a | //button | //textarea | //select | //input[not(@type='hidden')]",
-      WEBKIT_DOM_NODE(dom_document), ns_resolver, 7, NULL, NULL);
+  /* clear hints */
+  hints_clear(jumanji);
 
-  if (result == NULL) {
-    return;
+  /* clear buffer */
+  if (jumanji->hints.input != NULL) {
+    g_string_free(jumanji->hints.input, TRUE);
+    jumanji->hints.input = NULL;
   }
+}
 
-  WebKitDOMElement *hints = webkit_dom_document_create_element(dom_document, "div", NULL);
+static void
+cb_hints_show_finished(GObject* source, GAsyncResult* result, gpointer data)
+{
+  GError* error = NULL;
+  WebKitUserMessage* reply = webkit_web_view_send_message_to_page_finish(
+      WEBKIT_WEB_VIEW(source), result, &error);
+
+  /* the hints may have been cleared in the meantime */
+  if (reply == NULL) {
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) == FALSE) {
+      jumanji_t* jumanji = (jumanji_t*) data;
+      girara_notify(jumanji->ui.session, GIRARA_ERROR, "Could not collect hints: %s",
+          error->message);
+    }
 
-  if (hints == NULL) {
+    g_error_free(error);
     return;
   }
 
-  gulong snapshot_length  = webkit_dom_xpath_result_get_snapshot_length(result, NULL);
-  jumanji->hints.links = g_ptr_array_sized_new(snapshot_length);
+  jumanji_t* jumanji = (jumanji_t*) data;
 
-  if (jumanji->hints.links == NULL) {
-    return;
+  g_object_unref(jumanji->hints.cancellable);
+  jumanji->hints.cancellable = NULL;
+
+  GVariantIter* added = NULL;
+  g_variant_get(webkit_user_message_get_parameters(reply), "(a(uiiii))", &added);
+  hints_change(jumanji, NULL, added);
+  g_variant_iter_free(added);
+
+  g_object_unref(reply);
+}
+
+bool
+cb_hints_user_message_received(WebKitWebView* web_view, WebKitUserMessage*
+    message, jumanji_tab_t* tab)
+{
+  if (tab == NULL || tab->jumanji == NULL || g_strcmp0(webkit_user_message_get_name(message),
+        EXTENSION_MESSAGE_HINTS_CHANGED) != 0) {
+    return false;
   }
 
-  /* retreive visible nodes */
-  for (guint i = 0; i < snapshot_length; i++) {
-    WebKitDOMNode *node = webkit_dom_xpath_result_snapshot_item(result, i, NULL);
+  /* changes of hints that have been cleared in the meantime are dropped */
+  jumanji_t* jumanji = tab->jumanji;
+  if (jumanji->hints.tab != tab || jumanji->hints.labels == NULL) {
+    return true;
+  }
 
-    if (node == NULL) {
-      continue;
-    }
+  GVariantIter* removed = NULL;
+  GVariantIter* added   = NULL;
+  g_variant_get(webkit_user_message_get_parameters(message), "(aua(uiiii))",
+      &removed, &added);
 
-    WebKitDOMCSSStyleDeclaration* css_style = webkit_dom_element_get_style(WEBKIT_DOM_ELEMENT(node));
+  hints_change(jumanji, removed, added);
 
-    if (css_style == NULL) {
-      continue;
-    }
+  g_variant_iter_free(removed);
+  g_variant_iter_free(added);
 
-    gchar *visibility = webkit_dom_css_style_declaration_get_property_value(css_style, "visibility");
+  return true;
+}
 
-    if (visibility != NULL && g_strcmp0(visibility, "hidden") == 0) {
-      continue;
+static void
+hints_change(jumanji_t* jumanji, GVariantIter* removed, GVariantIter* added)
+{
+  /* labels of removed hints are reused for new ones */
+  guint32 id = 0;
+  if (removed != NULL) {
+    while (g_variant_iter_next(removed, "u", &id) == TRUE) {
+      if (id >= jumanji->hints.labels->len) {
+        continue;
+      }
+
+      char* label = g_ptr_array_index(jumanji->hints.labels, id);
+      if (label != NULL) {
+        hints_node_remove(jumanji->hints.trie, label);
+        g_ptr_array_index(jumanji->hints.labels, id) = NULL;
+        g_ptr_array_add(jumanji->hints.unused, label);
+      }
     }
+  }
+
+  guint number_of_added = g_variant_iter_n_children(added);
+  if (number_of_added == 0) {
+    return;
+  }
 
-    gchar *display = webkit_dom_css_style_declaration_get_property_value(css_style, "display");
+  /* remember where the new hints are, the closest ones get the shortest
+   * labels once all hints are labeled */
+  GArray* ids = g_array_sized_new(FALSE, FALSE, sizeof(guint32), number_of_added);
 
-    if (display != NULL && g_strcmp0(display, "none") == 0) {
-      continue;
+  gint32 x, y, width, height;
+  while (g_variant_iter_next(added, "(uiiii)", &id, &x, &y, &width, &height) == TRUE) {
+    if (id >= jumanji->hints.positions->len) {
+      g_array_set_size(jumanji->hints.positions, id + 1);
     }
 
-    g_ptr_array_add(jumanji->hints.links,  node);
+    hints_position_t* position = &g_array_index(jumanji->hints.positions,
+        hints_position_t, id);
+    position->x = x + width / 2;
+    position->y = y + height / 2;
+
+    g_array_append_val(ids, id);
   }
 
-  guint number_of_hints   = jumanji->hints.links->len;
-  guint number_of_letters = log(number_of_hints)/log(26) + 1;
-  gchar *id               = g_strnfill(number_of_letters, 'a');
+  GVariantBuilder builder;
+  g_variant_builder_init(&builder, G_VARIANT_TYPE("a(us)"));
 
-  jumanji->hints.hints = g_ptr_array_sized_new(number_of_hints);
+  GArray* hidden = g_array_new(FALSE, FALSE, sizeof(guint32));
+  GArray* shown  = g_array_new(FALSE, FALSE, sizeof(guint32));
 
-  if (jumanji->hints.hints == NULL) {
-    return;
-  }
+  if (number_of_added <= jumanji->hints.unused->len) {
+    /* only the new hints are labeled, the labels of all others stay the same;
+     * new hints that do not match the input are hidden right away */
+    for (guint i = 0; i < ids->len; i++) {
+      id = g_array_index(ids, guint32, i);
 
-  for (guint i = 0; i < number_of_hints; i++) {
-    WebKitDOMElement *hint = webkit_dom_document_create_element(dom_document, "div", NULL);
+      char* label = g_ptr_array_steal_index(jumanji->hints.unused,
+          jumanji->hints.unused->len - 1);
+      hints_node_t* node = hints_label_set(jumanji, id, label, &builder);
 
-    if (hint == NULL) {
-      continue;
+      if (hints_node_is_ancestor(jumanji->hints.node, node) == false) {
+        g_array_append_val(hidden, id);
+      }
+    }
+  } else {
+    /* the labels ran out, so all hints are labeled again */
+    for (guint i = 0; i < jumanji->hints.labels->len; i++) {
+      if (g_ptr_array_index(jumanji->hints.labels, i) != NULL) {
+        g_free(g_ptr_array_index(jumanji->hints.labels, i));
+        g_ptr_array_index(jumanji->hints.labels, i) = NULL;
+
+        id = i;
+        g_array_append_val(ids, id);
+      }
     }
 
-    webkit_dom_html_element_set_inner_text(WEBKIT_DOM_HTML_ELEMENT(hint), id, NULL);
-    webkit_dom_element_set_class_name(WEBKIT_DOM_ELEMENT(hint), "__jumanji_hint");
+    bool filtered = (jumanji->hints.node != jumanji->hints.trie);
 
-    guint decimal = number_of_letters - 1;
-    while (id[decimal] == 'z') {
-      --decimal;
-    }
+    hints_node_free(jumanji->hints.trie);
+    jumanji->hints.trie = hints_node_new(NULL, '\0');
+    jumanji->hints.node = jumanji->hints.trie;
+    g_ptr_array_set_size(jumanji->hints.unused, 0);
+
+    /* a few spare labels are kept for hints that scroll into view; they are
+     * the longest ones and are handed out from the end */
+    hints_rank(jumanji, ids);
+    GPtrArray* labels = hints_create_labels(jumanji->hints.alphabet,
+        ids->len + ids->len / 8);
 
-    id[decimal] += 1;
-    for (guint j = decimal + 1; j < number_of_letters; j++) {
-      id[j] = 'a';
+    for (guint i = 0; i < labels->len; i++) {
+      if (i < ids->len) {
+        hints_label_set(jumanji, g_array_index(ids, guint32, i),
+            g_ptr_array_index(labels, i), &builder);
+      } else {
+        g_ptr_array_add(jumanji->hints.unused, g_ptr_array_index(labels, i));
+      }
     }
 
-    WebKitDOMNode *node = g_ptr_array_index(jumanji->hints.links, i);
+    g_ptr_array_free(labels, TRUE);
 
-    if (node == NULL) {
-      continue;
+    /* the input refers to the old labels */
+    if (jumanji->hints.input != NULL) {
+      g_string_truncate(jumanji->hints.input, 0);
     }
 
-    glong left = webkit_dom_element_get_offset_left(WEBKIT_DOM_ELEMENT(node));
-    glong top  = webkit_dom_element_get_offset_top(WEBKIT_DOM_ELEMENT(node));
+    if (filtered == true) {
+      hints_node_collect(jumanji->hints.trie, shown);
+    }
+  }
 
-    WebKitDOMElement* parent_node = webkit_dom_element_get_offset_parent(WEBKIT_DOM_ELEMENT(node));
-    while (parent_node != NULL) {
-      left += webkit_dom_element_get_offset_left(parent_node);
-      top  += webkit_dom_element_get_offset_top(parent_node);
+  g_array_free(ids, TRUE);
 
-      parent_node = webkit_dom_element_get_offset_parent(parent_node);
-    }
+  hints_send_message(jumanji, webkit_user_message_new(EXTENSION_MESSAGE_HINTS_LABEL,
+        g_variant_new("(a(us))", &builder)));
+  hints_send_update(jumanji, hidden, shown);
+}
 
-    left += webkit_dom_element_get_offset_width(WEBKIT_DOM_ELEMENT(node));
-    top  += webkit_dom_element_get_offset_height(WEBKIT_DOM_ELEMENT(node));
+static GPtrArray*
+hints_create_labels(const char* alphabet, guint number_of_labels)
+{
+  /* the shortest label is replaced by its extensions with every letter until
+   * there are enough labels; the result is prefix-free, sorted by length and
+   * its labels differ in length by at most one letter */
+  size_t number_of_letters = strlen(alphabet);
 
-    static const gchar *hint_div_position =
-      "position: absolute !important;"
-      "left: %lipx !important;"
-      "top:%lipx !important;"
-      "width:auto !important;"
-      "height:auto !important;";
+  GPtrArray* labels = g_ptr_array_new();
+  g_ptr_array_add(labels, g_strdup(""));
 
-    gchar *style = g_strdup_printf(hint_div_position, left, top);
+  guint offset = 0;
+  while (offset == 0 || labels->len - offset < number_of_labels) {
+    char* prefix = g_ptr_array_index(labels, offset++);
 
-    if (style == NULL) {
-      continue;
+    for (size_t i = 0; i < number_of_letters; i++) {
+      g_ptr_array_add(labels, g_strdup_printf("%s%c", prefix, alphabet[i]));
     }
 
-    WebKitDOMCSSStyleDeclaration *css = webkit_dom_element_get_style(hint);
+    g_free(prefix);
+  }
 
-    if (css == NULL) {
-      g_free(style);
-      continue;
-    }
+  g_ptr_array_remove_range(labels, 0, offset);
+
+  return labels;
+}
+
+static void
+hints_rank(jumanji_t* jumanji, GArray* ids)
+{
+  /* hints are ranked by their distance to the centre of the viewport or to
+   * the last followed hint, whichever is closer */
+  GtkWidget* web_view = jumanji->hints.tab->web_view;
+  gint64 centre_x     = gtk_widget_get_allocated_width(web_view) / 2;
+  gint64 centre_y     = gtk_widget_get_allocated_height(web_view) / 2;
+
+  hints_rank_t* ranks = g_malloc(sizeof(hints_rank_t) * MAX(ids->len, 1));
+
+  for (guint i = 0; i < ids->len; i++) {
+    guint32 id = g_array_index(ids, guint32, i);
+    hints_position_t* position = &g_array_index(jumanji->hints.positions,
+        hints_position_t, id);
 
-    webkit_dom_css_style_declaration_set_css_text(css, style, NULL);
-    webkit_dom_node_append_child(WEBKIT_DOM_NODE(hints), WEBKIT_DOM_NODE(hint), NULL);
+    gint64 x = position->x - centre_x;
+    gint64 y = position->y - centre_y;
 
-    g_ptr_array_add(jumanji->hints.hints, hint);
+    ranks[i].id       = id;
+    ranks[i].distance = x * x + y * y;
 
-    g_free(style);
+    if (jumanji->hints.followed == true) {
+      x = position->x - jumanji->hints.followed_x;
+      y = position->y - jumanji->hints.followed_y;
+      ranks[i].distance = MIN(ranks[i].distance, x * x + y * y);
+    }
   }
 
-  g_free(id);
+  qsort(ranks, ids->len, sizeof(hints_rank_t), hints_rank_compare);
 
-  webkit_dom_node_append_child(head, WEBKIT_DOM_NODE(style), NULL);
-  webkit_dom_node_append_child(body, WEBKIT_DOM_NODE(hints), NULL);
+  for (guint i = 0; i < ids->len; i++) {
+    g_array_index(ids, guint32, i) = ranks[i].id;
+  }
 
-  jumanji->hints.hint_style = WEBKIT_DOM_NODE(style);
-  jumanji->hints.hint_box   = WEBKIT_DOM_NODE(hints);
+  g_free(ranks);
 }
 
-void
-hints_clear(jumanji_t* jumanji)
+static int
+hints_rank_compare(const void* a, const void* b)
 {
-  if(jumanji->hints.hint_box != NULL) {
-    WebKitDOMNode* parent = webkit_dom_node_get_parent_node(jumanji->hints.hint_box);
-    webkit_dom_node_remove_child(parent, jumanji->hints.hint_box, NULL);
-    jumanji->hints.hint_box = NULL;
-  }
+  const hints_rank_t* rank_a = a;
+  const hints_rank_t* rank_b = b;
 
-  if(jumanji->hints.hint_style != NULL) {
-    WebKitDOMNode* parent = webkit_dom_node_get_parent_node(jumanji->hints.hint_style);
-    webkit_dom_node_remove_child(parent, jumanji->hints.hint_style, NULL);
-    jumanji->hints.hint_style = NULL;
+  if (rank_a->distance != rank_b->distance) {
+    return (rank_a->distance < rank_b->distance) ? -1 : 1;
   }
 
-  if(jumanji->hints.links != NULL) {
-    g_ptr_array_free(jumanji->hints.links, TRUE);
-    jumanji->hints.links = NULL;
+  return (rank_a->id < rank_b->id) ? -1 : (rank_a->id > rank_b->id);
+}
+
+static char*
+hints_alphabet(jumanji_t* jumanji)
+{
+  char* value = NULL;
+  girara_setting_get(jumanji->ui.session, "hint-alphabet", &value);
+
+  /* every letter is used once and at least two are needed */
+  GString* alphabet = g_string_new("");
+  for (const char* letter = value; letter != NULL && *letter != '\0'; letter++) {
+    if (g_ascii_isgraph(*letter) == TRUE && strchr(alphabet->str, *letter) == NULL) {
+      g_string_append_c(alphabet, *letter);
+    }
   }
 
-  if(jumanji->hints.hints != NULL) {
-    g_ptr_array_free(jumanji->hints.hints, TRUE);
-    jumanji->hints.hints = NULL;
+  g_free(value);
+
+  if (alphabet->len < 2) {
+    g_string_assign(alphabet, "asdfghjkl");
   }
+
+  return g_string_free(alphabet, FALSE);
 }
 
-bool
-hints_process(jumanji_t* jumanji, guint n)
+static hints_node_t*
+hints_label_set(jumanji_t* jumanji, guint32 id, char* label, GVariantBuilder* builder)
 {
-  if (jumanji == NULL) {
-    return false;
+  if (id >= jumanji->hints.labels->len) {
+    g_ptr_array_set_size(jumanji->hints.labels, id + 1);
   }
 
-  jumanji_tab_t* tab = jumanji_tab_get_current(jumanji);
+  g_free(g_ptr_array_index(jumanji->hints.labels, id));
+  g_ptr_array_index(jumanji->hints.labels, id) = label;
+  g_variant_builder_add(builder, "(us)", id, label);
 
-  if (tab == NULL || tab->web_view == NULL) {
-    return false;
+  return hints_node_insert(jumanji->hints.trie, label, id);
+}
+
+static void
+hints_send_message(jumanji_t* jumanji, WebKitUserMessage* message)
+{
+  if (jumanji->hints.tab == NULL || jumanji->hints.tab->web_view == NULL) {
+    g_object_ref_sink(message);
+    g_object_unref(message);
+    return;
   }
 
-  WebKitDOMDocument *dom_document = NULL;//webkit_web_view_get_dom_document(WEBKIT_WEB_VIEW(tab->web_view));
+  webkit_web_view_send_message_to_page(WEBKIT_WEB_VIEW(jumanji->hints.tab->web_view),
+      message, NULL, NULL, NULL);
+}
 
-  if (dom_document == NULL) {
-    return false;
+static void
+hints_send_update(jumanji_t* jumanji, GArray* hidden, GArray* shown)
+{
+  if (hidden->len > 0 || shown->len > 0) {
+    hints_send_message(jumanji, webkit_user_message_new(EXTENSION_MESSAGE_HINTS_UPDATE,
+          g_variant_new("(@au@au)",
+            g_variant_new_fixed_array(G_VARIANT_TYPE_UINT32, hidden->data,
+              hidden->len, sizeof(guint32)),
+            g_variant_new_fixed_array(G_VARIANT_TYPE_UINT32, shown->data,
+              shown->len, sizeof(guint32)))));
   }
 
-  if (jumanji->hints.links == NULL || jumanji->hints.links->len < n) {
-    return false;
-  }
+  g_array_free(hidden, TRUE);
+  g_array_free(shown, TRUE);
+}
 
-  WebKitDOMNode *item = g_ptr_array_index(jumanji->hints.links, n);
+static hints_node_t*
+hints_node_new(hints_node_t* parent, char key)
+{
+  hints_node_t* node = g_malloc0(sizeof(hints_node_t));
 
-  if (item == NULL) {
-    return false;
+  node->parent = parent;
+  node->key    = key;
+
+  if (parent != NULL) {
+    node->next    = parent->child;
+    parent->child = node;
   }
 
-  gchar *tag_ = webkit_dom_element_get_tag_name(WEBKIT_DOM_ELEMENT(item));
-  gchar *type = webkit_dom_element_get_attribute(WEBKIT_DOM_ELEMENT(item), "type");
+  return node;
+}
 
-  GString* tag = g_string_new(tag_);
-  g_string_ascii_down(tag);
+static void
+hints_node_free(hints_node_t* node)
+{
+  hints_node_t* child = node->child;
+  while (child != NULL) {
+    hints_node_t* next = child->next;
+    hints_node_free(child);
+    child = next;
+  }
 
-  /* input field */
-  if ((g_ascii_strcasecmp(tag->str, "input") == 0 &&
-        (type == NULL || type[0] == 0 || g_ascii_strcasecmp(type, "search") == 0 ||
-        g_ascii_strcasecmp(type, "text") == 0 || g_ascii_strcasecmp(type, "password") == 0))
-      || g_ascii_strcasecmp(tag->str, "textarea") == 0) {
-    webkit_dom_element_focus(WEBKIT_DOM_ELEMENT(item));
-    hints_reset(jumanji);
-    g_string_free(tag, TRUE);
-    return true;
-  /* open link */
-  } else {
-    WebKitDOMEvent *event = webkit_dom_document_create_event(dom_document, "MouseEvents", NULL);
+  g_free(node);
+}
 
-    gushort button = 0; /*left click*/
-    if (jumanji->hints.open_mode == NEW_TAB) {
-      button = 1; /*middle click*/
+static hints_node_t*
+hints_node_child(hints_node_t* node, char key)
+{
+  for (hints_node_t* child = node->child; child != NULL; child = child->next) {
+    if (child->key == key) {
+      return child;
     }
+  }
 
-    webkit_dom_mouse_event_init_mouse_event(
-        WEBKIT_DOM_MOUSE_EVENT(event),
-        "click",
-        TRUE,
-        TRUE,
-        webkit_dom_document_get_default_view(dom_document),
-        1, 0, 0, 0, 0,
-        FALSE,FALSE, FALSE, FALSE,
-        button,
-        WEBKIT_DOM_EVENT_TARGET(item));
-
-    webkit_dom_node_dispatch_event(item, event, NULL);
+  return NULL;
+}
 
-    hints_reset(jumanji);
+static hints_node_t*
+hints_node_insert(hints_node_t* trie, const char* label, guint32 id)
+{
+  hints_node_t* node = trie;
+  node->count++;
 
-    g_string_free(tag, TRUE);
+  for (const char* key = label; *key != '\0'; key++) {
+    hints_node_t* child = hints_node_child(node, *key);
+    if (child == NULL) {
+      child = hints_node_new(node, *key);
+    }
 
-    return true;
+    node = child;
+    node->count++;
   }
 
-  g_string_free(tag, TRUE);
+  node->id = id + 1;
 
-  return false;
+  return node;
 }
 
-bool
-hints_update(jumanji_t* jumanji, char* input)
+static void
+hints_node_remove(hints_node_t* trie, const char* label)
 {
-  if (jumanji == NULL || input == NULL || jumanji->hints.links == NULL) {
-    return false;
+  /* empty nodes are kept, as the labels of removed hints are reused */
+  hints_node_t* node = trie;
+  for (const char* key = label; *key != '\0' && node != NULL; key++) {
+    node = hints_node_child(node, *key);
   }
 
-  int number_of_hints       = jumanji->hints.links->len;
-  int number_of_letters_max = log(number_of_hints) / log(26) + 1;
+  if (node == NULL || node->id == 0) {
+    return;
+  }
 
-  if (strlen(input) == number_of_letters_max) {
-    int id = 0;
-    for (int i = 0; i < number_of_letters_max; i++) {
-      id += (input[i] - 'a') * pow(26, number_of_letters_max - i - 1);
-    }
+  node->id = 0;
+  for (; node != NULL; node = node->parent) {
+    node->count--;
+  }
+}
 
-    return hints_process(jumanji, id);
-  } else {
-    for (int i = 0; i < number_of_hints; i++)
-    {
-      WebKitDOMNode *hint               = g_ptr_array_index(jumanji->hints.hints, i);
-      WebKitDOMCSSStyleDeclaration *css = webkit_dom_element_get_style(WEBKIT_DOM_ELEMENT(hint));
-
-      gchar* current_text = webkit_dom_html_element_get_inner_text(WEBKIT_DOM_HTML_ELEMENT(hint));
-      if(strncmp(current_text, input, strlen(input)) != 0) {
-        gchar* position = g_strdup("display: none;");
-        webkit_dom_css_style_declaration_set_css_text(css, position, NULL);
-        g_free(position);
-      } else {
-        webkit_dom_html_element_set_inner_text(WEBKIT_DOM_HTML_ELEMENT(hint), current_text + 1, NULL);
-      }
+static hints_node_t*
+hints_node_find(hints_node_t* trie, const char* label)
+{
+  hints_node_t* node = trie;
+  for (const char* key = label; *key != '\0' && node != NULL; key++) {
+    node = hints_node_child(node, *key);
+  }
+
+  return (node != NULL && node->count > 0) ? node : NULL;
+}
 
-      g_free(current_text);
+static bool
+hints_node_is_ancestor(hints_node_t* ancestor, hints_node_t* node)
+{
+  if (ancestor == NULL) {
+    return false;
+  }
+
+  for (; node != NULL; node = node->parent) {
+    if (node == ancestor) {
+      return true;
     }
   }
 
   return false;
 }
 
-void
-hints_reset(jumanji_t* jumanji)
+static void
+hints_node_collect(hints_node_t* node, GArray* ids)
 {
-  if (jumanji == NULL) {
+  if (node == NULL || node->count == 0) {
     return;
   }
 
-  /* clear hints */
-  hints_clear(jumanji);
+  if (node->id != 0) {
+    guint32 id = node->id - 1;
+    g_array_append_val(ids, id);
+  }
 
-  /* clear buffer */
-  if (jumanji->hints.input != NULL) {
-    g_string_free(jumanji->hints.input, TRUE);
-    jumanji->hints.input = NULL;
+  for (hints_node_t* child = node->child; child != NULL; child = child->next) {
+    hints_node_collect(child, ids);
+  }
+}
+
+static void
+hints_node_collect_except(hints_node_t* ancestor, hints_node_t* node, GArray* ids)
+{
+  /* the subtrees next to the path from the node up to the ancestor */
+  for (; node != ancestor; node = node->parent) {
+    hints_node_t* parent = node->parent;
+
+    for (hints_node_t* child = parent->child; child != NULL; child = child->next) {
+      if (child != node) {
+        hints_node_collect(child, ids);
+      }
+    }
+
+    if (parent->id != 0) {
+      guint32 id = parent->id - 1;
+      g_array_append_val(ids, id);
+    }
   }
 }
@@ -29,6 +29,18 @@ bool sc_hints(girara_session_t* session, girara_argument_t* argument, girara_eve
 bool cb_hints_key_press_event_add(GtkWidget* widget, GdkEventKey* event,
     jumanji_t* jumanji);
 
+/**
+ * Handles the messages of the web extension about hints that entered or left
+ * the viewport of the tab that shows the hints
+ *
+ * @param web_view The web view
+ * @param message The message
+ * @param tab The tab
+ * @return true if the message has been handled
+ */
+bool cb_hints_user_message_received(WebKitWebView* web_view,
+    WebKitUserMessage* message, jumanji_tab_t* tab);
+
 /**
  * Displays all hints
  *
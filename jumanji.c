@@ -11,10 +11,16 @@
 
 #include "adblock.h"
 #include "callbacks.h"
+#include "completion.h"
 #include "soup.h"
 #include "config.h"
 #include "database.h"
 #include "download.h"
+#include "cache.h"
+#include "prerender.h"
+#include "websettings.h"
+#include "sites.h"
+#include "hints.h"
 #include "jumanji.h"
 #include "userscripts.h"
 #include "marks.h"
@@ -29,6 +35,33 @@
 #define JUMANJI_QUICKMARKS_FILE      "quickmarks"
 #define JUMANJI_SESSION_DIR          "sessions"
 #define JUMANJI_DEFAULT_SESSION_FILE "default_session"
+#define JUMANJI_STARTUP_THREADS      3
+
+enum { JOB_USER_SCRIPTS, JOB_ADBLOCK_FILTERS, JOB_DATABASE };
+
+struct jumanji_job_s
+{
+  int type; /**> What the job loads */
+  char* path; /**> Path the job loads from */
+  void** result; /**> Location the result is stored to */
+  bool done; /**> true if the job has finished */
+  GMutex lock; /**> Protects the result and the done flag */
+  GCond cond; /**> Signaled once the job has finished */
+  jumanji_t* jumanji; /**> The jumanji session */
+};
+
+/* forward declarations */
+static jumanji_job_t* jumanji_job_new(jumanji_t* jumanji, int type, char* path,
+    void** result);
+static void jumanji_job_run(gpointer data, gpointer user_data);
+static void jumanji_job_wait(jumanji_job_t* job);
+static bool jumanji_job_finished(jumanji_job_t* job);
+static void jumanji_job_free(jumanji_job_t* job);
+static void jumanji_startup_free(jumanji_t* jumanji);
+static gboolean cb_jumanji_adblock_filters_loaded(gpointer data);
+static void jumanji_tab_connect_web_view(jumanji_tab_t* tab);
+static void jumanji_update_schedule(jumanji_t* jumanji);
+static gboolean cb_jumanji_update(gpointer data);
 
 jumanji_t*
 jumanji_init(int argc, char* argv[])
@@ -124,37 +157,51 @@ jumanji_init(int argc, char* argv[])
 
   girara_list_set_free_function(jumanji->global.last_closed, jumanji_last_closed_free);
 
-  /* user scripts */
-  char* user_script_dir = g_build_filename(jumanji->config.config_dir, USER_SCRIPTS_DIR, NULL);
-  jumanji->global.user_scripts = user_script_load_dir(user_script_dir);
-  if (jumanji->global.user_scripts == NULL) {
+  /* user scripts, adblock filters and the database do not depend on each
+   * other nor on gtk, so they are loaded by worker threads while the user
+   * interface is set up */
+  jumanji->startup.pool = g_thread_pool_new(jumanji_job_run, NULL,
+      JUMANJI_STARTUP_THREADS, FALSE, NULL);
+  if (jumanji->startup.pool == NULL) {
     goto error_free;
   }
-  g_free(user_script_dir);
 
-  /* adblock filters */
-  char* adblock_filter_dir = g_build_filename(jumanji->config.config_dir, ADBLOCK_FILTER_LIST_DIR, NULL);
-  jumanji->global.adblock_filters = adblock_filter_load_dir(adblock_filter_dir);
-  if (jumanji->global.adblock_filters == NULL) {
+  jumanji->startup.pending_tabs = girara_list_new();
+  if (jumanji->startup.pending_tabs == NULL) {
     goto error_free;
   }
-  g_free(adblock_filter_dir);
-
-  /* webkit */
-  WebKitWebContext* webctx = webkit_web_context_get_default();
-  webkit_web_context_set_process_model(webctx, WEBKIT_PROCESS_MODEL_MULTIPLE_SECONDARY_PROCESSES);
-  webkit_web_context_set_cache_model(webctx, WEBKIT_CACHE_MODEL_WEB_BROWSER);
 
+  if (jumanji_db_check_location(jumanji->config.config_dir) == true) {
+    girara_warning("Data files have been detected in the old data directory "
+        "%s. Please move them to the new data directory %s.",
+        jumanji->config.config_dir, jumanji->config.data_dir);
+  }
 
-  jumanji->global.browser_settings = webkit_settings_new();
-  if (jumanji->global.browser_settings == NULL) {
+  jumanji->startup.user_scripts = jumanji_job_new(jumanji, JOB_USER_SCRIPTS,
+      g_build_filename(jumanji->config.config_dir, USER_SCRIPTS_DIR, NULL),
+      (void**) &(jumanji->global.user_scripts));
+  jumanji->startup.adblock_filters = jumanji_job_new(jumanji, JOB_ADBLOCK_FILTERS,
+      g_build_filename(jumanji->config.config_dir, ADBLOCK_FILTER_LIST_DIR, NULL),
+      (void**) &(jumanji->global.adblock_filters));
+  jumanji->startup.database = jumanji_job_new(jumanji, JOB_DATABASE,
+      g_strdup(jumanji->config.data_dir), (void**) &(jumanji->database));
+
+  if (jumanji->startup.user_scripts == NULL ||
+      jumanji->startup.adblock_filters == NULL ||
+      jumanji->startup.database == NULL) {
     goto error_free;
   }
 
-  /* init cookies */
-  jumanji->global.soup = jumanji_soup_init(jumanji);
-  if (jumanji->global.soup == NULL) {
-    girara_error("Could not initialize soup.");
+  /* user scripts are registered once for all tabs */
+  jumanji->global.user_content = webkit_user_content_manager_new();
+
+  if (user_script_values_init(jumanji) == false) {
+    girara_error("Could not load the values of the user scripts");
+  }
+
+
+  jumanji->global.browser_settings = webkit_settings_new();
+  if (jumanji->global.browser_settings == NULL) {
     goto error_free;
   }
 
@@ -169,6 +216,23 @@ jumanji_init(int argc, char* argv[])
   config_load_file(jumanji, configuration_file);
   g_free(configuration_file);
 
+  /* webkit; the cache directory is configurable */
+  if (jumanji_cache_init(jumanji) == false) {
+    girara_error("Could not initialize the web context.");
+    goto error_free;
+  }
+
+  webkit_web_context_set_process_model(jumanji->global.web_context, WEBKIT_PROCESS_MODEL_MULTIPLE_SECONDARY_PROCESSES);
+  webkit_web_context_set_web_extensions_directory(jumanji->global.web_context, EXTENSIONDIR);
+  jumanji_settings_spell_checking_apply(jumanji, jumanji->global.web_context);
+
+  /* init cookies, the storage is configurable */
+  jumanji->global.soup = jumanji_soup_init(jumanji);
+  if (jumanji->global.soup == NULL) {
+    girara_error("Could not initialize soup.");
+    goto error_free;
+  }
+
   /* initialize girara */
   if (girara_session_init(jumanji->ui.session, "jumanji") == false) {
     goto error_free;
@@ -193,15 +257,25 @@ jumanji_init(int argc, char* argv[])
 
   girara_list_set_free_function(jumanji->downloads.list, jumanji_download_free);
 
+  if (jumanji_downloads_init(jumanji) == false) {
+    girara_error("Could not initialize the download manager");
+  }
+
   /* enable tabs */
   girara_tabs_enable(jumanji->ui.session);
 
   /* girara events */
   jumanji->ui.session->events.buffer_changed = cb_girara_buffer_changed;
 
+  /* background completion */
+  if (completion_init(jumanji) == false) {
+    goto error_free;
+  }
+
   /* connect additional signals */
   g_signal_connect(G_OBJECT(jumanji->ui.session->gtk.tabs), "switch-page",  G_CALLBACK(cb_jumanji_tab_changed), jumanji);
   g_signal_connect(G_OBJECT(jumanji->ui.session->gtk.tabs), "page-removed", G_CALLBACK(cb_jumanji_tab_removed), jumanji);
+  g_signal_connect(G_OBJECT(jumanji->ui.session->gtk.inputbar_entry), "changed", G_CALLBACK(cb_completion_inputbar_changed), jumanji);
 
   /* statusbar */
   jumanji->ui.statusbar.url = girara_statusbar_item_add(jumanji->ui.session, TRUE, TRUE, TRUE, NULL);
@@ -240,18 +314,17 @@ jumanji_init(int argc, char* argv[])
   }
 
   /* database */
-  if (jumanji_db_check_location(jumanji->config.config_dir) == true) {
-    girara_warning("Data files have been detected in the old data directory "
-        "%s. Please move them to the new data directory %s.",
-        jumanji->config.config_dir, jumanji->config.data_dir);
-  }
-
-  jumanji->database = jumanji_db_init(jumanji->config.data_dir);
+  jumanji_job_wait(jumanji->startup.database);
   if (jumanji->database == NULL) {
     girara_error("Could not initialize database");
     goto error_free;
   }
 
+  /* content rules of the sites */
+  if (jumanji_sites_init(jumanji) == false) {
+    girara_error("Could not load the content rules of the sites");
+  }
+
   /* custom stylesheet */
   char* user_stylesheet_uri = NULL;
   girara_setting_get(jumanji->ui.session, "user-stylesheet-uri", &user_stylesheet_uri);
@@ -309,10 +382,15 @@ jumanji_init(int argc, char* argv[])
 error_free:
 
   if (jumanji != NULL) {
+    completion_free(jumanji);
+    jumanji_startup_free(jumanji);
+
     if (jumanji->ui.session != NULL) {
       girara_session_destroy(jumanji->ui.session);
     }
 
+    jumanji_sites_free(jumanji);
+
     if (jumanji->database != NULL) {
       jumanji_db_free(jumanji->database);
     }
@@ -340,11 +418,25 @@ jumanji_free(jumanji_t* jumanji)
     sessionsave(jumanji->ui.session, JUMANJI_DEFAULT_SESSION_FILE);
   }
 
+  hints_reset(jumanji);
+
+  /* drop pending statusbar and title updates */
+  if (jumanji->ui.update.source != 0) {
+    g_source_remove(jumanji->ui.update.source);
+    jumanji->ui.update.source = 0;
+  }
+
+  g_free(jumanji->ui.update.url);
+  g_free(jumanji->ui.update.shown_url);
+
   /* destroy girara session */
   if (jumanji->ui.session != NULL) {
     girara_session_destroy(jumanji->ui.session);
   }
 
+  /* wait for the startup jobs */
+  jumanji_startup_free(jumanji);
+
   g_free(jumanji->config.config_dir);
   g_free(jumanji->config.data_dir);
 
@@ -362,13 +454,32 @@ jumanji_free(jumanji_t* jumanji)
   girara_list_free(jumanji->global.marks);
 
   /* free user scipts */
+  user_script_values_free(jumanji);
+
+  if (jumanji->global.user_scripts_monitor != NULL) {
+    g_object_unref(jumanji->global.user_scripts_monitor);
+  }
+
   girara_list_free(jumanji->global.user_scripts);
 
+  if (jumanji->global.user_content != NULL) {
+    g_object_unref(jumanji->global.user_content);
+  }
+
   /* free last closed */
   girara_list_free(jumanji->global.last_closed);
 
   /* free downloads */
-  girara_list_free(jumanji->downloads.list);
+  jumanji_downloads_free(jumanji);
+
+  /* cancel completion queries */
+  completion_free(jumanji);
+
+  /* free the hidden web view */
+  prerender_free(jumanji);
+
+  /* free content rules */
+  jumanji_sites_free(jumanji);
 
   /* free database */
   if (jumanji->database) {
@@ -383,14 +494,48 @@ jumanji_free(jumanji_t* jumanji)
   /* free soup */
   jumanji_soup_free(jumanji->global.soup);
 
+  /* free web context */
+  if (jumanji->global.web_context != NULL) {
+    g_object_unref(jumanji->global.web_context);
+  }
+
+  if (jumanji->global.website_data != NULL) {
+    g_object_unref(jumanji->global.website_data);
+  }
+
   /* free adblock filters */
   girara_list_free(jumanji->global.adblock_filters);
 
   g_free(jumanji);
 }
 
+static void
+jumanji_tab_connect_web_view(jumanji_tab_t* tab)
+{
+  g_signal_connect(G_OBJECT(tab->web_view), "mouse-target-changed",
+      G_CALLBACK(cb_jumanji_tab_mouse_target_changed), tab);
+  g_signal_connect(G_OBJECT(tab->web_view), "load-changed",
+      G_CALLBACK(cb_jumanji_tab_load_changed), tab);
+  g_signal_connect(G_OBJECT(tab->web_view), "load-failed",
+      G_CALLBACK(cb_jumanji_tab_load_failed), tab);
+  g_signal_connect(G_OBJECT(tab->web_view), "decide-policy",
+      G_CALLBACK(cb_jumanji_tab_decide_policy), tab);
+  g_signal_connect(G_OBJECT(tab->web_view), "user-message-received",
+      G_CALLBACK(cb_hints_user_message_received), tab);
+  // TODO not implemented yet
+  //g_signal_connect(G_OBJECT(tab->web_view), "hovering-over-link",
+  //    G_CALLBACK(cb_jumanji_tab_hovering_over_link), tab);
+}
+
 jumanji_tab_t*
 jumanji_tab_new(jumanji_t* jumanji, const char* url, bool focus)
+{
+  return jumanji_tab_new_with_proxy(jumanji, url, focus, NULL);
+}
+
+jumanji_tab_t*
+jumanji_tab_new_with_proxy(jumanji_t* jumanji, const char* url, bool focus,
+    jumanji_proxy_t* proxy)
 {
   if (jumanji == NULL || url == NULL) {
     goto error_out;
@@ -403,9 +548,22 @@ jumanji_tab_new(jumanji_t* jumanji, const char* url, bool focus)
     goto error_out;
   }
 
+  WebKitWebContext* context = (proxy != NULL) ? jumanji_proxy_get_context(jumanji, proxy) : NULL;
+
   tab->scrolled_window = gtk_scrolled_window_new(NULL, NULL);
-  tab->web_view        = webkit_web_view_new();
+  tab->web_view        = GTK_WIDGET(g_object_new(WEBKIT_TYPE_WEB_VIEW,
+        "web-context", (context != NULL) ? context : jumanji->global.web_context,
+        "user-content-manager", jumanji->global.user_content,
+        "settings", jumanji->global.browser_settings, NULL));
   tab->jumanji         = jumanji;
+  tab->pending_url     = NULL;
+  tab->proxy           = (context != NULL) ? proxy : NULL;
+  tab->title           = NULL;
+  tab->reload          = false;
+  tab->settings        = NULL;
+  tab->overrides       = NULL;
+  tab->site_overrides  = NULL;
+  tab->site_rules      = 0;
 
   if (tab->scrolled_window == NULL || tab->web_view == NULL) {
     goto error_free;
@@ -420,18 +578,12 @@ jumanji_tab_new(jumanji_t* jumanji, const char* url, bool focus)
   gtk_container_add(GTK_CONTAINER(tab->scrolled_window), tab->web_view);
   gtk_widget_show_all(tab->scrolled_window);
 
-  /* apply browser setting */
-//  webkit_web_view_set_settings(WEBKIT_WEB_VIEW(tab->web_view), webkit_settings_copy(jumanji->global.browser_settings));
-
   /* set web inspector */
   WebKitWebInspector* web_inspector = webkit_web_view_get_inspector(WEBKIT_WEB_VIEW(tab->web_view));
   if (web_inspector != NULL) {
 //    g_signal_connect(G_OBJECT(web_inspector), "inspect-web-view", G_CALLBACK(cb_jumanji_tab_web_inspector), tab);
   }
 
-  /* load url */
-  jumanji_tab_load_url(tab, url);
-
   /* create new tab */
   tab->girara_tab = girara_tab_new(jumanji->ui.session, NULL, tab->scrolled_window, true, jumanji);
 
@@ -447,28 +599,36 @@ jumanji_tab_new(jumanji_t* jumanji, const char* url, bool focus)
   g_signal_connect(G_OBJECT(tab->scrolled_window), "destroy",
       G_CALLBACK(cb_jumanji_tab_destroy), tab);
 
-  g_signal_connect(G_OBJECT(tab->web_view), "mouse-target-changed",
-      G_CALLBACK(cb_jumanji_tab_mouse_target_changed), tab);
-  g_signal_connect(G_OBJECT(tab->web_view), "load-changed",
-      G_CALLBACK(cb_jumanji_tab_load_changed), tab);
-  g_signal_connect(G_OBJECT(tab->web_view), "decide-policy",
-      G_CALLBACK(cb_jumanji_tab_decide_policy), tab);
-  // TODO not implemented yet
-  //g_signal_connect(G_OBJECT(tab->web_view), "hovering-over-link",
-  //    G_CALLBACK(cb_jumanji_tab_hovering_over_link), tab);
-  //g_signal_connect(G_OBJECT(tab->web_view), "download-requested",
-  //    G_CALLBACK(cb_jumanji_tab_download_requested), tab);
+  jumanji_tab_connect_web_view(tab);
 
   /* setup userscripts */
-  user_script_init_tab(tab, jumanji->global.user_scripts);
+  jumanji_job_wait(jumanji->startup.user_scripts);
+  user_script_register(jumanji);
+
+  if (jumanji->global.user_scripts_monitor == NULL) {
+    char* user_scripts_dir = g_build_filename(jumanji->config.config_dir,
+        USER_SCRIPTS_DIR, NULL);
+    user_script_watch(jumanji, user_scripts_dir);
+    g_free(user_scripts_dir);
+  }
 
-  /* setup adblock */
+  /* setup adblock; if the filters are still being loaded the url is loaded
+   * as soon as they are ready */
   bool block_ads = true;
   girara_setting_get(jumanji->ui.session, "adblock", &block_ads);
   if (block_ads == true) {
+    if (jumanji_job_finished(jumanji->startup.adblock_filters) == false) {
+      tab->pending_url = g_strdup(url);
+      girara_list_append(jumanji->startup.pending_tabs, tab);
+      return tab;
+    }
+
     adblock_filter_init_tab(tab, jumanji->global.adblock_filters);
   }
 
+  /* load url */
+  jumanji_tab_load_url(tab, url);
+
   return tab;
 
 error_free:
@@ -480,6 +640,37 @@ error_out:
   return NULL;
 }
 
+void
+jumanji_tab_set_web_view(jumanji_tab_t* tab, GtkWidget* web_view)
+{
+  if (tab == NULL || web_view == NULL || tab->web_view == NULL) {
+    return;
+  }
+
+  if (tab->jumanji != NULL && tab->jumanji->hints.tab == tab) {
+    hints_reset(tab->jumanji);
+  }
+
+  g_signal_handlers_disconnect_by_data(tab->web_view, tab);
+  gtk_container_remove(GTK_CONTAINER(tab->scrolled_window), tab->web_view);
+  g_object_unref(tab->web_view);
+
+  tab->web_view = web_view;
+  gtk_container_add(GTK_CONTAINER(tab->scrolled_window), tab->web_view);
+  gtk_widget_show_all(tab->scrolled_window);
+
+  jumanji_tab_connect_web_view(tab);
+
+  /* the tab still carries the content rules of the previous page */
+  jumanji_tab_sites_apply(tab, webkit_web_view_get_uri(WEBKIT_WEB_VIEW(tab->web_view)));
+  jumanji_tab_settings_apply(tab);
+
+  /* the load events of the web view have been missed */
+  cb_jumanji_tab_load_changed(WEBKIT_WEB_VIEW(tab->web_view),
+      (webkit_web_view_is_loading(WEBKIT_WEB_VIEW(tab->web_view)) == TRUE) ?
+      WEBKIT_LOAD_COMMITTED : WEBKIT_LOAD_FINISHED, tab);
+}
+
 void
 jumanji_tab_free(jumanji_tab_t* tab)
 {
@@ -487,6 +678,18 @@ jumanji_tab_free(jumanji_tab_t* tab)
     return;
   }
 
+  if (tab->pending_url != NULL && tab->jumanji != NULL &&
+      tab->jumanji->startup.pending_tabs != NULL) {
+    girara_list_remove(tab->jumanji->startup.pending_tabs, tab);
+  }
+
+  if (tab->jumanji != NULL && tab->jumanji->hints.tab == tab) {
+    hints_reset(tab->jumanji);
+  }
+
+  g_free(tab->pending_url);
+  g_free(tab->title);
+  jumanji_tab_settings_free(tab);
   g_object_unref(tab->web_view);
   free(tab);
 }
@@ -530,9 +733,108 @@ jumanji_tab_load_url(jumanji_tab_t* tab, const char* url)
     return;
   }
 
+  /* the tab is still waiting for the adblock filters */
+  if (tab->pending_url != NULL) {
+    g_free(tab->pending_url);
+    tab->pending_url = g_strdup(url);
+    return;
+  }
+
   webkit_web_view_load_uri(WEBKIT_WEB_VIEW(tab->web_view), url);
 }
 
+void
+jumanji_tab_update_title(jumanji_tab_t* tab)
+{
+  if (tab == NULL || tab->jumanji == NULL) {
+    return;
+  }
+
+  tab->jumanji->ui.update.titles = true;
+  jumanji_update_schedule(tab->jumanji);
+}
+
+void
+jumanji_statusbar_set_url(jumanji_t* jumanji, const char* url)
+{
+  if (jumanji == NULL) {
+    return;
+  }
+
+  url = (url != NULL) ? url : "Loading...";
+  if (g_strcmp0(jumanji->ui.update.url, url) == 0) {
+    return;
+  }
+
+  g_free(jumanji->ui.update.url);
+  jumanji->ui.update.url = g_strdup(url);
+  jumanji_update_schedule(jumanji);
+}
+
+static void
+jumanji_update_schedule(jumanji_t* jumanji)
+{
+  if (jumanji->ui.update.source != 0) {
+    return;
+  }
+
+  /* runs before gtk lays out and paints the next frame */
+  jumanji->ui.update.source = g_idle_add_full(G_PRIORITY_HIGH_IDLE,
+      cb_jumanji_update, jumanji, NULL);
+}
+
+static gboolean
+cb_jumanji_update(gpointer data)
+{
+  jumanji_t* jumanji = (jumanji_t*) data;
+
+  jumanji->ui.update.source = 0;
+
+  if (jumanji->ui.session == NULL) {
+    return FALSE;
+  }
+
+  /* statusbar */
+  if (jumanji->ui.update.url != NULL) {
+    if (jumanji->ui.statusbar.url != NULL &&
+        g_strcmp0(jumanji->ui.update.url, jumanji->ui.update.shown_url) != 0) {
+      girara_statusbar_item_set_text(jumanji->ui.session, jumanji->ui.statusbar.url,
+          jumanji->ui.update.url);
+      g_free(jumanji->ui.update.shown_url);
+      jumanji->ui.update.shown_url = jumanji->ui.update.url;
+    } else {
+      g_free(jumanji->ui.update.url);
+    }
+    jumanji->ui.update.url = NULL;
+  }
+
+  /* tab titles; they include the position of the tab */
+  if (jumanji->ui.update.titles == true) {
+    jumanji->ui.update.titles = false;
+
+    int number_of_tabs = girara_get_number_of_tabs(jumanji->ui.session);
+    for (int i = 0; i < number_of_tabs; i++) {
+      jumanji_tab_t* tab = jumanji_tab_get_nth(jumanji, i);
+      if (tab == NULL || tab->girara_tab == NULL || tab->web_view == NULL) {
+        continue;
+      }
+
+      const gchar* title = webkit_web_view_get_title(WEBKIT_WEB_VIEW(tab->web_view));
+      char* text = g_strdup_printf("%d | %s", i + 1, title ? title : "Loading...");
+
+      if (g_strcmp0(text, tab->title) != 0) {
+        girara_tab_title_set(tab->girara_tab, text);
+        g_free(tab->title);
+        tab->title = text;
+      } else {
+        g_free(text);
+      }
+    }
+  }
+
+  return FALSE;
+}
+
 void
 jumanji_tab_show_search_results(jumanji_tab_t* tab)
 {
@@ -735,11 +1037,174 @@ jumanji_proxy_free(void* data)
 
   jumanji_proxy_t* proxy = (jumanji_proxy_t*) data;
 
+  if (proxy->context != NULL) {
+    g_object_unref(proxy->context);
+  }
+
   g_free(proxy->description);
   g_free(proxy->url);
   g_free(proxy);
 }
 
+static jumanji_job_t*
+jumanji_job_new(jumanji_t* jumanji, int type, char* path, void** result)
+{
+  if (jumanji == NULL || jumanji->startup.pool == NULL || path == NULL) {
+    g_free(path);
+    return NULL;
+  }
+
+  jumanji_job_t* job = g_malloc0(sizeof(jumanji_job_t));
+
+  job->type    = type;
+  job->path    = path;
+  job->result  = result;
+  job->done    = false;
+  job->jumanji = jumanji;
+
+  g_mutex_init(&(job->lock));
+  g_cond_init(&(job->cond));
+
+  if (g_thread_pool_push(jumanji->startup.pool, job, NULL) == FALSE) {
+    jumanji_job_free(job);
+    return NULL;
+  }
+
+  return job;
+}
+
+static void
+jumanji_job_run(gpointer data, gpointer user_data)
+{
+  jumanji_job_t* job = (jumanji_job_t*) data;
+  void* result       = NULL;
+
+  switch (job->type) {
+    case JOB_USER_SCRIPTS:
+      result = user_script_load_dir(job->path);
+      break;
+    case JOB_ADBLOCK_FILTERS:
+      result = adblock_filter_load_dir(job->path);
+      break;
+    case JOB_DATABASE:
+      result = jumanji_db_init(job->path);
+      break;
+  }
+
+  g_mutex_lock(&(job->lock));
+  *(job->result) = result;
+  job->done      = true;
+  g_cond_broadcast(&(job->cond));
+  g_mutex_unlock(&(job->lock));
+
+  /* tabs that have been waiting for the filters are set up on the main
+   * thread */
+  if (job->type == JOB_ADBLOCK_FILTERS) {
+    g_idle_add(cb_jumanji_adblock_filters_loaded, job->jumanji);
+  }
+}
+
+static void
+jumanji_job_wait(jumanji_job_t* job)
+{
+  if (job == NULL) {
+    return;
+  }
+
+  g_mutex_lock(&(job->lock));
+  while (job->done == false) {
+    g_cond_wait(&(job->cond), &(job->lock));
+  }
+  g_mutex_unlock(&(job->lock));
+}
+
+static bool
+jumanji_job_finished(jumanji_job_t* job)
+{
+  if (job == NULL) {
+    return true;
+  }
+
+  g_mutex_lock(&(job->lock));
+  bool done = job->done;
+  g_mutex_unlock(&(job->lock));
+
+  return done;
+}
+
+static void
+jumanji_job_free(jumanji_job_t* job)
+{
+  if (job == NULL) {
+    return;
+  }
+
+  g_mutex_clear(&(job->lock));
+  g_cond_clear(&(job->cond));
+  g_free(job->path);
+  g_free(job);
+}
+
+static void
+jumanji_startup_free(jumanji_t* jumanji)
+{
+  /* wait until all queued jobs have been processed */
+  if (jumanji->startup.pool != NULL) {
+    g_thread_pool_free(jumanji->startup.pool, FALSE, TRUE);
+    jumanji->startup.pool = NULL;
+  }
+
+  jumanji_job_free(jumanji->startup.user_scripts);
+  jumanji_job_free(jumanji->startup.adblock_filters);
+  jumanji_job_free(jumanji->startup.database);
+
+  jumanji->startup.user_scripts    = NULL;
+  jumanji->startup.adblock_filters = NULL;
+  jumanji->startup.database        = NULL;
+
+  if (jumanji->startup.pending_tabs != NULL) {
+    girara_list_free(jumanji->startup.pending_tabs);
+    jumanji->startup.pending_tabs = NULL;
+  }
+}
+
+static gboolean
+cb_jumanji_adblock_filters_loaded(gpointer data)
+{
+  jumanji_t* jumanji = (jumanji_t*) data;
+
+  if (jumanji->startup.pending_tabs == NULL) {
+    return FALSE;
+  }
+
+  /* the list is detached first, so that jumanji_tab_load_url does not defer
+   * the urls again */
+  girara_list_t* pending_tabs   = jumanji->startup.pending_tabs;
+  jumanji->startup.pending_tabs = NULL;
+
+  if (girara_list_size(pending_tabs) > 0) {
+    girara_list_iterator_t* iter = girara_list_iterator(pending_tabs);
+    do {
+      jumanji_tab_t* tab = (jumanji_tab_t*) girara_list_iterator_data(iter);
+      if (tab == NULL) {
+        continue;
+      }
+
+      adblock_filter_init_tab(tab, jumanji->global.adblock_filters);
+
+      char* url        = tab->pending_url;
+      tab->pending_url = NULL;
+      jumanji_tab_load_url(tab, url);
+      g_free(url);
+    } while (girara_list_iterator_next(iter));
+    girara_list_iterator_free(iter);
+  }
+
+  girara_list_free(pending_tabs);
+
+  return FALSE;
+}
+
 /* main function */
 int main(int argc, char* argv[])
 {
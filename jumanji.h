@@ -8,7 +8,6 @@
 #include <gtk/gtk.h>
 
 #include <webkit2/webkit2.h>
-#include <webkitdom/webkitdomdefines.h>
 
 enum { LEFT, RIGHT, UP, DOWN, FULL_UP, FULL_DOWN, HALF_UP, HALF_DOWN, TOP,
   BOTTOM, BEGIN, END, ZOOM_IN, ZOOM_OUT, DEFAULT, ZOOM_SPECIFIC, APPEND_URL,
@@ -18,9 +17,12 @@ typedef struct jumanji_proxy_s
 {
   char* url; /**> Url */
   char* description; /**> Description (optional) */
+  WebKitWebContext* context; /**> Context of the tabs that only use this proxy */
 } jumanji_proxy_t;
 
 typedef struct jumanji_database_s jumanji_database_t;
+typedef struct jumanji_job_s jumanji_job_t;
+typedef struct jumanji_completion_query_s jumanji_completion_query_t;
 
 typedef struct jumanji_s
 {
@@ -35,6 +37,14 @@ typedef struct jumanji_s
       girara_statusbar_item_t* tabs; /**> tabs statusbar entry */
       girara_statusbar_item_t* proxy; /**> proxy statusbar entry */
     } statusbar;
+
+    struct
+    {
+      char* url; /**> Text of the url entry that is not shown yet */
+      char* shown_url; /**> Text that is shown in the url entry */
+      bool titles; /**> True if the tab titles have to be updated */
+      guint source; /**> Shows the pending updates before the next frame */
+    } update;
   } ui;
 
   struct
@@ -42,6 +52,7 @@ typedef struct jumanji_s
     gchar* config_dir; /**> Path to the configuration directory */
     gchar* data_dir; /**> Path to the data directory */
     gchar* session_dir; /**> Path to the sessions directory */
+    bool loading; /**> True while a configuration file is parsed */
   } config;
 
   struct
@@ -51,7 +62,9 @@ typedef struct jumanji_s
 
   struct
   {
-    WebKitSettings* browser_settings; /*>> Browser settings */
+    WebKitSettings* browser_settings; /*>> Browser settings shared by all tabs */
+    WebKitWebContext* web_context; /**> Web context of the tabs */
+    WebKitWebsiteDataManager* website_data; /**> Caches and website data of the web context */
     gchar* user_stylesheet_uri;
     girara_list_t* search_engines; /**> Search engines */
     girara_list_t* proxies; /**> Proxies */
@@ -59,7 +72,11 @@ typedef struct jumanji_s
     girara_list_t* last_closed; /**> Last closed tabs */
     jumanji_proxy_t* current_proxy; /**> Current proxy */
     girara_list_t* user_scripts; /**> User scripts */
+    WebKitUserContentManager* user_content; /**> User content shared by all tabs */
+    GFileMonitor* user_scripts_monitor; /**> Watches the user script directory */
+    struct user_script_values_s* user_script_values; /**> Values stored by user scripts */
     girara_list_t* adblock_filters; /**> Adblock filters */
+    GHashTable* sites; /**> Content rules by host */
     girara_list_t* sessions; /**> Sessions */
     char** arguments; /**> Arguments that were passed at startup */
     int quickmark_open_mode; /**> How to open a quickmark */
@@ -67,24 +84,60 @@ typedef struct jumanji_s
   } global;
 
 
+  struct
+  {
+    GThreadPool* pool; /**> Worker threads running the startup jobs */
+    jumanji_job_t* user_scripts; /**> Job loading the user scripts */
+    jumanji_job_t* adblock_filters; /**> Job loading the adblock filters */
+    jumanji_job_t* database; /**> Job opening the database */
+    girara_list_t* pending_tabs; /**> Tabs waiting for the adblock filters */
+  } startup;
+
+  struct
+  {
+    GThreadPool* pool; /**> Worker threads running the completion queries */
+    jumanji_completion_query_t* query; /**> Latest completion query */
+  } completion;
+
   struct
   {
     char* item; /**> Search item */
   } search;
 
+  struct
+  {
+    GtkWidget* web_view; /**> Hidden web view that loads the candidate */
+    char* uri; /**> Uri of the candidate, NULL if nothing is loaded */
+    guint64 received; /**> Bytes received for the candidate */
+    unsigned int generation; /**> Changes whenever a candidate is started or dropped */
+    guint debounce; /**> Starts loading the candidate */
+    guint expire; /**> Drops the candidate if it is not used */
+  } prerender;
+
   struct
   {
     girara_list_t* list; /**> List of downloads */
     GtkWidget* widget; /**> Download widget */
+    SoupSession* session; /**> Session that transfers the downloads */
+    unsigned int running; /**> Number of running downloads */
+    guint progress_source; /**> Redraws the progress of the running downloads */
+    char* file; /**> Path of the file that stores the download queue */
   } downloads;
 
   struct
   {
-    GPtrArray *links; /**> List of links */
-    GPtrArray *hints; /**> List of hint dom elements */
-    int        open_mode; /**> Open mode */
-    WebKitDOMNode *hint_style; /**> Dom style node */
-    WebKitDOMNode *hint_box; /**> Dom element node */
+    GPtrArray* labels; /**> Hint labels by hint id, NULL for removed hints */
+    GPtrArray* unused; /**> Labels of removed hints that can be reused */
+    struct hints_node_s* trie; /**> Trie over the labels */
+    struct hints_node_s* node; /**> Trie node of the input, NULL if no label matches */
+    GArray* positions; /**> Centres of the hints in the viewport by hint id */
+    char* alphabet; /**> Letters of the labels */
+    bool followed; /**> True if a hint has been followed */
+    int followed_x; /**> X coordinate of the last followed hint */
+    int followed_y; /**> Y coordinate of the last followed hint */
+    int open_mode; /**> Open mode */
+    struct jumanji_tab_s* tab; /**> Tab that shows the hints */
+    GCancellable* cancellable; /**> Cancels collecting the hints */
     GString* input; /**> Input buffer */
   } hints;
 
@@ -97,6 +150,14 @@ typedef struct jumanji_tab_s
   GtkWidget* web_view; /**> Webkit webview */
   girara_tab_t* girara_tab; /** The girara tab */
   jumanji_t* jumanji; /**> The jumanji session */
+  char* pending_url; /**> Url that is loaded once the adblock filters are ready */
+  jumanji_proxy_t* proxy; /**> Proxy of the tab, NULL if it uses the global one */
+  char* title; /**> Title that is shown in the tab */
+  bool reload; /**> True if the tab is reloaded once the configuration is parsed */
+  WebKitSettings* settings; /**> Copy of the shared settings with the overrides, NULL if there are none */
+  GHashTable* overrides; /**> Names of the overridden settings */
+  GHashTable* site_overrides; /**> Names of the overridden settings that were set by the content rules */
+  unsigned int site_rules; /**> Content rules of the site that are applied to the tab */
 } jumanji_tab_t;
 
 typedef struct jumanji_search_engine_s
@@ -131,6 +192,27 @@ void jumanji_free(jumanji_t* jumanji);
  */
 jumanji_tab_t* jumanji_tab_new(jumanji_t* jumanji, const char* url, bool focus);
 
+/**
+ * Creates a new tab that connects through the given proxy only. It runs in
+ * the ephemeral web context of that proxy.
+ *
+ * @param jumanji The jumanji session
+ * @param url URL of the site that should be loaded
+ * @param focus true if the tab should be focused after creation
+ * @param proxy The proxy or NULL to use the global proxy
+ * @return The webkit widget or NULL if an error occured
+ */
+jumanji_tab_t* jumanji_tab_new_with_proxy(jumanji_t* jumanji, const char* url,
+    bool focus, jumanji_proxy_t* proxy);
+
+/**
+ * Replaces the web view of a tab
+ *
+ * @param tab The tab
+ * @param web_view The new web view; the tab takes over the reference
+ */
+void jumanji_tab_set_web_view(jumanji_tab_t* tab, GtkWidget* web_view);
+
 /**
  * Frees and destroys a tab
  *
@@ -163,6 +245,24 @@ jumanji_tab_t* jumanji_tab_get_nth(jumanji_t* jumanji, unsigned int index);
  */
 void jumanji_tab_load_url(jumanji_tab_t* tab, const char* url);
 
+/**
+ * Updates the title of the tab. Like the url entry of the statusbar the
+ * title is only redrawn once before the next frame and only if its text
+ * has changed.
+ *
+ * @param tab The tab
+ */
+void jumanji_tab_update_title(jumanji_tab_t* tab);
+
+/**
+ * Sets the text of the url entry of the statusbar. Repeated calls within a
+ * frame, e.g. while the mouse is moved across links, are coalesced.
+ *
+ * @param jumanji The jumanji session
+ * @param url The text, NULL while a page is loading
+ */
+void jumanji_statusbar_set_url(jumanji_t* jumanji, const char* url);
+
 /**
  * Show search results based on the latest search item in the tab
  *
@@ -0,0 +1,291 @@
+/* See LICENSE file for license and copyright information */
+
+#include <stdlib.h>
+#include <string.h>
+#include <girara/session.h>
+#include <girara/settings.h>
+#include <girara/utils.h>
+
+#include "prerender.h"
+#include "completion.h"
+#include "sites.h"
+
+#define PRERENDER_GENERATION "jumanji-prerender-generation"
+
+static void prerender_start(jumanji_t* jumanji, const char* uri);
+static gboolean cb_prerender_debounce(gpointer data);
+static gboolean cb_prerender_expired(gpointer data);
+static bool cb_prerender_decide_policy(WebKitWebView* web_view,
+    WebKitPolicyDecision* decision, WebKitPolicyDecisionType type, jumanji_t* jumanji);
+static bool cb_prerender_script_dialog(WebKitWebView* web_view,
+    WebKitScriptDialog* dialog, jumanji_t* jumanji);
+static void cb_prerender_resource_load_started(WebKitWebView* web_view,
+    WebKitWebResource* resource, WebKitURIRequest* request, jumanji_t* jumanji);
+static void cb_prerender_received_data(WebKitWebResource* resource,
+    guint64 data_length, jumanji_t* jumanji);
+
+void
+prerender_schedule(jumanji_t* jumanji)
+{
+  if (jumanji == NULL || jumanji->ui.session == NULL) {
+    return;
+  }
+
+  if (jumanji->prerender.debounce != 0) {
+    g_source_remove(jumanji->prerender.debounce);
+    jumanji->prerender.debounce = 0;
+  }
+
+  bool prerender = false;
+  girara_setting_get(jumanji->ui.session, "prerender", &prerender);
+  if (prerender == false) {
+    return;
+  }
+
+  jumanji->prerender.debounce = g_timeout_add(PRERENDER_DEBOUNCE,
+      cb_prerender_debounce, jumanji);
+}
+
+bool
+prerender_take(jumanji_t* jumanji, jumanji_tab_t* tab, const char* uri)
+{
+  if (jumanji == NULL || tab == NULL || uri == NULL ||
+      jumanji->prerender.web_view == NULL || jumanji->prerender.uri == NULL) {
+    return false;
+  }
+
+  /* tabs with a proxy of their own use another web context */
+  if (g_strcmp0(jumanji->prerender.uri, uri) != 0 || tab->proxy != NULL ||
+      tab->pending_url != NULL) {
+    return false;
+  }
+
+  GtkWidget* web_view = jumanji->prerender.web_view;
+
+  g_signal_handlers_disconnect_by_data(web_view, jumanji);
+
+  if (jumanji->prerender.expire != 0) {
+    g_source_remove(jumanji->prerender.expire);
+    jumanji->prerender.expire = 0;
+  }
+
+  g_free(jumanji->prerender.uri);
+  jumanji->prerender.uri      = NULL;
+  jumanji->prerender.web_view = NULL;
+  jumanji->prerender.generation++;
+
+  /* the tab takes over the reference */
+  jumanji_tab_set_web_view(tab, web_view);
+
+  return true;
+}
+
+void
+prerender_discard(jumanji_t* jumanji)
+{
+  if (jumanji == NULL) {
+    return;
+  }
+
+  if (jumanji->prerender.expire != 0) {
+    g_source_remove(jumanji->prerender.expire);
+    jumanji->prerender.expire = 0;
+  }
+
+  if (jumanji->prerender.uri == NULL) {
+    return;
+  }
+
+  g_free(jumanji->prerender.uri);
+  jumanji->prerender.uri = NULL;
+  jumanji->prerender.generation++;
+
+  if (jumanji->prerender.web_view != NULL) {
+    webkit_web_view_stop_loading(WEBKIT_WEB_VIEW(jumanji->prerender.web_view));
+    webkit_web_view_load_uri(WEBKIT_WEB_VIEW(jumanji->prerender.web_view), "about:blank");
+  }
+}
+
+void
+prerender_free(jumanji_t* jumanji)
+{
+  if (jumanji == NULL) {
+    return;
+  }
+
+  if (jumanji->prerender.debounce != 0) {
+    g_source_remove(jumanji->prerender.debounce);
+    jumanji->prerender.debounce = 0;
+  }
+
+  if (jumanji->prerender.expire != 0) {
+    g_source_remove(jumanji->prerender.expire);
+    jumanji->prerender.expire = 0;
+  }
+
+  if (jumanji->prerender.web_view != NULL) {
+    g_signal_handlers_disconnect_by_data(jumanji->prerender.web_view, jumanji);
+    g_object_unref(jumanji->prerender.web_view);
+    jumanji->prerender.web_view = NULL;
+  }
+
+  g_free(jumanji->prerender.uri);
+  jumanji->prerender.uri = NULL;
+}
+
+static void
+prerender_start(jumanji_t* jumanji, const char* uri)
+{
+  if (g_strcmp0(jumanji->prerender.uri, uri) == 0) {
+    return;
+  }
+
+  /* the web view is kept for the next candidate until a tab takes it */
+  if (jumanji->prerender.web_view == NULL) {
+    GtkWidget* web_view = GTK_WIDGET(g_object_new(WEBKIT_TYPE_WEB_VIEW,
+          "web-context", jumanji->global.web_context,
+          "user-content-manager", jumanji->global.user_content,
+          "settings", jumanji->global.browser_settings, NULL));
+    if (web_view == NULL) {
+      return;
+    }
+
+    g_object_ref_sink(web_view);
+
+    g_signal_connect(G_OBJECT(web_view), "decide-policy",
+        G_CALLBACK(cb_prerender_decide_policy), jumanji);
+    g_signal_connect(G_OBJECT(web_view), "script-dialog",
+        G_CALLBACK(cb_prerender_script_dialog), jumanji);
+    g_signal_connect(G_OBJECT(web_view), "resource-load-started",
+        G_CALLBACK(cb_prerender_resource_load_started), jumanji);
+
+    jumanji->prerender.web_view = web_view;
+  }
+
+  prerender_discard(jumanji);
+
+  jumanji->prerender.uri      = g_strdup(uri);
+  jumanji->prerender.received = 0;
+  jumanji->prerender.expire   = g_timeout_add_seconds(PRERENDER_TIMEOUT,
+      cb_prerender_expired, jumanji);
+
+  webkit_web_view_load_uri(WEBKIT_WEB_VIEW(jumanji->prerender.web_view), uri);
+}
+
+static gboolean
+cb_prerender_debounce(gpointer data)
+{
+  jumanji_t* jumanji = (jumanji_t*) data;
+
+  /* wait for the query of the latest input */
+  char* uri = NULL;
+  if (completion_query_candidate(jumanji, &uri) == false) {
+    return TRUE;
+  }
+
+  jumanji->prerender.debounce = 0;
+
+  if (uri == NULL) {
+    return FALSE;
+  }
+
+  /* a metered connection is not spent on pages that may never be opened */
+  GNetworkMonitor* monitor = g_network_monitor_get_default();
+  if (monitor != NULL && g_network_monitor_get_network_metered(monitor) == TRUE) {
+    g_free(uri);
+    return FALSE;
+  }
+
+  /* the hidden web view uses the shared settings, the content rules of a
+   * site only apply to a tab */
+  unsigned int rules = 0;
+  SoupURI* soup_uri  = soup_uri_new(uri);
+  if (soup_uri != NULL) {
+    rules = jumanji_sites_lookup(jumanji, soup_uri->host);
+    soup_uri_free(soup_uri);
+  }
+
+  if (rules != 0) {
+    g_free(uri);
+    return FALSE;
+  }
+
+  prerender_start(jumanji, uri);
+  g_free(uri);
+
+  return FALSE;
+}
+
+static gboolean
+cb_prerender_expired(gpointer data)
+{
+  jumanji_t* jumanji = (jumanji_t*) data;
+
+  jumanji->prerender.expire = 0;
+  prerender_discard(jumanji);
+
+  return FALSE;
+}
+
+static bool
+cb_prerender_decide_policy(WebKitWebView* web_view, WebKitPolicyDecision* decision,
+    WebKitPolicyDecisionType type, jumanji_t* jumanji)
+{
+  /* a candidate never downloads anything or opens windows */
+  if (type == WEBKIT_POLICY_DECISION_TYPE_RESPONSE) {
+    WebKitURIResponse* response = webkit_response_policy_decision_get_response(
+        WEBKIT_RESPONSE_POLICY_DECISION(decision));
+    if (webkit_web_view_can_show_mime_type(web_view,
+          webkit_uri_response_get_mime_type(response)) != TRUE) {
+      webkit_policy_decision_ignore(decision);
+      prerender_discard(jumanji);
+      return true;
+    }
+  } else if (type == WEBKIT_POLICY_DECISION_TYPE_NEW_WINDOW_ACTION) {
+    webkit_policy_decision_ignore(decision);
+    return true;
+  }
+
+  return false;
+}
+
+static bool
+cb_prerender_script_dialog(WebKitWebView* web_view, WebKitScriptDialog* dialog,
+    jumanji_t* jumanji)
+{
+  /* dialogs of a hidden page are dismissed */
+  return true;
+}
+
+static void
+cb_prerender_resource_load_started(WebKitWebView* web_view,
+    WebKitWebResource* resource, WebKitURIRequest* request, jumanji_t* jumanji)
+{
+  /* resources can outlive the candidate they have been loaded for */
+  g_object_set_data(G_OBJECT(resource), PRERENDER_GENERATION,
+      GUINT_TO_POINTER(jumanji->prerender.generation));
+
+  g_signal_connect(G_OBJECT(resource), "received-data",
+      G_CALLBACK(cb_prerender_received_data), jumanji);
+}
+
+static void
+cb_prerender_received_data(WebKitWebResource* resource, guint64 data_length,
+    jumanji_t* jumanji)
+{
+  unsigned int generation = GPOINTER_TO_UINT(g_object_get_data(G_OBJECT(resource),
+        PRERENDER_GENERATION));
+  if (generation != jumanji->prerender.generation || jumanji->prerender.uri == NULL) {
+    g_signal_handlers_disconnect_by_data(resource, jumanji);
+    return;
+  }
+
+  jumanji->prerender.received += data_length;
+
+  int budget = 0;
+  girara_setting_get(jumanji->ui.session, "prerender-budget", &budget);
+  if (budget > 0 && jumanji->prerender.received > (guint64) budget * 1024) {
+    girara_debug("Prerender of %s exceeded its budget", jumanji->prerender.uri);
+    prerender_discard(jumanji);
+  }
+}
@@ -0,0 +1,48 @@
+/* See LICENSE file for license and copyright information */
+
+#ifndef PRERENDER_H
+#define PRERENDER_H
+
+#include "jumanji.h"
+
+#define PRERENDER_DEBOUNCE 300 /* milliseconds */
+#define PRERENDER_TIMEOUT 30 /* seconds */
+
+/**
+ * Restarts the debounce timer of the speculative load. Once the input of an
+ * open command has not changed for PRERENDER_DEBOUNCE milliseconds and only
+ * a single link matches it, the link is loaded in a hidden web view.
+ *
+ * Nothing is loaded if the prerender setting is disabled, if the network
+ * is metered or if the site has content rules. A load is stopped once it received more than prerender-budget
+ * KiB and discarded if it is not used within PRERENDER_TIMEOUT seconds.
+ *
+ * @param jumanji The jumanji session
+ */
+void prerender_schedule(jumanji_t* jumanji);
+
+/**
+ * Moves the hidden web view into the tab if it has loaded the given uri
+ *
+ * @param jumanji The jumanji session
+ * @param tab The tab
+ * @param uri The uri that should be opened in the tab
+ * @return true if the web view has been moved into the tab
+ */
+bool prerender_take(jumanji_t* jumanji, jumanji_tab_t* tab, const char* uri);
+
+/**
+ * Stops the speculative load and keeps the web view for the next one
+ *
+ * @param jumanji The jumanji session
+ */
+void prerender_discard(jumanji_t* jumanji);
+
+/**
+ * Frees the hidden web view
+ *
+ * @param jumanji The jumanji session
+ */
+void prerender_free(jumanji_t* jumanji);
+
+#endif // PRERENDER_H
@@ -0,0 +1,180 @@
+/* See LICENSE file for license and copyright information */
+
+#include <stdlib.h>
+#include <string.h>
+#include <girara/datastructures.h>
+#include <girara/utils.h>
+
+#include "sites.h"
+#include "database.h"
+#include "websettings.h"
+
+typedef struct jumanji_site_setting_s
+{
+  unsigned int rule; /**> Content rule */
+  const char* name; /**> Name of the rule */
+  const char* setting; /**> Webkit setting that implements the rule */
+  const char* value; /**> Value of the setting while the rule applies */
+} jumanji_site_setting_t;
+
+static const jumanji_site_setting_t site_settings[] = {
+  { JUMANJI_SITE_NO_IMAGES,   "images",   "auto-load-images",                    "false" },
+  { JUMANJI_SITE_NO_SCRIPTS,  "scripts",  "enable-javascript",                   "false" },
+  { JUMANJI_SITE_NO_AUTOPLAY, "autoplay", "media-playback-requires-user-gesture", "true" },
+  { JUMANJI_SITE_NO_MEDIA,    "media",    "enable-media",                        "false" }
+};
+
+bool
+jumanji_sites_init(jumanji_t* jumanji)
+{
+  if (jumanji == NULL || jumanji->database == NULL) {
+    return false;
+  }
+
+  jumanji->global.sites = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  girara_list_t* sites = jumanji_db_site_list(jumanji->database);
+  if (sites == NULL) {
+    return false;
+  }
+
+  if (girara_list_size(sites) > 0) {
+    girara_list_iterator_t* iter = girara_list_iterator(sites);
+    do {
+      jumanji_db_site_t* site = (jumanji_db_site_t*) girara_list_iterator_data(iter);
+      if (site == NULL || site->host == NULL || site->rules == 0) {
+        continue;
+      }
+
+      g_hash_table_replace(jumanji->global.sites, g_ascii_strdown(site->host, -1),
+          GUINT_TO_POINTER(site->rules));
+    } while (girara_list_iterator_next(iter) != NULL);
+    girara_list_iterator_free(iter);
+  }
+
+  girara_list_free(sites);
+
+  return true;
+}
+
+void
+jumanji_sites_free(jumanji_t* jumanji)
+{
+  if (jumanji == NULL || jumanji->global.sites == NULL) {
+    return;
+  }
+
+  g_hash_table_destroy(jumanji->global.sites);
+  jumanji->global.sites = NULL;
+}
+
+bool
+jumanji_sites_set(jumanji_t* jumanji, const char* host, unsigned int rules)
+{
+  if (jumanji == NULL || jumanji->global.sites == NULL || host == NULL || host[0] == '\0') {
+    return false;
+  }
+
+  char* key = g_ascii_strdown(host, -1);
+
+  jumanji_db_site_set(jumanji->database, key, rules);
+
+  if (rules != 0) {
+    g_hash_table_replace(jumanji->global.sites, key, GUINT_TO_POINTER(rules));
+  } else {
+    g_hash_table_remove(jumanji->global.sites, key);
+    g_free(key);
+  }
+
+  return true;
+}
+
+unsigned int
+jumanji_sites_lookup(jumanji_t* jumanji, const char* host)
+{
+  if (jumanji == NULL || jumanji->global.sites == NULL || host == NULL ||
+      g_hash_table_size(jumanji->global.sites) == 0) {
+    return 0;
+  }
+
+  /* www.example.com, example.com, com */
+  const char* suffix = host;
+  while (suffix != NULL && suffix[0] != '\0') {
+    gpointer rules = NULL;
+    if (g_hash_table_lookup_extended(jumanji->global.sites, suffix, NULL, &rules) == TRUE) {
+      return GPOINTER_TO_UINT(rules);
+    }
+
+    suffix = strchr(suffix, '.');
+    if (suffix != NULL) {
+      suffix++;
+    }
+  }
+
+  return 0;
+}
+
+bool
+jumanji_sites_parse_rule(const char* name, unsigned int* rule)
+{
+  if (name == NULL || rule == NULL) {
+    return false;
+  }
+
+  for (unsigned int i = 0; i < G_N_ELEMENTS(site_settings); i++) {
+    if (g_strcmp0(site_settings[i].name, name) == 0) {
+      *rule = site_settings[i].rule;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void
+jumanji_tab_sites_apply(jumanji_tab_t* tab, const char* uri)
+{
+  if (tab == NULL || tab->jumanji == NULL || uri == NULL) {
+    return;
+  }
+
+  unsigned int rules = 0;
+  if (tab->jumanji->global.sites != NULL &&
+      g_hash_table_size(tab->jumanji->global.sites) > 0) {
+    SoupURI* soup_uri = soup_uri_new(uri);
+    if (soup_uri != NULL) {
+      rules = jumanji_sites_lookup(tab->jumanji, soup_uri->host);
+      soup_uri_free(soup_uri);
+    }
+  }
+
+  if (rules == tab->site_rules) {
+    return;
+  }
+
+  for (unsigned int i = 0; i < G_N_ELEMENTS(site_settings); i++) {
+    const jumanji_site_setting_t* setting = &(site_settings[i]);
+    bool applied = (tab->site_rules & setting->rule) != 0;
+    bool applies = (rules & setting->rule) != 0;
+
+    if (applied == applies) {
+      continue;
+    }
+
+    if (applies == true) {
+      /* an override of the user wins over the rules of the site */
+      if (jumanji_tab_settings_overridden(tab, setting->setting) == true ||
+          jumanji_tab_settings_override(tab, setting->setting, setting->value) == false) {
+        rules &= ~setting->rule;
+      } else {
+        g_hash_table_add(tab->site_overrides, g_strdup(setting->setting));
+      }
+    } else if (tab->site_overrides != NULL &&
+        g_hash_table_contains(tab->site_overrides, setting->setting) == TRUE) {
+      /* the user may have overridden the setting since */
+      jumanji_tab_settings_reset(tab, setting->setting);
+    }
+  }
+
+  tab->site_rules = rules;
+}
@@ -0,0 +1,72 @@
+/* See LICENSE file for license and copyright information */
+
+#ifndef SITES_H
+#define SITES_H
+
+#include "jumanji.h"
+
+typedef enum jumanji_site_rule_e
+{
+  JUMANJI_SITE_NO_IMAGES   = 1 << 0, /**> Do not load images */
+  JUMANJI_SITE_NO_SCRIPTS  = 1 << 1, /**> Disable javascript */
+  JUMANJI_SITE_NO_AUTOPLAY = 1 << 2, /**> Only play media after a user gesture */
+  JUMANJI_SITE_NO_MEDIA    = 1 << 3  /**> Disable audio and video */
+} jumanji_site_rule_t;
+
+/**
+ * Loads the content rules of the sites from the database
+ *
+ * @param jumanji The jumanji session
+ * @return true if no error occured
+ */
+bool jumanji_sites_init(jumanji_t* jumanji);
+
+/**
+ * Frees the content rules of the sites
+ *
+ * @param jumanji The jumanji session
+ */
+void jumanji_sites_free(jumanji_t* jumanji);
+
+/**
+ * Changes the content rules of a host and stores them in the database. The
+ * rules also apply to all subdomains of the host.
+ *
+ * @param jumanji The jumanji session
+ * @param host The host
+ * @param rules The rules; 0 removes the host
+ * @return true if no error occured
+ */
+bool jumanji_sites_set(jumanji_t* jumanji, const char* host, unsigned int rules);
+
+/**
+ * Looks up the content rules of a host. The rules of the longest matching
+ * suffix apply, e.g. a rule for www.example.com wins over one for
+ * example.com.
+ *
+ * @param jumanji The jumanji session
+ * @param host The host
+ * @return The rules, 0 if there are none
+ */
+unsigned int jumanji_sites_lookup(jumanji_t* jumanji, const char* host);
+
+/**
+ * Parses the name of a content rule, i.e. images, scripts, autoplay or media
+ *
+ * @param name The name
+ * @param rule Receives the rule
+ * @return false if the name is unknown
+ */
+bool jumanji_sites_parse_rule(const char* name, unsigned int* rule);
+
+/**
+ * Applies the content rules of the host of an uri to a tab. Settings the
+ * user overrides for the tab are left alone, the rules only reset the
+ * settings they changed themselves.
+ *
+ * @param tab The tab
+ * @param uri The uri that is going to be loaded
+ */
+void jumanji_tab_sites_apply(jumanji_tab_t* tab, const char* uri);
+
+#endif // SITES_H
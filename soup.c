@@ -1,22 +1,33 @@
 /* See LICENSE file for license and copyright information */
 
 #include <stdlib.h>
+#include <glib/gstdio.h>
 #include <girara/girara.h>
 
 #include <webkit2/webkit2.h>
 
 #include "soup.h"
+#include "download.h"
+#include "websettings.h"
 
 struct jumanji_soup_s
 {
   WebKitWebContext* web_context;
   WebKitCookieManager* cookie_manager;
+  GHashTable* prefetched; /**> Monotonic time of the last prefetch by host */
+  gint64 prefetch_window; /**> Start of the current rate limit window */
+  unsigned int prefetch_count; /**> Prefetches in the current window */
 };
 
+static void jumanji_soup_migrate_cookies(WebKitCookieManager* cookie_manager, const char* text_file);
+static void jumanji_proxy_apply(WebKitWebContext* context, jumanji_proxy_t* proxy);
+static gboolean jumanji_prefetch_expired(gpointer key, gpointer value, gpointer data);
+
 jumanji_soup_t*
 jumanji_soup_init(jumanji_t* jumanji)
 {
-  if (jumanji == NULL || jumanji->config.config_dir == NULL) {
+  if (jumanji == NULL || jumanji->config.config_dir == NULL ||
+      jumanji->config.data_dir == NULL) {
     return NULL;
   }
 
@@ -25,7 +36,7 @@ jumanji_soup_init(jumanji_t* jumanji)
     return NULL;
   }
 
-  soup->web_context= webkit_web_context_get_default();
+  soup->web_context = jumanji->global.web_context;
   if (soup->web_context == NULL) {
     free(soup);
     return NULL;
@@ -37,17 +48,56 @@ jumanji_soup_init(jumanji_t* jumanji)
     return NULL;
   }
 
-  char* cookie_file = g_build_filename(jumanji->config.config_dir,
-      JUMANJI_COOKIE_FILE, NULL);
-  if (cookie_file == NULL) {
+  char* storage = NULL;
+  girara_setting_get(jumanji->ui.session, "cookie-storage", &storage);
+  bool text_storage = g_strcmp0(storage, "text") == 0;
+  if (storage != NULL && text_storage == false && g_strcmp0(storage, "sqlite") != 0) {
+    girara_warning("Unknown cookie storage '%s', using sqlite", storage);
+  }
+  g_free(storage);
+
+  char* text_file = g_build_filename(jumanji->config.data_dir, JUMANJI_COOKIE_FILE, NULL);
+  char* old_file  = g_build_filename(jumanji->config.config_dir, JUMANJI_COOKIE_FILE, NULL);
+  if (text_file == NULL || old_file == NULL) {
+    g_free(text_file);
+    g_free(old_file);
     free(soup);
     return NULL;
   }
 
-  webkit_cookie_manager_set_persistent_storage(soup->cookie_manager, cookie_file,
-      WEBKIT_COOKIE_PERSISTENT_STORAGE_TEXT);
+  /* the text file used to be stored in the configuration directory */
+  if (g_strcmp0(text_file, old_file) != 0 &&
+      g_file_test(old_file, G_FILE_TEST_EXISTS) == TRUE &&
+      g_file_test(text_file, G_FILE_TEST_EXISTS) == FALSE) {
+    if (g_rename(old_file, text_file) != 0) {
+      girara_warning("Could not move %s to %s", old_file, text_file);
+    }
+  }
+  g_free(old_file);
+
+  if (text_storage == true) {
+    webkit_cookie_manager_set_persistent_storage(soup->cookie_manager, text_file,
+        WEBKIT_COOKIE_PERSISTENT_STORAGE_TEXT);
+  } else {
+    char* database_file = g_build_filename(jumanji->config.data_dir, JUMANJI_COOKIE_DATABASE, NULL);
+    bool migrate = g_file_test(text_file, G_FILE_TEST_EXISTS) == TRUE &&
+      g_file_test(database_file, G_FILE_TEST_EXISTS) == FALSE;
+
+    webkit_cookie_manager_set_persistent_storage(soup->cookie_manager, database_file,
+        WEBKIT_COOKIE_PERSISTENT_STORAGE_SQLITE);
+
+    if (migrate == true) {
+      jumanji_soup_migrate_cookies(soup->cookie_manager, text_file);
+    }
+
+    g_free(database_file);
+  }
+
+  g_free(text_file);
 
-  g_free(cookie_file);
+  soup->prefetched      = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  soup->prefetch_window = 0;
+  soup->prefetch_count  = 0;
 
   return soup;
 }
@@ -59,9 +109,40 @@ jumanji_soup_free(jumanji_soup_t* soup)
     return;
   }
 
+  if (soup->prefetched != NULL) {
+    g_hash_table_destroy(soup->prefetched);
+  }
+
   free(soup);
 }
 
+static void
+jumanji_soup_migrate_cookies(WebKitCookieManager* cookie_manager, const char* text_file)
+{
+  SoupCookieJar* jar = soup_cookie_jar_text_new(text_file, TRUE);
+  if (jar == NULL) {
+    return;
+  }
+
+  GSList* cookies = soup_cookie_jar_all_cookies(jar);
+  for (GSList* cookie = cookies; cookie != NULL; cookie = g_slist_next(cookie)) {
+    webkit_cookie_manager_add_cookie(cookie_manager, (SoupCookie*) cookie->data,
+        NULL, NULL, NULL);
+  }
+
+  girara_info("Imported %u cookies from %s", g_slist_length(cookies), text_file);
+
+  soup_cookies_free(cookies);
+  g_object_unref(jar);
+
+  /* keep the text file, but never import it again */
+  char* migrated_file = g_strconcat(text_file, JUMANJI_COOKIE_MIGRATED_SUFFIX, NULL);
+  if (g_rename(text_file, migrated_file) != 0) {
+    girara_warning("Could not move %s to %s", text_file, migrated_file);
+  }
+  g_free(migrated_file);
+}
+
 void
 jumanji_proxy_set(jumanji_t* jumanji, jumanji_proxy_t* proxy)
 {
@@ -72,17 +153,142 @@ jumanji_proxy_set(jumanji_t* jumanji, jumanji_proxy_t* proxy)
   jumanji_soup_t* soup = (jumanji_soup_t*) jumanji->global.soup;
 
   if (proxy != NULL && proxy->url != NULL) {
-    SoupURI* soup_uri = soup_uri_new(proxy->url);
-    //g_object_set(soup->session, "proxy-uri", soup_uri, NULL);
-    soup_uri_free(soup_uri);
+    jumanji_proxy_apply(soup->web_context, proxy);
     jumanji->global.current_proxy = proxy;
 
     char* text = (proxy->description != NULL) ? proxy->description : proxy->url;
     girara_statusbar_item_set_text(jumanji->ui.session, jumanji->ui.statusbar.proxy, text);
   } else {
-    //g_object_set(soup->session, "proxy-uri", NULL, NULL);
+    jumanji_proxy_apply(soup->web_context, NULL);
     jumanji->global.current_proxy = NULL;
 
     girara_statusbar_item_set_text(jumanji->ui.session, jumanji->ui.statusbar.proxy, "Proxy disabled");
   }
+
+  /* downloads go through the same proxy as the pages */
+  if (jumanji->downloads.session != NULL) {
+    GProxyResolver* resolver = (jumanji->global.current_proxy != NULL) ?
+      g_simple_proxy_resolver_new(jumanji->global.current_proxy->url, NULL) :
+      g_object_ref(g_proxy_resolver_get_default());
+    g_object_set(jumanji->downloads.session, "proxy-resolver", resolver, NULL);
+    g_object_unref(resolver);
+  }
+}
+
+void
+jumanji_prefetch_dns(jumanji_t* jumanji, const char* uri)
+{
+  if (jumanji == NULL || jumanji->global.soup == NULL || uri == NULL) {
+    return;
+  }
+
+  /* with a proxy the host is resolved by the proxy */
+  if (jumanji->global.current_proxy != NULL) {
+    return;
+  }
+
+  bool prefetch = true;
+  girara_setting_get(jumanji->ui.session, "dns-prefetch", &prefetch);
+  if (prefetch == false) {
+    return;
+  }
+
+  jumanji_soup_t* soup = (jumanji_soup_t*) jumanji->global.soup;
+
+  SoupURI* soup_uri = soup_uri_new(uri);
+  if (soup_uri == NULL) {
+    return;
+  }
+
+  if (soup_uri->host == NULL || (soup_uri->scheme != SOUP_URI_SCHEME_HTTP &&
+        soup_uri->scheme != SOUP_URI_SCHEME_HTTPS)) {
+    soup_uri_free(soup_uri);
+    return;
+  }
+
+  gint64 now   = g_get_monotonic_time();
+  gint64* last = (gint64*) g_hash_table_lookup(soup->prefetched, soup_uri->host);
+  if (last != NULL && now - *last < JUMANJI_PREFETCH_INTERVAL) {
+    soup_uri_free(soup_uri);
+    return;
+  }
+
+  if (now - soup->prefetch_window >= G_TIME_SPAN_SECOND) {
+    soup->prefetch_window = now;
+    soup->prefetch_count  = 0;
+  }
+
+  if (soup->prefetch_count >= JUMANJI_PREFETCH_RATE) {
+    soup_uri_free(soup_uri);
+    return;
+  }
+
+  soup->prefetch_count++;
+
+  if (g_hash_table_size(soup->prefetched) >= JUMANJI_PREFETCH_HOSTS) {
+    g_hash_table_foreach_remove(soup->prefetched, jumanji_prefetch_expired, &now);
+  }
+
+  gint64* time = g_new(gint64, 1);
+  *time        = now;
+  g_hash_table_replace(soup->prefetched, g_strdup(soup_uri->host), time);
+
+  webkit_web_context_prefetch_dns(soup->web_context, soup_uri->host);
+
+  soup_uri_free(soup_uri);
+}
+
+WebKitWebContext*
+jumanji_proxy_get_context(jumanji_t* jumanji, jumanji_proxy_t* proxy)
+{
+  if (jumanji == NULL || proxy == NULL || proxy->url == NULL) {
+    return NULL;
+  }
+
+  if (proxy->context != NULL) {
+    return proxy->context;
+  }
+
+  /* the context only exists in memory and shares no cookies or cache with
+   * the other tabs */
+  proxy->context = webkit_web_context_new_ephemeral();
+  if (proxy->context == NULL) {
+    return NULL;
+  }
+
+  webkit_web_context_set_process_model(proxy->context, WEBKIT_PROCESS_MODEL_MULTIPLE_SECONDARY_PROCESSES);
+  webkit_web_context_set_cache_model(proxy->context, WEBKIT_CACHE_MODEL_WEB_BROWSER);
+  webkit_web_context_set_web_extensions_directory(proxy->context, EXTENSIONDIR);
+  jumanji_settings_spell_checking_apply(jumanji, proxy->context);
+
+  g_signal_connect(G_OBJECT(proxy->context), "download-started",
+      G_CALLBACK(cb_jumanji_download_started), jumanji);
+
+  jumanji_proxy_apply(proxy->context, proxy);
+
+  return proxy->context;
+}
+
+static gboolean
+jumanji_prefetch_expired(gpointer key, gpointer value, gpointer data)
+{
+  gint64 time = *(gint64*) value;
+  gint64 now  = *(gint64*) data;
+
+  return (now - time >= JUMANJI_PREFETCH_INTERVAL) ? TRUE : FALSE;
+}
+
+static void
+jumanji_proxy_apply(WebKitWebContext* context, jumanji_proxy_t* proxy)
+{
+  if (proxy == NULL || proxy->url == NULL) {
+    webkit_web_context_set_network_proxy_settings(context,
+        WEBKIT_NETWORK_PROXY_MODE_DEFAULT, NULL);
+    return;
+  }
+
+  WebKitNetworkProxySettings* settings = webkit_network_proxy_settings_new(proxy->url, NULL);
+  webkit_web_context_set_network_proxy_settings(context,
+      WEBKIT_NETWORK_PROXY_MODE_CUSTOM, settings);
+  webkit_network_proxy_settings_free(settings);
 }
@@ -6,12 +6,20 @@
 #include "jumanji.h"
 
 #define JUMANJI_COOKIE_FILE "cookies"
+#define JUMANJI_COOKIE_DATABASE "cookies.sqlite"
+#define JUMANJI_COOKIE_MIGRATED_SUFFIX ".migrated"
+#define JUMANJI_PREFETCH_INTERVAL (5 * G_TIME_SPAN_MINUTE) /* per host */
+#define JUMANJI_PREFETCH_RATE 4 /* per second */
+#define JUMANJI_PREFETCH_HOSTS 256
 
 typedef struct jumanji_soup_s jumanji_soup_t;
 
 
 /**
- * Initializes the soup session for cookie support
+ * Initializes the soup session for cookie support. Depending on the
+ * cookie-storage setting the cookies are stored in a SQLite database or in a
+ * text file in the data directory. A text file of an older version is
+ * imported into the database once.
  *
  * @param jumanji The jumanji session
  * @return Soup session object or NULL
@@ -26,11 +34,33 @@ jumanji_soup_t* jumanji_soup_init(jumanji_t* jumanji);
 void jumanji_soup_free(jumanji_soup_t* soup);
 
 /**
- * Activates a jumanji proxy
+ * Activates a jumanji proxy for all tabs that do not use a proxy of their
+ * own and for the downloads. Passing NULL restores the system settings.
  *
  * @param jumanji The jumanji session
  * @param proxy The jumanji proxy
  */
 void jumanji_proxy_set(jumanji_t* jumanji, jumanji_proxy_t* proxy);
 
+/**
+ * Resolves the host of the uri in advance, so that a following navigation
+ * does not wait for DNS. A host is resolved at most once every
+ * JUMANJI_PREFETCH_INTERVAL and at most JUMANJI_PREFETCH_RATE hosts are
+ * resolved per second. Nothing is resolved while a proxy is active.
+ *
+ * @param jumanji The jumanji session
+ * @param uri The uri
+ */
+void jumanji_prefetch_dns(jumanji_t* jumanji, const char* uri);
+
+/**
+ * Returns the web context of tabs that only use the given proxy. It is
+ * created on first use and is ephemeral.
+ *
+ * @param jumanji The jumanji session
+ * @param proxy The jumanji proxy
+ * @return The web context or NULL if an error occured
+ */
+WebKitWebContext* jumanji_proxy_get_context(jumanji_t* jumanji, jumanji_proxy_t* proxy);
+
 #endif // COOKIES_H
@@ -1,131 +1,143 @@
 /* See LICENSE file for license and copyright information */
 
+#include <stdio.h>
 #include <stdlib.h>
-#include <JavaScriptCore/JavaScript.h>
+#include <string.h>
 
 #include "userscripts.h"
 #include <girara/datastructures.h>
 #include <girara/utils.h>
+#include <girara/session.h>
+#include <girara/tabs.h>
 
 #define USER_SCRIPT_HEADER ".*//.*(==UserScript==.*//.*==/UserScript==).*"
 #define USER_SCRIPT_VAR_VAL_PAIR "//\\s+@(?<name>\\S+)(\\s+(?<value>.*))?"
+#define USER_SCRIPT_VALUES_FILE "userscript-values"
+#define USER_SCRIPT_VALUES_FLUSH_INTERVAL 1
+#define USER_SCRIPT_TOKEN_SIZE 16
+#define USER_SCRIPT_URL_PATTERN "^((\\*|[^*:/]+)://(\\*|(\\*\\.)?[^*:/]+)|file://)(/.*)$"
 
-/* GreaseMonkey's GM_functions by Jim Tuttle (C) 2009
+struct user_script_values_s
+{
+  GKeyFile* values; /**> Stored values grouped by script name */
+  char* path; /**> Path of the file the values are stored in */
+  GHashTable* changed; /**> Names of the scripts whose values changed */
+  guint flush_source; /**> Source of the pending write, 0 if none */
+  bool writing; /**> True while the values are written */
+  GCancellable* cancellable; /**> Cancels the write in flight */
+};
+
+static char* user_script_glob_to_regex(const char* glob);
+static char* user_script_globs_to_regex(girara_list_t* globs);
+static GRegex* user_script_compile(girara_list_t* globs);
+static char** user_script_url_patterns(girara_list_t* globs, bool widen,
+    bool* exact);
+static WebKitUserScript* user_script_bundle(user_script_t* user_script,
+    GKeyFile* values);
+static void user_script_append_string(GString* source, const char* text);
+static user_script_t* user_script_find(girara_list_t* user_scripts, const char* path);
+static void user_script_content_reset(jumanji_t* jumanji);
+static char* user_script_message_get_string(JSCValue* message, const char* property);
+static char* user_script_token_new(void);
+static gboolean cb_user_script_values_flush(gpointer data);
+static void user_script_values_write(user_script_values_t* values, bool async);
+static void cb_user_script_values_written(GObject* source, GAsyncResult* result,
+    gpointer data);
+
+/* GM_ functions of every script; GM_script, GM_token and GM_values are defined in
+ * front of them. GM_xmlhttpRequest, GM_addStyle and GM_log are based on
+ * GreaseMonkey's GM_functions by Jim Tuttle (C) 2009
  * http://userscripts.org/scripts/show/41441
  */
 static const char* gm_functions =
-"// ==UserScript=="
-"// @name           gm_functions"
-"// @namespace      *"
-"// @description    Replicated GreaseMonkey's GM_ functions for GreaseKit."
-"// @include        *"
-"// @exclude       "
-"// ==/UserScript=="
-""
-"/*"
-"  History:"
-"  1.0   2009/01/30  Initial release, based on other people's posts at http://groups.google.com/group/greasekit-users/,"
-"                    so they deserve the credit"
-"  1.0.1 2009/03/08  Changed the way GM_addStyle and GM_log are defined, as it they simply didn't work."
-"                    Thanks to \"samuel365\" for pointing this out."
-"*/"
-""
-"if(typeof GM_getValue === \"undefined\") {"
-"  GM_getValue = function(name){"
-"    var nameEQ = escape(\"_greasekit\" + name) + \"=\", ca = document.cookie.split(';');"
-"    for (var i = 0, c; i < ca.length; i++) {"
-"      var c = ca[i];"
-"      while (c.charAt(0) == ' ') c = c.substring(1, c.length);"
-"      if (c.indexOf(nameEQ) == 0) {"
-"        var value = unescape(c.substring(nameEQ.length, c.length));"
-"        //alert(name + \": \" + value);"
-"        return value;"
-"      }"
-"    }"
-"    return null;"
-"  }"
-"}"
-""
-"if(typeof GM_setValue === \"undefined\") {"
-"  GM_setValue = function( name, value, options ){"
-"    options = (options || {});"
-"    if ( options.expiresInOneYear ){"
-"      var today = new Date();"
-"      today.setFullYear(today.getFullYear()+1, today.getMonth, today.getDay());"
-"      options.expires = today;"
-"    }"
-"    var curCookie = escape(\"_greasekit\" + name) + \"=\" + escape(value) +"
-"    ((options.expires) ? \"; expires=\" + options.expires.toGMTString() : \"\") +"
-"    ((options.path)    ? \"; path=\"    + options.path : \"\") +"
-"    ((options.domain)  ? \"; domain=\"  + options.domain : \"\") +"
-"    ((options.secure)  ? \"; secure\" : \"\");"
-"    document.cookie = curCookie;"
-"  }"
-"}"
-""
-"if(typeof GM_xmlhttpRequest === \"undefined\") {"
-"  GM_xmlhttpRequest = function(/* object */ details) {"
-"    details.method = details.method.toUpperCase() || \"GET\";"
-"    if(!details.url) {"
-"      throw(\"GM_xmlhttpRequest requires an URL.\");"
-"      return;"
-"    }"
-"    // build XMLHttpRequest object"
-"    var oXhr, aAjaxes = [];"
-"    if(typeof ActiveXObject !== \"undefined\") {"
-"      var oCls = ActiveXObject;"
-"      aAjaxes[aAjaxes.length] = {cls:oCls, arg:\"Microsoft.XMLHTTP\"};"
-"      aAjaxes[aAjaxes.length] = {cls:oCls, arg:\"Msxml2.XMLHTTP\"};"
-"      aAjaxes[aAjaxes.length] = {cls:oCls, arg:\"Msxml2.XMLHTTP.3.0\"};"
-"    }"
-"    if(typeof XMLHttpRequest !== \"undefined\")"
-"      aAjaxes[aAjaxes.length] = {cls:XMLHttpRequest, arg:undefined};"
-"    for (var i=aAjaxes.length; i--; )"
-"      try{"
-"  oXhr = new aAjaxes[i].cls(aAjaxes[i].arg);"
-"  if(oXhr) break;"
-"      } catch(e) {}"
-"    // run it"
-"    if(oXhr) {"
-"      if(\"onreadystatechange\" in details)"
-"  oXhr.onreadystatechange = function()"
-"    { details.onreadystatechange(oXhr) };"
-"      if(\"onload\" in details)"
-"  oXhr.onload = function() { details.onload(oXhr) };"
-"      if(\"onerror\" in details)"
-"  oXhr.onerror = function() { details.onerror(oXhr) };"
-"      oXhr.open(details.method, details.url, true);"
-"      if(\"headers\" in details)"
-"  for (var header in details.headers)"
-"    oXhr.setRequestHeader(header, details.headers[header]);"
-"      if(\"data\" in details)"
-"  oXhr.send(details.data);"
-"      else"
-"  oXhr.send();"
-"    }"
-"    else {"
-"      throw (\"This Browser is not supported, please upgrade.\");"
-"    }"
-"  }"
-"}"
-""
-"if(typeof GM_addStyle === \"undefined\") {"
-"  GM_addStyle = function(/* String */ styles) {"
-"    var oStyle = document.createElement(\"style\");"
-"    oStyle.setAttribute(\"type\", \"text/css\");"
-"    oStyle.appendChild(document.createTextNode(styles));"
-"    document.getElementsByTagName(\"head\")[0].appendChild(oStyle);"
-"  }"
-"}"
-""
-"if(typeof GM_log === \"undefined\") {"
-"  GM_log = function(log) {"
-"    if(console)"
-"      console.log(log);"
-"    else"
-"      alert(log);"
-"  }"
-"}";
+"function GM_getValue(name, default_value) {\n"
+"  if (!(String(name) in GM_values)) {\n"
+"    return default_value;\n"
+"  }\n"
+"\n"
+"  try {\n"
+"    return JSON.parse(GM_values[String(name)]);\n"
+"  } catch (e) {\n"
+"    return default_value;\n"
+"  }\n"
+"}\n"
+"\n"
+"function GM_setValue(name, value) {\n"
+"  var json = JSON.stringify(value);\n"
+"  if (json === undefined) {\n"
+"    GM_deleteValue(name);\n"
+"    return;\n"
+"  }\n"
+"\n"
+"  GM_values[String(name)] = json;\n"
+"  GM_post(String(name), json);\n"
+"}\n"
+"\n"
+"function GM_deleteValue(name) {\n"
+"  delete GM_values[String(name)];\n"
+"  GM_post(String(name), undefined);\n"
+"}\n"
+"\n"
+"function GM_listValues() {\n"
+"  return Object.keys(GM_values);\n"
+"}\n"
+"\n"
+"/* values are stored by the browser, the page itself only keeps a copy;\n"
+" * the token of the script proves that a message has been sent by it. The\n"
+" * message is an object literal, whose properties are defined rather than\n"
+" * assigned, so setters the page put on Object.prototype never see it */\n"
+"var GM_handler = (window.webkit && window.webkit.messageHandlers) ?\n"
+"  window.webkit.messageHandlers.jumanji : undefined;\n"
+"\n"
+"function GM_post(name, value) {\n"
+"  if (GM_handler) {\n"
+"    GM_handler.postMessage({ script: GM_script, token: GM_token, name: name,\n"
+"      value: value });\n"
+"  }\n"
+"}\n"
+"\n"
+"function GM_xmlhttpRequest(details) {\n"
+"  if (!details.url) {\n"
+"    throw \"GM_xmlhttpRequest requires an URL.\";\n"
+"  }\n"
+"\n"
+"  var request = new XMLHttpRequest();\n"
+"\n"
+"  if (\"onreadystatechange\" in details) {\n"
+"    request.onreadystatechange = function() { details.onreadystatechange(request); };\n"
+"  }\n"
+"  if (\"onload\" in details) {\n"
+"    request.onload = function() { details.onload(request); };\n"
+"  }\n"
+"  if (\"onerror\" in details) {\n"
+"    request.onerror = function() { details.onerror(request); };\n"
+"  }\n"
+"\n"
+"  request.open((details.method || \"GET\").toUpperCase(), details.url, true);\n"
+"\n"
+"  if (\"headers\" in details) {\n"
+"    for (var header in details.headers) {\n"
+"      request.setRequestHeader(header, details.headers[header]);\n"
+"    }\n"
+"  }\n"
+"\n"
+"  if (\"data\" in details) {\n"
+"    request.send(details.data);\n"
+"  } else {\n"
+"    request.send();\n"
+"  }\n"
+"}\n"
+"\n"
+"function GM_addStyle(styles) {\n"
+"  var style = document.createElement(\"style\");\n"
+"  style.setAttribute(\"type\", \"text/css\");\n"
+"  style.appendChild(document.createTextNode(styles));\n"
+"  (document.head || document.documentElement).appendChild(style);\n"
+"}\n"
+"\n"
+"function GM_log(log) {\n"
+"  console.log(log);\n"
+"}\n";
 
 girara_list_t*
 user_script_load_dir(const char* path)
@@ -221,17 +233,13 @@ user_script_load_file(const char* path)
       } else if (g_strcmp0(header_name, "description") == 0) {
         description = g_strdup(header_value);
       } else if (g_strcmp0(header_name, "include") == 0) {
-        /* update url for further processing */
-        GRegex* regex = g_regex_new("\\*", 0, 0, NULL);
-        char* tmp = g_regex_replace(regex, header_value, -1, 0, ".*", 0, NULL);
-        girara_list_append(include, tmp);
-        g_regex_unref(regex);
+        if (header_value != NULL && *header_value != '\0') {
+          girara_list_append(include, g_strdup(header_value));
+        }
       } else if (g_strcmp0(header_name, "exclude") == 0) {
-        /* update url for further processing */
-        GRegex* regex = g_regex_new("\\*", 0, 0, NULL);
-        char* tmp = g_regex_replace(regex, header_value, -1, 0, ".*", 0, NULL);
-        girara_list_append(exclude, tmp);
-        g_regex_unref(regex);
+        if (header_value != NULL && *header_value != '\0') {
+          girara_list_append(exclude, g_strdup(header_value));
+        }
       } else if (g_strcmp0(header_name, "run-at") == 0) {
         if (g_strcmp0(header_value, "document-start") == 0) {
           load_on_document_start = true;
@@ -260,6 +268,11 @@ user_script_load_file(const char* path)
   g_regex_unref(regex);
   g_match_info_free(match_info);
 
+  /* values are stored by the name of the script */
+  if (name == NULL) {
+    name = g_path_get_basename(path);
+  }
+
   /* create user script object */
   user_script_t* user_script = malloc(sizeof(user_script_t));
   if (user_script == NULL) {
@@ -275,6 +288,14 @@ user_script_load_file(const char* path)
   user_script->include                = include;
   user_script->exclude                = exclude;
   user_script->load_on_document_start = load_on_document_start;
+  user_script->script                 = NULL;
+  user_script->path                   = g_strdup(path);
+  user_script->token                  = user_script_token_new();
+
+  /* the patterns are compiled once, matching an uri is a single regex match
+   * per list */
+  user_script->include_regex = user_script_compile(include);
+  user_script->exclude_regex = user_script_compile(exclude);
 
   return user_script;
 }
@@ -291,154 +312,725 @@ user_script_free(void* data)
   free(user_script->name);
   free(user_script->description);
   free(user_script->content);
+  g_free(user_script->path);
+  g_free(user_script->token);
+
+  girara_list_free(user_script->include);
+  girara_list_free(user_script->exclude);
+
+  if (user_script->script != NULL) {
+    webkit_user_script_unref(user_script->script);
+  }
+
+  if (user_script->include_regex != NULL) {
+    g_regex_unref(user_script->include_regex);
+  }
+
+  if (user_script->exclude_regex != NULL) {
+    g_regex_unref(user_script->exclude_regex);
+  }
 
   /* free object */
   free(user_script);
 }
 
+bool
+user_script_matches(user_script_t* user_script, const char* uri)
+{
+  if (user_script == NULL || uri == NULL) {
+    return false;
+  }
+
+  if (user_script->exclude_regex != NULL &&
+      g_regex_match(user_script->exclude_regex, uri, 0, NULL) == TRUE) {
+    return false;
+  }
+
+  /* scripts without include patterns apply to every uri */
+  return (user_script->include_regex == NULL ||
+      g_regex_match(user_script->include_regex, uri, 0, NULL) == TRUE);
+}
+
 void
-user_script_inject(WebKitWebView* web_view, user_script_t* user_script)
+user_script_register(jumanji_t* jumanji)
 {
-  if (user_script == NULL) {
+  if (jumanji == NULL || jumanji->global.user_content == NULL ||
+      jumanji->global.user_scripts == NULL ||
+      girara_list_size(jumanji->global.user_scripts) == 0) {
     return;
   }
 
-  user_script_inject_text(web_view, user_script->content);
+  GKeyFile* values = (jumanji->global.user_script_values != NULL) ?
+    jumanji->global.user_script_values->values : NULL;
+
+  girara_list_iterator_t* iter = girara_list_iterator(jumanji->global.user_scripts);
+  do {
+    user_script_t* user_script = (user_script_t*) girara_list_iterator_data(iter);
+    if (user_script == NULL || user_script->script != NULL) {
+      continue;
+    }
+
+    user_script->script = user_script_bundle(user_script, values);
+    webkit_user_content_manager_add_script(jumanji->global.user_content,
+        user_script->script);
+  } while (girara_list_iterator_next(iter));
+  girara_list_iterator_free(iter);
+}
+
+bool
+user_script_values_init(jumanji_t* jumanji)
+{
+  if (jumanji == NULL || jumanji->config.data_dir == NULL ||
+      jumanji->global.user_content == NULL) {
+    return false;
+  }
+
+  user_script_values_t* values = g_malloc0(sizeof(user_script_values_t));
+
+  values->values  = g_key_file_new();
+  values->path    = g_build_filename(jumanji->config.data_dir, USER_SCRIPT_VALUES_FILE, NULL);
+  values->changed = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  values->cancellable = g_cancellable_new();
+
+  /* a missing file just means that no values have been stored yet */
+  g_key_file_load_from_file(values->values, values->path, G_KEY_FILE_NONE, NULL);
+
+  jumanji->global.user_script_values = values;
+
+  /* scripts send their changes through a script message handler */
+  if (webkit_user_content_manager_register_script_message_handler(
+        jumanji->global.user_content, "jumanji") == FALSE) {
+    girara_error("could not register the user script message handler");
+    return false;
+  }
+
+  g_signal_connect(G_OBJECT(jumanji->global.user_content),
+      "script-message-received::jumanji",
+      G_CALLBACK(cb_user_script_message_received), jumanji);
+
+  return true;
 }
 
 void
-user_script_inject_text(WebKitWebView* web_view, const char* text)
+user_script_values_free(jumanji_t* jumanji)
 {
-#if 0
-  if (web_view == NULL || text == NULL) {
+  if (jumanji == NULL || jumanji->global.user_script_values == NULL) {
     return;
   }
 
-  WebKitWebFrame* frame = webkit_web_view_get_main_frame(web_view);
+  user_script_values_t* values = jumanji->global.user_script_values;
 
-  if (frame == NULL) {
-    return;
+  /* a write in flight is cancelled and waited for, so that it neither
+   * replaces the file after the final write nor outlives the values */
+  bool pending = (values->flush_source != 0 || values->writing == true);
+
+  if (values->flush_source != 0) {
+    g_source_remove(values->flush_source);
   }
 
-  JSContextRef context = webkit_web_frame_get_global_context(frame);
+  g_cancellable_cancel(values->cancellable);
+  while (values->writing == true) {
+    g_main_context_iteration(NULL, TRUE);
+  }
 
-  if (context == NULL) {
-    return;
+  /* pending changes are written before exiting */
+  if (pending == true) {
+    user_script_values_write(values, false);
   }
 
-  JSObjectRef object = JSContextGetGlobalObject(context);
+  g_object_unref(values->cancellable);
+  g_key_file_free(values->values);
+  g_hash_table_destroy(values->changed);
+  g_free(values->path);
+  g_free(values);
 
-  if (object == NULL) {
+  jumanji->global.user_script_values = NULL;
+}
+
+void
+cb_user_script_message_received(WebKitUserContentManager* user_content,
+    WebKitJavascriptResult* result, jumanji_t* jumanji)
+{
+  if (result == NULL || jumanji == NULL || jumanji->global.user_script_values == NULL) {
     return;
   }
 
-  JSStringRef script = JSStringCreateWithUTF8CString(text);
+  user_script_values_t* values = jumanji->global.user_script_values;
 
-  if (script == NULL) {
+  JSCValue* message = webkit_javascript_result_get_js_value(result);
+  if (jsc_value_is_object(message) == FALSE) {
     return;
   }
 
-  JSEvaluateScript(context, script, object, NULL, 0, NULL);
-  JSStringRelease(script);
-#endif
+  char* script = user_script_message_get_string(message, "script");
+  char* name   = user_script_message_get_string(message, "name");
+  char* value  = user_script_message_get_string(message, "value");
+  char* token  = user_script_message_get_string(message, "token");
+  char* group  = NULL;
+  char* key    = NULL;
+
+  if (script == NULL || name == NULL || token == NULL) {
+    goto error_free;
+  }
+
+  /* every page can post to the handler, so only messages that carry the
+   * token of a loaded script are accepted */
+  bool known = false;
+  if (jumanji->global.user_scripts != NULL && girara_list_size(jumanji->global.user_scripts) > 0) {
+    girara_list_iterator_t* iter = girara_list_iterator(jumanji->global.user_scripts);
+    do {
+      user_script_t* user_script = (user_script_t*) girara_list_iterator_data(iter);
+      if (user_script != NULL && g_strcmp0(user_script->name, script) == 0 &&
+          user_script->token != NULL && g_strcmp0(user_script->token, token) == 0) {
+        known = true;
+        break;
+      }
+    } while (girara_list_iterator_next(iter));
+    girara_list_iterator_free(iter);
+  }
+
+  if (known == false) {
+    girara_warning("Rejected a value of user script %s without its token", script);
+    goto error_free;
+  }
+
+  /* group and key names are escaped, as key files do not allow every
+   * character in them */
+  group = g_uri_escape_string(script, NULL, TRUE);
+  key   = g_uri_escape_string(name, NULL, TRUE);
+
+  if (value != NULL) {
+    g_key_file_set_string(values->values, group, key, value);
+  } else {
+    g_key_file_remove_key(values->values, group, key, NULL);
+  }
+
+  /* changes are collected and written at most once per interval */
+  g_hash_table_add(values->changed, g_strdup(script));
+
+  if (values->flush_source == 0) {
+    values->flush_source = g_timeout_add_seconds(USER_SCRIPT_VALUES_FLUSH_INTERVAL,
+        cb_user_script_values_flush, jumanji);
+  }
+
+error_free:
+
+  g_free(script);
+  g_free(name);
+  g_free(value);
+  g_free(token);
+  g_free(group);
+  g_free(key);
 }
 
 void
-user_script_init_tab(jumanji_tab_t* tab, girara_list_t* user_scripts)
+user_script_watch(jumanji_t* jumanji, const char* path)
 {
-  if (tab == NULL || tab->web_view == NULL || user_scripts == NULL) {
+  if (jumanji == NULL || path == NULL || jumanji->global.user_scripts_monitor != NULL) {
     return;
   }
 
-  g_signal_connect(G_OBJECT(tab->web_view), "notify::load-status",
-      G_CALLBACK(cb_user_script_tab_load_status), user_scripts);
+  GFile* dir = g_file_new_for_path(path);
+  jumanji->global.user_scripts_monitor = g_file_monitor_directory(dir,
+      G_FILE_MONITOR_NONE, NULL, NULL);
+  g_object_unref(dir);
+
+  if (jumanji->global.user_scripts_monitor == NULL) {
+    girara_error("could not watch user script directory: %s", path);
+    return;
+  }
+
+  g_signal_connect(G_OBJECT(jumanji->global.user_scripts_monitor), "changed",
+      G_CALLBACK(cb_user_script_watch_dir), jumanji);
 }
 
 void
-cb_user_script_tab_load_status(WebKitWebView* web_view, GParamSpec* pspec,
-    girara_list_t* user_scripts)
+cb_user_script_watch_dir(GFileMonitor* monitor, GFile* file, GFile* other_file,
+    GFileMonitorEvent event, jumanji_t* jumanji)
 {
-#if 0
-  if (web_view == NULL || user_scripts == NULL ||
-      girara_list_size(user_scripts) == 0) {
+  if (jumanji == NULL || jumanji->global.user_scripts == NULL ||
+      (event != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT &&
+       event != G_FILE_MONITOR_EVENT_CREATED &&
+       event != G_FILE_MONITOR_EVENT_DELETED)) {
+    return;
+  }
+
+  char* path = g_file_get_path(file);
+  if (path == NULL) {
     return;
   }
 
-  /* check status */
-  WebKitLoadStatus status = webkit_web_view_get_load_status(web_view);
+  /* only the changed file is parsed again */
+  user_script_t* old_script = user_script_find(jumanji->global.user_scripts, path);
+  user_script_t* new_script = NULL;
+
+  if (event != G_FILE_MONITOR_EVENT_DELETED &&
+      g_file_test(path, G_FILE_TEST_IS_REGULAR) == TRUE) {
+    new_script = user_script_load_file(path);
+    if (new_script == NULL) {
+      girara_error("could not parse user script: %s", path);
+    }
+  }
 
-  static bool loaded_gm_functions = false;
-  if (status == WEBKIT_LOAD_PROVISIONAL) {
-    loaded_gm_functions = false;
-  } else if (status != WEBKIT_LOAD_FIRST_VISUALLY_NON_EMPTY_LAYOUT &&
-      status != WEBKIT_LOAD_FINISHED) {
+  /* files are often saved in several steps, so unchanged scripts are
+   * skipped */
+  if ((old_script == NULL && new_script == NULL) || (old_script != NULL &&
+        new_script != NULL && g_strcmp0(old_script->content, new_script->content) == 0)) {
+    user_script_free(new_script);
+    g_free(path);
     return;
   }
 
-  /* get website uri */
-  const char* uri = webkit_web_view_get_uri(web_view);
+  /* pages that were loaded before keep posting with the token of the old
+   * script, so a script that keeps its name keeps its token */
+  if (old_script != NULL && new_script != NULL &&
+      g_strcmp0(old_script->name, new_script->name) == 0) {
+    g_free(new_script->token);
+    new_script->token = old_script->token;
+    old_script->token = NULL;
+  }
+
+  /* only tabs that show a page the script applied to or applies to now are
+   * reloaded */
+  girara_list_t* tabs = girara_list_new();
+
+  int number_of_tabs = girara_get_number_of_tabs(jumanji->ui.session);
+  for (int i = 0; i < number_of_tabs; i++) {
+    jumanji_tab_t* tab = jumanji_tab_get_nth(jumanji, i);
+    if (tab == NULL || tab->web_view == NULL) {
+      continue;
+    }
+
+    const char* uri = webkit_web_view_get_uri(WEBKIT_WEB_VIEW(tab->web_view));
+    if (user_script_matches(old_script, uri) == true ||
+        user_script_matches(new_script, uri) == true) {
+      girara_list_append(tabs, tab);
+    }
+  }
+
+  /* the old script has to leave the user content manager before it is
+   * freed */
+  webkit_user_content_manager_remove_all_scripts(jumanji->global.user_content);
+
+  if (old_script != NULL) {
+    girara_list_remove(jumanji->global.user_scripts, old_script);
+  }
+
+  if (new_script != NULL) {
+    girara_list_append(jumanji->global.user_scripts, new_script);
+    girara_info("reloaded user script: %s", new_script->name ? new_script->name : path);
+  }
+
+  user_script_content_reset(jumanji);
+
+  if (girara_list_size(tabs) > 0) {
+    girara_list_iterator_t* iter = girara_list_iterator(tabs);
+    do {
+      jumanji_tab_t* tab = (jumanji_tab_t*) girara_list_iterator_data(iter);
+      webkit_web_view_reload(WEBKIT_WEB_VIEW(tab->web_view));
+    } while (girara_list_iterator_next(iter));
+    girara_list_iterator_free(iter);
+  }
+
+  girara_list_free(tabs);
+  g_free(path);
+}
+
+static void
+user_script_content_reset(jumanji_t* jumanji)
+{
+  /* webkit can not remove a single script before 2.32, so the compiled
+   * scripts that did not change are added again as they are */
+  webkit_user_content_manager_remove_all_scripts(jumanji->global.user_content);
+
+  if (girara_list_size(jumanji->global.user_scripts) > 0) {
+    girara_list_iterator_t* iter = girara_list_iterator(jumanji->global.user_scripts);
+    do {
+      user_script_t* user_script = (user_script_t*) girara_list_iterator_data(iter);
+      if (user_script != NULL && user_script->script != NULL) {
+        webkit_user_content_manager_add_script(jumanji->global.user_content,
+            user_script->script);
+      }
+    } while (girara_list_iterator_next(iter));
+    girara_list_iterator_free(iter);
+  }
+
+  user_script_register(jumanji);
+}
+
+static char*
+user_script_message_get_string(JSCValue* message, const char* property)
+{
+  JSCValue* value = jsc_value_object_get_property(message, property);
+  char* result    = NULL;
+
+  if (value != NULL && jsc_value_is_string(value) == TRUE) {
+    result = jsc_value_to_string(value);
+  }
+
+  if (value != NULL) {
+    g_object_unref(value);
+  }
+
+  return result;
+}
+
+static char*
+user_script_token_new(void)
+{
+  guchar bytes[USER_SCRIPT_TOKEN_SIZE];
+
+  /* the token must not be guessable by pages, so it is read from the
+   * system's random source */
+  FILE* file = fopen("/dev/urandom", "rb");
+  if (file == NULL || fread(bytes, 1, sizeof(bytes), file) != sizeof(bytes)) {
+    girara_error("Could not create the token of a user script");
+    if (file != NULL) {
+      fclose(file);
+    }
+    return NULL;
+  }
+  fclose(file);
+
+  GString* token = g_string_sized_new(2 * sizeof(bytes));
+  for (unsigned int i = 0; i < sizeof(bytes); i++) {
+    g_string_append_printf(token, "%02x", bytes[i]);
+  }
+
+  return g_string_free(token, FALSE);
+}
+
+static gboolean
+cb_user_script_values_flush(gpointer data)
+{
+  jumanji_t* jumanji           = (jumanji_t*) data;
+  user_script_values_t* values = jumanji->global.user_script_values;
+
+  /* only one write is in flight at a time */
+  if (values->writing == true) {
+    return TRUE;
+  }
+
+  values->flush_source = 0;
+  user_script_values_write(values, true);
+
+  /* scripts whose values changed are bundled again, so that pages which are
+   * loaded from now on see the new values */
+  bool changed = false;
+  if (jumanji->global.user_scripts != NULL && girara_list_size(jumanji->global.user_scripts) > 0) {
+    girara_list_iterator_t* iter = girara_list_iterator(jumanji->global.user_scripts);
+    do {
+      user_script_t* user_script = (user_script_t*) girara_list_iterator_data(iter);
+      if (user_script != NULL && user_script->script != NULL &&
+          g_hash_table_contains(values->changed, user_script->name) == TRUE) {
+        webkit_user_script_unref(user_script->script);
+        user_script->script = NULL;
+        changed = true;
+      }
+    } while (girara_list_iterator_next(iter));
+    girara_list_iterator_free(iter);
+  }
+
+  g_hash_table_remove_all(values->changed);
+
+  if (changed == true) {
+    user_script_content_reset(jumanji);
+  }
+
+  return FALSE;
+}
+
+static void
+user_script_values_write(user_script_values_t* values, bool async)
+{
+  gsize length = 0;
+  char* data   = g_key_file_to_data(values->values, &length, NULL);
+
+  if (async == false) {
+    if (g_file_set_contents(values->path, data, length, NULL) == FALSE) {
+      girara_error("could not write user script values to %s", values->path);
+    }
+
+    g_free(data);
+    return;
+  }
+
+  GFile* file   = g_file_new_for_path(values->path);
+  GBytes* bytes = g_bytes_new_take(data, length);
+
+  values->writing = true;
+  g_file_replace_contents_bytes_async(file, bytes, NULL, FALSE,
+      G_FILE_CREATE_PRIVATE, values->cancellable, cb_user_script_values_written,
+      values);
+
+  g_bytes_unref(bytes);
+  g_object_unref(file);
+}
+
+static void
+cb_user_script_values_written(GObject* source, GAsyncResult* result, gpointer data)
+{
+  user_script_values_t* values = (user_script_values_t*) data;
+  GError* error = NULL;
+
+  if (g_file_replace_contents_finish(G_FILE(source), result, NULL, &error) == FALSE) {
+    /* a cancelled write is repeated synchronously */
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) == FALSE) {
+      girara_error("could not write user script values to %s: %s", values->path,
+          error->message);
+    }
+    g_error_free(error);
+  }
+
+  values->writing = false;
+}
+
+static user_script_t*
+user_script_find(girara_list_t* user_scripts, const char* path)
+{
+  if (girara_list_size(user_scripts) == 0) {
+    return NULL;
+  }
+
+  user_script_t* result = NULL;
 
-  /* check all user scripts */
   girara_list_iterator_t* iter = girara_list_iterator(user_scripts);
   do {
     user_script_t* user_script = (user_script_t*) girara_list_iterator_data(iter);
-    if (user_script == NULL) {
-      continue;
+    if (user_script != NULL && g_strcmp0(user_script->path, path) == 0) {
+      result = user_script;
+      break;
     }
+  } while (girara_list_iterator_next(iter));
+  girara_list_iterator_free(iter);
 
-    /* do not load user script by default */
-    bool load_user_script = false;
+  return result;
+}
 
-    /* do not accidentally load a script multiple times */
-    if ((status == WEBKIT_LOAD_FIRST_VISUALLY_NON_EMPTY_LAYOUT &&
-        user_script->load_on_document_start == false) ||
-        (status == WEBKIT_LOAD_FINISHED &&
-         user_script->load_on_document_start == true)) {
-      continue;
+static WebKitUserScript*
+user_script_bundle(user_script_t* user_script, GKeyFile* values)
+{
+  /* patterns that webkit understands are matched by webkit; the script only
+   * checks the uri itself if some pattern can only be approximated */
+  bool include_exact = true;
+  bool exclude_exact = true;
+
+  char** allow_list = user_script_url_patterns(user_script->include, true, &include_exact);
+  char** block_list = user_script_url_patterns(user_script->exclude, false, &exclude_exact);
+
+  /* like greasemonkey, every script runs in a function of its own, so it
+   * may return early and its declarations do not leak into the page; the
+   * function also holds the script's copy of its stored values */
+  GString* source = g_string_new("(function() {\nvar GM_script = ");
+  user_script_append_string(source, user_script->name);
+  g_string_append(source, ";\nvar GM_token = ");
+  user_script_append_string(source, (user_script->token != NULL) ? user_script->token : "");
+  g_string_append(source, ";\nvar GM_values = Object.create(null);\n");
+
+  char* group = g_uri_escape_string(user_script->name, NULL, TRUE);
+  char** keys = (values != NULL) ? g_key_file_get_keys(values, group, NULL, NULL) : NULL;
+
+  for (unsigned int i = 0; keys != NULL && keys[i] != NULL; i++) {
+    char* name  = g_uri_unescape_string(keys[i], NULL);
+    char* value = g_key_file_get_string(values, group, keys[i], NULL);
+
+    if (name != NULL && value != NULL) {
+      g_string_append(source, "GM_values[");
+      user_script_append_string(source, name);
+      g_string_append(source, "] = ");
+      user_script_append_string(source, value);
+      g_string_append(source, ";\n");
     }
 
-    int n_included = girara_list_size(user_script->include);
-    int n_excluded = girara_list_size(user_script->exclude);
+    g_free(name);
+    g_free(value);
+  }
+
+  g_strfreev(keys);
+  g_free(group);
+
+  g_string_append(source, gm_functions);
 
-    if (n_included == 0) {
-      load_user_script = true;
+  if (include_exact == false || exclude_exact == false) {
+    char* include = (include_exact == false) ? user_script_globs_to_regex(user_script->include) : NULL;
+    char* exclude = (exclude_exact == false) ? user_script_globs_to_regex(user_script->exclude) : NULL;
+
+    if (include != NULL) {
+      g_string_append_printf(source, "if (!/%s/.test(location.href)) return;\n", include);
+    }
+    if (exclude != NULL) {
+      g_string_append_printf(source, "if (/%s/.test(location.href)) return;\n", exclude);
     }
 
-    /* check if script is excluded on web site */
-    for (unsigned int i = 0; i < n_excluded; i++) {
-      char* exclude = girara_list_nth(user_script->exclude, i);
+    g_free(include);
+    g_free(exclude);
+  }
 
-      GRegex* regex = g_regex_new(exclude, 0, 0, NULL);
-      if (g_regex_match(regex, uri, 0, NULL) == TRUE) {
-        load_user_script = false;
-      }
-      g_regex_unref(regex);
+  g_string_append(source, user_script->content);
+  g_string_append(source, "\n}).call(window);\n");
+
+  WebKitUserScript* script = webkit_user_script_new(source->str,
+      WEBKIT_USER_CONTENT_INJECT_TOP_FRAME,
+      (user_script->load_on_document_start == true) ?
+        WEBKIT_USER_SCRIPT_INJECT_AT_DOCUMENT_START :
+        WEBKIT_USER_SCRIPT_INJECT_AT_DOCUMENT_END,
+      (const char* const*) allow_list, (const char* const*) block_list);
+
+  g_string_free(source, TRUE);
+  g_strfreev(allow_list);
+  g_strfreev(block_list);
+
+  return script;
+}
+
+static void
+user_script_append_string(GString* source, const char* text)
+{
+  /* appends the text as a double quoted javascript string */
+  g_string_append_c(source, '"');
+
+  for (const unsigned char* c = (const unsigned char*) text; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') {
+      g_string_append_c(source, '\\');
+      g_string_append_c(source, *c);
+    } else if (*c < 0x20) {
+      g_string_append_printf(source, "\\u%04x", *c);
+    } else if (*c == 0xe2 && c[1] == 0x80 && (c[2] == 0xa8 || c[2] == 0xa9)) {
+      /* line and paragraph separators end a string in older javascript */
+      g_string_append_printf(source, "\\u%04x", (c[2] == 0xa8) ? 0x2028 : 0x2029);
+      c += 2;
+    } else {
+      g_string_append_c(source, *c);
     }
+  }
 
-    /* check if script is included on web site */
-    if (load_user_script == false) {
-      for (unsigned int i = 0; i < n_included; i++) {
-        char* include = girara_list_nth(user_script->include, i);
+  g_string_append_c(source, '"');
+}
 
-        GRegex* regex = g_regex_new(include, 0, 0, NULL);
-        if (g_regex_match(regex, uri, 0, NULL) == TRUE) {
-          load_user_script = true;
-        }
-        g_regex_unref(regex);
+static char**
+user_script_url_patterns(girara_list_t* globs, bool widen, bool* exact)
+{
+  if (globs == NULL || girara_list_size(globs) == 0) {
+    return NULL;
+  }
+
+  GRegex* regex = g_regex_new(USER_SCRIPT_URL_PATTERN, 0, 0, NULL);
+  GPtrArray* patterns = g_ptr_array_new();
+  bool match_all = false;
+
+  /* globs of the form scheme://host/path with wildcards only in place of
+   * the scheme, in front of the host or in the path, and file:///path, are
+   * valid webkit patterns; the scheme and host of all others are widened to
+   * wildcards or, if widening would block too much, left to the script.
+   * The wildcard scheme only covers http and https, so file globs are
+   * widened to all local files instead. */
+  girara_list_iterator_t* iter = girara_list_iterator(globs);
+  do {
+    const char* glob = girara_list_iterator_data(iter);
+
+    if (g_regex_match(regex, glob, 0, NULL) == TRUE) {
+      g_ptr_array_add(patterns, g_strdup(glob));
+    } else {
+      const char* path = strstr(glob, "://");
+      path = (path != NULL) ? strchr(path + 3, '/') : NULL;
+
+      if (widen == true && g_str_has_prefix(glob, "file:") == TRUE) {
+        g_ptr_array_add(patterns, g_strdup("file:///*"));
+      } else if (widen == true && path != NULL) {
+        g_ptr_array_add(patterns, g_strdup_printf("*://*%s", path));
+      } else if (widen == true) {
+        match_all = true;
       }
-    }
 
-    /* load user script */
-    if (load_user_script == true) {
-      if (loaded_gm_functions == false) {
-        /* load GreaseMonkey's GM_ functions */
-        user_script_inject_text(web_view, gm_functions);
-        loaded_gm_functions = true;
+      /* including everything needs no check */
+      if (widen == false || g_strcmp0(glob, "*") != 0) {
+        *exact = false;
       }
+    }
+  } while (girara_list_iterator_next(iter));
+  girara_list_iterator_free(iter);
+
+  g_regex_unref(regex);
+
+  if (match_all == true || patterns->len == 0) {
+    g_ptr_array_free(patterns, TRUE);
+    return NULL;
+  }
+
+  g_ptr_array_add(patterns, NULL);
+
+  return (char**) g_ptr_array_free(patterns, FALSE);
+}
 
-      user_script_inject(web_view, user_script);
+static char*
+user_script_glob_to_regex(const char* glob)
+{
+  /* '*' matches any string, every other character matches itself */
+  GString* regex = g_string_new(NULL);
+
+  for (const char* c = glob; *c != '\0'; c++) {
+    if (*c == '*') {
+      g_string_append(regex, ".*");
+    } else if (g_ascii_isalnum(*c) == TRUE || (*c & 0x80) != 0) {
+      g_string_append_c(regex, *c);
+    } else {
+      g_string_append_c(regex, '\\');
+      g_string_append_c(regex, *c);
+    }
+  }
+
+  return g_string_free(regex, FALSE);
+}
+
+static GRegex*
+user_script_compile(girara_list_t* globs)
+{
+  char* pattern = user_script_globs_to_regex(globs);
+  if (pattern == NULL) {
+    return NULL;
+  }
+
+  GError* error = NULL;
+  GRegex* regex = g_regex_new(pattern, G_REGEX_OPTIMIZE | G_REGEX_DOTALL, 0, &error);
+  if (regex == NULL) {
+    girara_error("could not compile user script pattern %s: %s", pattern,
+        error->message);
+    g_error_free(error);
+  }
+
+  g_free(pattern);
+
+  return regex;
+}
+
+static char*
+user_script_globs_to_regex(girara_list_t* globs)
+{
+  if (globs == NULL || girara_list_size(globs) == 0) {
+    return NULL;
+  }
+
+  /* all patterns are combined into one anchored alternation; the result is
+   * valid both as a pcre and as a javascript regular expression */
+  GString* pattern = g_string_new("^(?:");
+
+  bool first = true;
+
+  girara_list_iterator_t* iter = girara_list_iterator(globs);
+  do {
+    char* regex = user_script_glob_to_regex(girara_list_iterator_data(iter));
+
+    if (first == false) {
+      g_string_append_c(pattern, '|');
     }
+    g_string_append(pattern, regex);
+    first = false;
+
+    g_free(regex);
   } while (girara_list_iterator_next(iter));
   girara_list_iterator_free(iter);
-#endif
+
+  g_string_append(pattern, ")$");
+
+  return g_string_free(pattern, FALSE);
 }
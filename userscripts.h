@@ -9,14 +9,21 @@
 
 #define USER_SCRIPTS_DIR "scripts"
 
+typedef struct user_script_values_s user_script_values_t;
+
 typedef struct user_script_s
 {
   char* name; /**> Name of the user script */
   char* description; /**> Description of the user script */
   char* content; /**> User script code */
+  char* path; /**> Path of the file the script has been loaded from */
   girara_list_t* include; /**> List of included url patterns */
   girara_list_t* exclude; /**> List of excluded url patterns */
+  GRegex* include_regex; /**> Compiled include patterns, NULL if every url is included */
+  GRegex* exclude_regex; /**> Compiled exclude patterns, NULL if no url is excluded */
   bool load_on_document_start; /**> Load on document start */
+  WebKitUserScript* script; /**> Compiled script, NULL until it has been registered */
+  char* token; /**> Random token that authenticates the messages of the script */
 } user_script_t;
 
 /**
@@ -44,37 +51,73 @@ user_script_t* user_script_load_file(const char* path);
 void user_script_free(void* data);
 
 /**
- * Load user script on webkit view
+ * Checks if an user script applies to an uri. The uri has to match one of
+ * the include patterns, if there are any, and none of the exclude patterns.
  *
- * @param web_view Webkit view
  * @param user_script The user script
+ * @param uri The uri
+ * @return true if the script applies to the uri
+ */
+bool user_script_matches(user_script_t* user_script, const char* uri);
+
+/**
+ * Registers all user scripts that have not been registered yet with the
+ * user content manager that is shared by all tabs. The include and exclude
+ * patterns are passed to webkit as url lists, so webkit decides on which
+ * pages a script runs and keeps the compiled scripts for all tabs.
+ *
+ * @param jumanji The jumanji session
+ */
+void user_script_register(jumanji_t* jumanji);
+
+/**
+ * Loads the values stored by user scripts through GM_setValue and registers
+ * the script message handler that receives their changes. Every script gets
+ * a copy of its values when it is registered; changes are written to the
+ * data directory at most once per second.
+ *
+ * @param jumanji The jumanji session
+ * @return true if no error occured
  */
-void user_script_inject(WebKitWebView* web_view, user_script_t* user_script);
+bool user_script_values_init(jumanji_t* jumanji);
 
 /**
- * Load user script by content
+ * Writes pending changes and frees the stored values
  *
- * @param web_view Webkit view
- * @param text The javascript code
+ * @param jumanji The jumanji session
  */
-void user_script_inject_text(WebKitWebView* web_view, const char* text);
+void user_script_values_free(jumanji_t* jumanji);
 
 /**
- * Sets up a webkit tab to use the user script implementation
+ * Callback that receives the changes of the stored values
  *
- * @param tab The jumanji tab
- * @param user_scripts The list of user scripts
+ * @param user_content The user content manager
+ * @param result The message of the script
+ * @param jumanji The jumanji session
+ */
+void cb_user_script_message_received(WebKitUserContentManager* user_content,
+    WebKitJavascriptResult* result, jumanji_t* jumanji);
+
+/**
+ * Watches the user script directory. A script whose file changes is parsed
+ * again and replaces the old version; tabs that show a page to which the old
+ * or the new version applies are reloaded.
+ *
+ * @param jumanji The jumanji session
+ * @param path Path to the directory
  */
-void user_script_init_tab(jumanji_tab_t* tab, girara_list_t* user_scripts);
+void user_script_watch(jumanji_t* jumanji, const char* path);
 
 /**
- * Callback that is used to load user scripts at the correct time
+ * Callback that is called if a file in the user script directory changes
  *
- * @param web_view Webkit view
- * @param pspec -
- * @param user_scripts The list of user scripts
+ * @param monitor The file monitor
+ * @param file The changed file
+ * @param other_file -
+ * @param event The event
+ * @param jumanji The jumanji session
  */
-void cb_user_script_tab_load_status(WebKitWebView* web_view, GParamSpec* pspec,
-    girara_list_t* user_scripts);
+void cb_user_script_watch_dir(GFileMonitor* monitor, GFile* file, GFile*
+    other_file, GFileMonitorEvent event, jumanji_t* jumanji);
 
 #endif // USERSCRIPTS_H
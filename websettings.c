@@ -0,0 +1,386 @@
+/* See LICENSE file for license and copyright information */
+
+#include <stdlib.h>
+#include <string.h>
+#include <girara/session.h>
+#include <girara/settings.h>
+#include <girara/tabs.h>
+#include <girara/utils.h>
+
+#include "websettings.h"
+
+/* webkit settings that only take effect when a page is loaded */
+static const char* const settings_reload[] = {
+  "auto-load-images",
+  "default-charset",
+  "enable-java",
+  "enable-javascript",
+  "enable-plugins",
+  "user-agent"
+};
+
+typedef struct jumanji_settings_alias_s
+{
+  const char* name; /**> Name of the setting in older versions of webkit */
+  const char* setting; /**> Name of the webkit setting */
+} jumanji_settings_alias_t;
+
+/* the configuration still uses some names of the first webkit api */
+static const jumanji_settings_alias_t settings_aliases[] = {
+  { "default-encoding",     "default-charset" },
+  { "enable-java-applet",   "enable-java" },
+  { "enable-scripts",       "enable-javascript" },
+  { "resizable-text-areas", "enable-resizable-text-areas" }
+};
+
+static const char* jumanji_settings_name(const char* name);
+static GParamSpec* jumanji_settings_find(WebKitSettings* settings, const char* name);
+static bool jumanji_settings_parse(GParamSpec* spec, const char* text, GValue* value);
+static WebKitSettings* jumanji_settings_copy(WebKitSettings* settings);
+
+bool
+jumanji_settings_set(jumanji_t* jumanji, const char* name, const GValue* value)
+{
+  if (jumanji == NULL || jumanji->global.browser_settings == NULL || name == NULL
+      || value == NULL) {
+    return false;
+  }
+
+  name = jumanji_settings_name(name);
+
+  if (jumanji_settings_find(jumanji->global.browser_settings, name) == NULL) {
+    girara_warning("Webkit has no setting %s", name);
+    return false;
+  }
+
+  g_object_set_property(G_OBJECT(jumanji->global.browser_settings), name, value);
+
+  /* only tabs with overrides have settings of their own */
+  if (jumanji->ui.session == NULL) {
+    return true;
+  }
+
+  int number_of_tabs = girara_get_number_of_tabs(jumanji->ui.session);
+  for (int i = 0; i < number_of_tabs; i++) {
+    jumanji_tab_t* tab = jumanji_tab_get_nth(jumanji, i);
+    if (tab == NULL || tab->settings == NULL) {
+      continue;
+    }
+
+    if (jumanji_tab_settings_overridden(tab, name) == false) {
+      g_object_set_property(G_OBJECT(tab->settings), name, value);
+    }
+  }
+
+  return true;
+}
+
+bool
+jumanji_settings_need_reload(const char* name)
+{
+  name = jumanji_settings_name(name);
+
+  for (unsigned int i = 0; i < G_N_ELEMENTS(settings_reload); i++) {
+    if (g_strcmp0(settings_reload[i], name) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void
+jumanji_settings_spell_checking_apply(jumanji_t* jumanji, WebKitWebContext* context)
+{
+  if (jumanji == NULL || context == NULL) {
+    return;
+  }
+
+  bool enabled    = false;
+  char* languages = NULL;
+  girara_setting_get(jumanji->ui.session, "enable-spell-checking", &enabled);
+  girara_setting_get(jumanji->ui.session, "spell-checking-languages", &languages);
+
+  /* without a list of languages webkit checks the language of the locale */
+  if (languages != NULL && languages[0] != '\0') {
+    char** list = g_strsplit(languages, ",", -1);
+    for (unsigned int i = 0; list[i] != NULL; i++) {
+      g_strstrip(list[i]);
+    }
+
+    webkit_web_context_set_spell_checking_languages(context, (const char* const*) list);
+    g_strfreev(list);
+  }
+
+  webkit_web_context_set_spell_checking_enabled(context, enabled);
+  g_free(languages);
+}
+
+bool
+jumanji_settings_user_stylesheet_apply(jumanji_t* jumanji, const char* uri)
+{
+  if (jumanji == NULL || jumanji->global.user_content == NULL) {
+    return false;
+  }
+
+  webkit_user_content_manager_remove_all_style_sheets(jumanji->global.user_content);
+
+  /* an empty uri disables the stylesheet */
+  if (uri == NULL || uri[0] == '\0') {
+    return true;
+  }
+
+  char* scheme = g_uri_parse_scheme(uri);
+  GFile* file  = (scheme != NULL) ? g_file_new_for_uri(uri) : g_file_new_for_path(uri);
+  g_free(scheme);
+
+  char* content = NULL;
+  if (g_file_load_contents(file, NULL, &content, NULL, NULL, NULL) == FALSE) {
+    g_object_unref(file);
+    return false;
+  }
+
+  g_object_unref(file);
+
+  WebKitUserStyleSheet* stylesheet = webkit_user_style_sheet_new(content,
+      WEBKIT_USER_CONTENT_INJECT_ALL_FRAMES, WEBKIT_USER_STYLE_LEVEL_USER, NULL, NULL);
+  webkit_user_content_manager_add_style_sheet(jumanji->global.user_content, stylesheet);
+  webkit_user_style_sheet_unref(stylesheet);
+
+  g_free(content);
+
+  return true;
+}
+
+void
+jumanji_tab_settings_apply(jumanji_tab_t* tab)
+{
+  if (tab == NULL || tab->jumanji == NULL || tab->web_view == NULL) {
+    return;
+  }
+
+  WebKitSettings* settings = (tab->settings != NULL) ? tab->settings :
+    tab->jumanji->global.browser_settings;
+
+  if (webkit_web_view_get_settings(WEBKIT_WEB_VIEW(tab->web_view)) != settings) {
+    webkit_web_view_set_settings(WEBKIT_WEB_VIEW(tab->web_view), settings);
+  }
+}
+
+bool
+jumanji_tab_settings_override(jumanji_tab_t* tab, const char* name, const char* value)
+{
+  if (tab == NULL || tab->jumanji == NULL || name == NULL || value == NULL) {
+    return false;
+  }
+
+  name = jumanji_settings_name(name);
+
+  GParamSpec* spec = jumanji_settings_find(tab->jumanji->global.browser_settings, name);
+  if (spec == NULL) {
+    return false;
+  }
+
+  GValue gvalue = G_VALUE_INIT;
+  if (jumanji_settings_parse(spec, value, &gvalue) == false) {
+    return false;
+  }
+
+  if (tab->settings == NULL) {
+    tab->settings       = jumanji_settings_copy(tab->jumanji->global.browser_settings);
+    tab->overrides      = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    tab->site_overrides = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    jumanji_tab_settings_apply(tab);
+  }
+
+  g_object_set_property(G_OBJECT(tab->settings), name, &gvalue);
+  g_value_unset(&gvalue);
+
+  /* the value belongs to the user unless the content rules mark it again */
+  g_hash_table_add(tab->overrides, g_strdup(name));
+  g_hash_table_remove(tab->site_overrides, name);
+
+  return true;
+}
+
+bool
+jumanji_tab_settings_reset(jumanji_tab_t* tab, const char* name)
+{
+  if (tab == NULL || tab->jumanji == NULL || name == NULL || tab->overrides == NULL) {
+    return false;
+  }
+
+  name = jumanji_settings_name(name);
+
+  if (g_hash_table_remove(tab->overrides, name) == FALSE) {
+    return false;
+  }
+
+  g_hash_table_remove(tab->site_overrides, name);
+
+  if (g_hash_table_size(tab->overrides) == 0) {
+    jumanji_tab_settings_free(tab);
+    jumanji_tab_settings_apply(tab);
+    return true;
+  }
+
+  GParamSpec* spec = jumanji_settings_find(tab->jumanji->global.browser_settings, name);
+  if (spec != NULL) {
+    GValue value = G_VALUE_INIT;
+    g_value_init(&value, spec->value_type);
+    g_object_get_property(G_OBJECT(tab->jumanji->global.browser_settings), name, &value);
+    g_object_set_property(G_OBJECT(tab->settings), name, &value);
+    g_value_unset(&value);
+  }
+
+  return true;
+}
+
+bool
+jumanji_tab_settings_overridden(jumanji_tab_t* tab, const char* name)
+{
+  if (tab == NULL || tab->overrides == NULL || name == NULL) {
+    return false;
+  }
+
+  return g_hash_table_contains(tab->overrides, jumanji_settings_name(name)) == TRUE;
+}
+
+void
+jumanji_tab_settings_free(jumanji_tab_t* tab)
+{
+  if (tab == NULL) {
+    return;
+  }
+
+  if (tab->overrides != NULL) {
+    g_hash_table_destroy(tab->overrides);
+    tab->overrides = NULL;
+  }
+
+  if (tab->site_overrides != NULL) {
+    g_hash_table_destroy(tab->site_overrides);
+    tab->site_overrides = NULL;
+  }
+
+  if (tab->settings != NULL) {
+    g_object_unref(tab->settings);
+    tab->settings = NULL;
+  }
+}
+
+static const char*
+jumanji_settings_name(const char* name)
+{
+  for (unsigned int i = 0; i < G_N_ELEMENTS(settings_aliases); i++) {
+    if (g_strcmp0(settings_aliases[i].name, name) == 0) {
+      return settings_aliases[i].setting;
+    }
+  }
+
+  return name;
+}
+
+static GParamSpec*
+jumanji_settings_find(WebKitSettings* settings, const char* name)
+{
+  if (settings == NULL || name == NULL) {
+    return NULL;
+  }
+
+  GParamSpec* spec = g_object_class_find_property(G_OBJECT_GET_CLASS(settings), name);
+  if (spec == NULL || (spec->flags & G_PARAM_WRITABLE) == 0 ||
+      (spec->flags & G_PARAM_CONSTRUCT_ONLY) != 0) {
+    return NULL;
+  }
+
+  return spec;
+}
+
+static bool
+jumanji_settings_parse(GParamSpec* spec, const char* text, GValue* value)
+{
+  char* end = NULL;
+
+  g_value_init(value, spec->value_type);
+
+  switch (G_TYPE_FUNDAMENTAL(spec->value_type)) {
+    case G_TYPE_BOOLEAN:
+      if (g_strcmp0(text, "true") == 0) {
+        g_value_set_boolean(value, TRUE);
+      } else if (g_strcmp0(text, "false") == 0) {
+        g_value_set_boolean(value, FALSE);
+      } else {
+        goto error_free;
+      }
+      break;
+    case G_TYPE_INT: {
+      gint64 number = g_ascii_strtoll(text, &end, 10);
+      if (end == text || *end != '\0' || number < G_MININT || number > G_MAXINT) {
+        goto error_free;
+      }
+      g_value_set_int(value, (int) number);
+      break;
+    }
+    case G_TYPE_UINT: {
+      guint64 number = g_ascii_strtoull(text, &end, 10);
+      if (end == text || *end != '\0' || text[0] == '-' || number > G_MAXUINT) {
+        goto error_free;
+      }
+      g_value_set_uint(value, (unsigned int) number);
+      break;
+    }
+    case G_TYPE_STRING:
+      g_value_set_string(value, text);
+      break;
+    case G_TYPE_ENUM: {
+      GEnumClass* enum_class = g_type_class_ref(spec->value_type);
+      GEnumValue* enum_value = g_enum_get_value_by_nick(enum_class, text);
+      if (enum_value != NULL) {
+        g_value_set_enum(value, enum_value->value);
+      }
+      g_type_class_unref(enum_class);
+      if (enum_value == NULL) {
+        goto error_free;
+      }
+      break;
+    }
+    default:
+      goto error_free;
+  }
+
+  return true;
+
+error_free:
+
+  g_value_unset(value);
+
+  return false;
+}
+
+static WebKitSettings*
+jumanji_settings_copy(WebKitSettings* settings)
+{
+  WebKitSettings* copy = webkit_settings_new();
+
+  unsigned int number_of_properties = 0;
+  GParamSpec** specs = g_object_class_list_properties(G_OBJECT_GET_CLASS(settings),
+      &number_of_properties);
+
+  for (unsigned int i = 0; i < number_of_properties; i++) {
+    if ((specs[i]->flags & G_PARAM_READWRITE) != G_PARAM_READWRITE ||
+        (specs[i]->flags & G_PARAM_CONSTRUCT_ONLY) != 0) {
+      continue;
+    }
+
+    GValue value = G_VALUE_INIT;
+    g_value_init(&value, specs[i]->value_type);
+    g_object_get_property(G_OBJECT(settings), specs[i]->name, &value);
+    g_object_set_property(G_OBJECT(copy), specs[i]->name, &value);
+    g_value_unset(&value);
+  }
+
+  g_free(specs);
+
+  return copy;
+}
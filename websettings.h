@@ -0,0 +1,94 @@
+/* See LICENSE file for license and copyright information */
+
+#ifndef WEBSETTINGS_H
+#define WEBSETTINGS_H
+
+#include <webkit2/webkit2.h>
+
+#include "jumanji.h"
+
+/**
+ * Changes a setting of the shared settings object. Every tab that does not
+ * override the setting uses the new value. Like the other functions it also
+ * accepts the names of the first webkit api, e.g. enable-scripts.
+ *
+ * @param jumanji The jumanji session
+ * @param name Name of the webkit setting
+ * @param value The new value
+ * @return false if webkit does not know the setting
+ */
+bool jumanji_settings_set(jumanji_t* jumanji, const char* name, const GValue* value);
+
+/**
+ * Checks if a changed setting only takes effect once a page is reloaded.
+ * Webkit applies most settings, e.g. fonts, to the shown page.
+ *
+ * @param name Name of the setting
+ * @return true if the setting requires a reload
+ */
+bool jumanji_settings_need_reload(const char* name);
+
+/**
+ * Applies enable-spell-checking and spell-checking-languages, which webkit
+ * keeps in the web context instead of the settings object
+ *
+ * @param jumanji The jumanji session
+ * @param context The web context
+ */
+void jumanji_settings_spell_checking_apply(jumanji_t* jumanji, WebKitWebContext* context);
+
+/**
+ * Replaces the user stylesheet of all tabs
+ *
+ * @param jumanji The jumanji session
+ * @param uri Uri or path of the stylesheet, NULL or empty to remove it
+ * @return false if the stylesheet could not be read
+ */
+bool jumanji_settings_user_stylesheet_apply(jumanji_t* jumanji, const char* uri);
+
+/**
+ * Applies the settings of the tab to its web view, i.e. the shared settings
+ * or a copy with the overrides of the tab
+ *
+ * @param tab The tab
+ */
+void jumanji_tab_settings_apply(jumanji_tab_t* tab);
+
+/**
+ * Overrides a setting for a single tab. The tab gets a copy of the shared
+ * settings that keeps following all settings that are not overridden.
+ *
+ * @param tab The tab
+ * @param name Name of the webkit setting
+ * @param value The value as it would be given to the set command
+ * @return false if the setting is unknown or the value is invalid
+ */
+bool jumanji_tab_settings_override(jumanji_tab_t* tab, const char* name, const char* value);
+
+/**
+ * Removes the override of a setting. Once a tab has no overrides left it
+ * uses the shared settings again.
+ *
+ * @param tab The tab
+ * @param name Name of the webkit setting
+ * @return false if the setting is not overridden
+ */
+bool jumanji_tab_settings_reset(jumanji_tab_t* tab, const char* name);
+
+/**
+ * Checks if a tab overrides a setting
+ *
+ * @param tab The tab
+ * @param name Name of the webkit setting
+ * @return true if the setting is overridden
+ */
+bool jumanji_tab_settings_overridden(jumanji_tab_t* tab, const char* name);
+
+/**
+ * Frees the overrides of a tab
+ *
+ * @param tab The tab
+ */
+void jumanji_tab_settings_free(jumanji_tab_t* tab);
+
+#endif // WEBSETTINGS_H